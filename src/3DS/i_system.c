@@ -118,6 +118,12 @@ void I_uSleep(unsigned long usecs)
     svcSleepThread(usecs*1000);
 }
 
+int_64_t I_GetProfileTime(void)
+{
+  // osGetTime only has millisecond resolution
+  return (int_64_t)(svcGetSystemTick() * (1e9 / SYSCLOCK_ARM11));
+}
+
 int ms_to_next_tick;
 
 int I_GetTime_RealTime (void)
@@ -322,9 +328,16 @@ char* I_FindFile(const char* wfname, const char* ext)
 }
 #endif
 
+//
+// I_SetAffinityMask
+//
+// The game itself stays on the application core. Reserve a share of the
+// system core so worker threads (see i_thread.c) have somewhere to run.
+//
 void I_SetAffinityMask(void)
 {
-	// lprintf(LO_INFO, "I_SetAffinityMask: not implemented\n");
+	if (R_FAILED(APT_SetAppCpuTimeLimit(30)))
+		lprintf(LO_WARN, "I_SetAffinityMask: unable to reserve time on core 1\n");
 }
 
 #endif // PRBOOM_SERVER
@@ -0,0 +1,142 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2006 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Threads and synchronisation for 3DS, on top of libctru.
+ *
+ *  Core 0 runs the game; core 1 is the system core and only gives us the
+ *  share of time reserved by I_SetAffinityMask. New 3DS models also
+ *  let applications use core 2.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <3ds.h>
+
+#include "doomtype.h"
+#include "lprintf.h"
+#include "i_thread.h"
+
+#define THREAD_STACK_SIZE (64*1024)
+
+struct i_thread_s {
+  Thread thread;
+};
+
+struct i_mutex_s {
+  LightLock lock;
+};
+
+struct i_event_s {
+  LightEvent event;
+};
+
+int I_GetNumCores(void)
+{
+  bool isnew = false;
+
+  APT_CheckNew3DS(&isnew);
+  return isnew ? 3 : 2;
+}
+
+i_thread_t *I_CreateThread(I_ThreadFunc_f func, void *arg, int core)
+{
+  i_thread_t *thread = malloc(sizeof(*thread));
+  s32 prio = 0x30;
+
+  // run just above the main thread, so a worker sharing its core
+  // still gets to finish its job promptly
+  svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+  thread->thread = threadCreate(func, arg, THREAD_STACK_SIZE, prio - 1,
+                                core < 0 ? -2 : core, false);
+  if (!thread->thread) {
+    lprintf(LO_WARN, "I_CreateThread: unable to start thread on core %d\n", core);
+    free(thread);
+    return NULL;
+  }
+  return thread;
+}
+
+void I_JoinThread(i_thread_t *thread)
+{
+  threadJoin(thread->thread, U64_MAX);
+  threadFree(thread->thread);
+  free(thread);
+}
+
+i_mutex_t *I_CreateMutex(void)
+{
+  i_mutex_t *mutex = malloc(sizeof(*mutex));
+
+  LightLock_Init(&mutex->lock);
+  return mutex;
+}
+
+void I_DestroyMutex(i_mutex_t *mutex)
+{
+  free(mutex);
+}
+
+void I_LockMutex(i_mutex_t *mutex)
+{
+  LightLock_Lock(&mutex->lock);
+}
+
+void I_UnlockMutex(i_mutex_t *mutex)
+{
+  LightLock_Unlock(&mutex->lock);
+}
+
+i_event_t *I_CreateEvent(void)
+{
+  i_event_t *event = malloc(sizeof(*event));
+
+  LightEvent_Init(&event->event, RESET_ONESHOT);
+  return event;
+}
+
+void I_DestroyEvent(i_event_t *event)
+{
+  free(event);
+}
+
+void I_SignalEvent(i_event_t *event)
+{
+  LightEvent_Signal(&event->event);
+}
+
+void I_WaitEvent(i_event_t *event)
+{
+  LightEvent_Wait(&event->event);
+}
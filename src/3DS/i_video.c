@@ -48,6 +48,7 @@
 #include "doomtype.h"
 #include "v_video.h"
 #include "r_draw.h"
+#include "r_main.h"
 #include "d_main.h"
 #include "d_event.h"
 #include "i_joy.h"
@@ -58,6 +59,8 @@
 #include "w_wad.h"
 #include "st_stuff.h"
 #include "lprintf.h"
+#include "i_blit.h"
+#include "i_thread.h"
 
 extern void M_QuitDOOM(int choice);
 
@@ -182,6 +185,15 @@ void I_StartTic (void)
 //
 void I_StartFrame (void)
 {
+  static boolean stereo;
+
+  // the 3D slider scales the eye separation, stereo is off at the bottom
+  stereo_depth = (fixed_t)(osGet3DSliderState() * FRACUNIT);
+  if (stereo != (stereo_separation && stereo_depth > 0)) {
+    stereo = !stereo;
+    gfxSet3D(stereo);
+  }
+
   // TODO: less hacky way to do this, make the "automap" key toggle something else instead
   if (gamestate == GS_LEVEL) {
 	  // if (!(automapmode & am_active)) {
@@ -238,6 +250,7 @@ static void I_UploadNewPalette(int pal)
   // Used by 256 colour PseudoColor modes
   static int cachedgamma;
   static size_t num_pals;
+  int i;
 
   if (V_GetMode() == VID_MODEGL)
     return;
@@ -247,7 +260,6 @@ static void I_UploadNewPalette(int pal)
     int gtlump = (W_CheckNumForName)("GAMMATBL",ns_prboom);
     register const byte * palette = W_CacheLumpNum(pplump);
     register const byte * const gtable = (const byte *)W_CacheLumpNum(gtlump) + 256*(cachedgamma = usegamma);
-    register int i;
 
     num_pals = W_LumpLength(pplump) / (3*256);
     num_pals *= 256;
@@ -277,14 +289,23 @@ static void I_UploadNewPalette(int pal)
 #endif
 
   current_pal = colours + pal*256;
+
+  for (i=0; i<256; i++)
+    I_BlitSetPaletteEntry(i, current_pal[i].r, current_pal[i].g, current_pal[i].b);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 // Graphics API
 
+static void I_FreeFrameBufferCache(void);
+
+static void I_StopPresentThread(void);
+
 void I_ShutdownGraphics(void)
 {
+	I_StopPresentThread();
 	free(colours);
+	I_FreeFrameBufferCache();
 }
 
 //
@@ -295,64 +316,211 @@ void I_UpdateNoBlit (void)
 }
 
 //
-// I_TranslateFrameBuffer
+// I_SetupBlit
 //
-// TODO: allow copying partial screens (for top screen borders)
-void I_TranslateFrameBuffer(unsigned scrn, gfxScreen_t scrndest, gfx3dSide_t side, int xoff, int yoff) {
-	
-	if (scrn >= NUM_SCREENS)
-		I_Error("I_TranslateFrameBuffer: invalid screen number %u", scrn);
+// Works out where a screen lands in a framebuffer.
+//
+static void I_SetupBlit(const screeninfo_t *scr, gfxScreen_t scrndest, gfx3dSide_t side, int xoff, int yoff,
+                        blitdest_t *dest, blitrect_t *rect) {
 	
 	// this is really hacky and obviously doesn't account for the possibility of
 	// different color depths, etc.
 	uint16_t width, height;
-	char *fb = gfxGetFramebuffer(scrndest, side, &width, &height);
+	
+	dest->fb = gfxGetFramebuffer(scrndest, side, &width, &height);
+	dest->fb_width = width;
+	dest->fb_height = height;
 	
 	// center screen horizontally
 	if (xoff < 0) {
-		xoff = (height - screens[scrn].width) / 2;
+		xoff = (height - scr->width) / 2;
 	}
-	if (xoff > height - screens[scrn].width)
-		I_Error("I_TranslateFrameBuffer: bad x-offset (%d > %u)", xoff, height - screens[scrn].width);
+	if (xoff > height - scr->width)
+		I_Error("I_TranslateFrameBuffer: bad x-offset (%d > %u)", xoff, height - scr->width);
 
 	// center screen vertically	
 	if (yoff < 0) {
-		yoff = (width - screens[scrn].height) / 2;
+		yoff = (width - scr->height) / 2;
 	}
-	if (yoff > width - screens[scrn].height)
-		I_Error("I_TranslateFrameBuffer: bad y-offset (%d > %u)", yoff, width - screens[scrn].height);
-		
-	uint16_t x, y;
+	if (yoff > width - scr->height)
+		I_Error("I_TranslateFrameBuffer: bad y-offset (%d > %u)", yoff, width - scr->height);
+	
+	rect->src = scr->data;
+	rect->src_pitch = scr->byte_pitch;
+	rect->width = scr->width;
+	rect->height = scr->height;
+	rect->x = xoff;
+	rect->y = yoff;
+}
+
+//
+// I_TranslateFrameBuffer
+//
+// TODO: allow copying partial screens (for top screen borders)
+void I_TranslateFrameBuffer(unsigned scrn, gfxScreen_t scrndest, gfx3dSide_t side, int xoff, int yoff) {
+	blitdest_t dest;
+	blitrect_t rect;
+	
+	if (scrn >= NUM_SCREENS)
+		I_Error("I_TranslateFrameBuffer: invalid screen number %u", scrn);
+	
+	I_SetupBlit(&screens[scrn], scrndest, side, xoff, yoff, &dest, &rect);
+	
 	// do palette lookups and rotate image 90' into the framebuffer here
-	char *src = screens[scrn].data;
+	I_BlitGetKernel(V_GetMode(), &dest)(&rect, &dest);
+	V_ClearDirty(scrn);
+}
+
+//
+// Damage tracking
+//
+// The V_ functions mark what they draw, but most screens are redrawn in
+// full every frame (e.g. the automap clears the bottom screen first), so
+// each framebuffer also keeps a copy of the screen as it was last blitted
+// there. Only the parts of the marked areas that actually differ from
+// that copy are translated.
+//
+// libctru double buffers, so there is one record per framebuffer and
+// each one collects damage until it is next drawn to.
+//
+#define NUM_FBCACHE 2
+
+typedef struct {
+	byte *fb;          // framebuffer this record belongs to
+	byte *shadow;      // source screen as last blitted to fb
+	vdirty_t pending;  // damage not yet copied to fb
+	boolean valid;
+} fbcache_t;
+
+static fbcache_t bottom_cache[NUM_FBCACHE];
+
+// Only resets the records, so the present worker may call it too
+static void I_InvalidateFrameBufferCache(void) {
+	int i;
+	
+	for (i = 0; i < NUM_FBCACHE; i++) {
+		bottom_cache[i].fb = NULL;
+		bottom_cache[i].pending.count = 0;
+		bottom_cache[i].valid = false;
+	}
+}
+
+// The shadows come from the zone, which isn't thread safe: these are only
+// called from the main thread, with the present worker idle
+static void I_FreeFrameBufferCache(void) {
+	int i;
+	
+	I_InvalidateFrameBufferCache();
+	for (i = 0; i < NUM_FBCACHE; i++) {
+		free(bottom_cache[i].shadow);
+		bottom_cache[i].shadow = NULL;
+	}
+}
+
+static void I_AllocFrameBufferCache(const screeninfo_t *scr) {
+	int i;
+	
+	I_FreeFrameBufferCache();
+	for (i = 0; i < NUM_FBCACHE; i++)
+		bottom_cache[i].shadow = malloc(scr->byte_pitch * scr->height);
+}
+
+//
+// I_UpdateFrameBuffer
+//
+// Like I_TranslateFrameBuffer, but only blits what has changed since this
+// framebuffer was last drawn to. Takes and clears the screen's damage list.
+//
+static void I_UpdateFrameBuffer(const screeninfo_t *scr, vdirty_t *dirty,
+                                gfxScreen_t scrndest, gfx3dSide_t side, fbcache_t *cache) {
+	blitdest_t dest;
+	blitrect_t rect;
+	I_BlitKernel_f kernel;
+	fbcache_t *c = NULL;
+	int depth = V_GetPixelDepth();
+	int pitch = scr->byte_pitch;
+	int i, j;
+	
+	I_SetupBlit(scr, scrndest, side, -1, -1, &dest, &rect);
+	kernel = I_BlitGetKernel(V_GetMode(), &dest);
+	
+	// new damage applies to every framebuffer
+	for (i = 0; i < NUM_FBCACHE; i++) {
+		if (!cache[i].valid)
+			continue;
+		for (j = 0; j < dirty->count; j++)
+			V_AddDirtyRect(&cache[i].pending, &dirty->rects[j]);
+	}
+	dirty->count = 0;
+	
+	for (i = 0; i < NUM_FBCACHE && !c; i++)
+		if (cache[i].fb == dest.fb)
+			c = &cache[i];
+	for (i = 0; i < NUM_FBCACHE && !c; i++)
+		if (!cache[i].fb)
+			c = &cache[i];
+	if (!c) {
+		// framebuffers moved under us
+		I_InvalidateFrameBufferCache();
+		c = &cache[0];
+	}
+	
+	if (!c->shadow) {
+		kernel(&rect, &dest);
+		return;
+	}
+	
+	if (!c->valid) {
+		kernel(&rect, &dest);
+		memcpy(c->shadow, scr->data, pitch * scr->height);
+		c->fb = dest.fb;
+		c->pending.count = 0;
+		c->valid = true;
+		return;
+	}
 	
-	for (x = yoff; x < screens[scrn].height + yoff; x++) {
-		for (y = xoff; y < screens[scrn].width + xoff; y++) {
-			char *dest = fb + ((y * width + (width - x - 1)) * 3);
-			char px;
+	for (i = 0; i < c->pending.count; i++) {
+		const vrect_t *r = &c->pending.rects[i];
+		int x1 = r->x2, x2 = r->x1, y1 = r->y2, y2 = r->y1;
+		int y;
+		
+		// shrink to what actually differs
+		for (y = r->y1; y < r->y2; y++) {
+			const byte *src = scr->data + y * pitch;
+			const byte *old = c->shadow + y * pitch;
+			int l = r->x1 * depth, h = r->x2 * depth;
+			
+			while (l < h && src[l] == old[l])
+				l++;
+			if (l == h)
+				continue;
+			while (src[h - 1] == old[h - 1])
+				h--;
+			
+			x1 = MIN(x1, l / depth);
+			x2 = MAX(x2, (h + depth - 1) / depth);
+			y1 = MIN(y1, y);
+			y2 = y + 1;
+		}
+		
+		if (x1 >= x2)
+			continue;
+		
+		{
+			blitrect_t sub = rect;
 			
-			switch (V_GetMode()) {
-			case VID_MODE8:
-				px = *src++;
-				
-				*dest++ = current_pal[px].b;
-				*dest++ = current_pal[px].g;
-				*dest++ = current_pal[px].r;
-				break;
-				
-			case VID_MODE32:
-				*dest++ = *src++;
-				*dest++ = *src++;
-				*dest++ = *src++;
-				src++;
-				
-				break;
-				
-			default:
-				I_Error("I_TranslateFrameBuffer: unsupported video mode");
-			}
+			sub.src = rect.src + y1 * pitch + x1 * depth;
+			sub.width = x2 - x1;
+			sub.height = y2 - y1;
+			sub.x = rect.x + x1;
+			sub.y = rect.y + y1;
+			kernel(&sub, &dest);
 		}
+		for (y = y1; y < y2; y++)
+			memcpy(c->shadow + y * pitch + x1 * depth,
+			       scr->data + y * pitch + x1 * depth, (x2 - x1) * depth);
 	}
+	c->pending.count = 0;
 }
 
 //
@@ -365,6 +533,117 @@ void I_ClearFrameBuffer(gfxScreen_t scrndest, gfx3dSide_t side) {
 	memset(fb, 0, width * height * 3);
 }
 
+//
+// I_PresentFrame
+//
+// Translates a finished frame into the framebuffers and flips them.
+//
+static void I_PresentFrame(const screeninfo_t *top, const screeninfo_t *right, const screeninfo_t *bottom, vdirty_t *bottom_dirty)
+{
+	blitdest_t dest;
+	blitrect_t rect;
+	
+	// TODO: use enums for screen numbers and apply them where appropriate
+	// main game on top screen, the right eye only in 3D mode
+	I_SetupBlit(top, GFX_TOP, GFX_LEFT, -1, -1, &dest, &rect);
+	I_BlitGetKernel(V_GetMode(), &dest)(&rect, &dest);
+	if (gfxIs3D()) {
+		I_SetupBlit(right ? right : top, GFX_TOP, GFX_RIGHT, -1, -1, &dest, &rect);
+		I_BlitGetKernel(V_GetMode(), &dest)(&rect, &dest);
+	}
+	// automap on bottom screen
+	I_UpdateFrameBuffer(bottom, bottom_dirty, GFX_BOTTOM, 0, bottom_cache);
+	
+	gfxFlushBuffers();
+	gfxSwapBuffers();
+	gspWaitForVBlank();
+}
+
+//
+// Present pipeline
+//
+// When there is a spare core, presenting runs on a worker thread.
+// I_FinishUpdate copies the finished 8 bit screens into buffers owned by
+// the worker and returns, so the game can start on the next tic while
+// the worker translates, flips and waits for VBlank.
+//
+enum { PRESENT_TOP, PRESENT_RIGHT, PRESENT_BOTTOM, NUM_PRESENT };
+
+static screeninfo_t present_screens[NUM_PRESENT];
+static vdirty_t present_dirty;
+static i_thread_t *present_thread;
+static i_event_t *present_start;  // a frame has been handed over
+static i_event_t *present_done;   // the worker is idle and its buffers are free
+static volatile boolean present_quit;
+static boolean present_stereo;    // PRESENT_RIGHT holds the other eye
+
+static void I_PresentThread(void *arg)
+{
+	for (;;) {
+		I_WaitEvent(present_start);
+		if (present_quit)
+			break;
+		I_PresentFrame(&present_screens[PRESENT_TOP],
+		               present_stereo ? &present_screens[PRESENT_RIGHT] : NULL,
+		               &present_screens[PRESENT_BOTTOM], &present_dirty);
+		I_SignalEvent(present_done);
+	}
+}
+
+static void I_AllocPresentScreens(void)
+{
+	int i;
+	
+	for (i = 0; i < NUM_PRESENT; i++) {
+		free(present_screens[i].data);
+		present_screens[i] = screens[i == PRESENT_TOP ? SCR_FRONT_L :
+		                             i == PRESENT_RIGHT ? SCR_FRONT_R : SCR_BOTTOM];
+		present_screens[i].data = malloc(present_screens[i].byte_pitch * present_screens[i].height);
+	}
+}
+
+static void I_StartPresentThread(void)
+{
+	if (I_GetNumCores() < 2 || M_CheckParm("-nopresentthread"))
+		return;
+	
+	present_start = I_CreateEvent();
+	present_done = I_CreateEvent();
+	present_quit = false;
+	I_AllocPresentScreens();
+	
+	// core 1 is the system core, see I_SetAffinityMask
+	present_thread = I_CreateThread(I_PresentThread, NULL, 1);
+	if (!present_thread) {
+		I_DestroyEvent(present_start);
+		I_DestroyEvent(present_done);
+		return;
+	}
+	I_SignalEvent(present_done);
+	lprintf(LO_INFO, "I_StartPresentThread: presenting frames on core 1\n");
+}
+
+static void I_StopPresentThread(void)
+{
+	int i;
+	
+	if (!present_thread)
+		return;
+	
+	I_WaitEvent(present_done);
+	present_quit = true;
+	I_SignalEvent(present_start);
+	I_JoinThread(present_thread);
+	present_thread = NULL;
+	
+	I_DestroyEvent(present_start);
+	I_DestroyEvent(present_done);
+	for (i = 0; i < NUM_PRESENT; i++) {
+		free(present_screens[i].data);
+		present_screens[i].data = NULL;
+	}
+}
+
 //
 // I_FinishUpdate
 //
@@ -373,25 +652,41 @@ static int newpal = 0;
 
 void I_FinishUpdate (void)
 {
+  int i;
+
   if (I_SkipFrame()) return;
 
-	// TODO: use enums for screen numbers and apply them where appropriate
-	// main game on top screen (TODO: both sides)
-	I_TranslateFrameBuffer(SCR_FRONT_L, GFX_TOP, GFX_LEFT, -1, -1);
-	// I_TranslateFrameBuffer(SCR_FRONT_R, GFX_TOP, GFX_RIGHT, -1, -1);
-	// automap on bottom screen
-	I_TranslateFrameBuffer(SCR_BOTTOM, GFX_BOTTOM, 0, -1, -1);
+	// wait until the previous frame is out of the worker's hands
+	if (present_thread)
+		I_WaitEvent(present_done);
 	
-	/* Update the display buffer (flipping video pages if supported)
-	 * If we need to change palette, that implicitely does a flip */
+	/* If we need to change palette, every framebuffer needs a full blit */
 	if (newpal != NO_PALETTE_CHANGE) {
 		I_UploadNewPalette(newpal);
+		I_InvalidateFrameBufferCache();
 		newpal = NO_PALETTE_CHANGE;
 	}
 	
-	gfxFlushBuffers();
-	gfxSwapBuffers();
-	gspWaitForVBlank();
+	if (!present_thread) {
+		I_PresentFrame(&screens[SCR_FRONT_L], stereo_frame ? &screens[SCR_FRONT_R] : NULL,
+		               &screens[SCR_BOTTOM], &screen_dirty[SCR_BOTTOM]);
+		V_ClearDirty(SCR_FRONT_L);
+		return;
+	}
+	
+	memcpy(present_screens[PRESENT_TOP].data, screens[SCR_FRONT_L].data,
+	       screens[SCR_FRONT_L].byte_pitch * screens[SCR_FRONT_L].height);
+	if ((present_stereo = stereo_frame))
+		memcpy(present_screens[PRESENT_RIGHT].data, screens[SCR_FRONT_R].data,
+		       screens[SCR_FRONT_R].byte_pitch * screens[SCR_FRONT_R].height);
+	memcpy(present_screens[PRESENT_BOTTOM].data, screens[SCR_BOTTOM].data,
+	       screens[SCR_BOTTOM].byte_pitch * screens[SCR_BOTTOM].height);
+	for (i = 0; i < screen_dirty[SCR_BOTTOM].count; i++)
+		V_AddDirtyRect(&present_dirty, &screen_dirty[SCR_BOTTOM].rects[i]);
+	V_ClearDirty(SCR_FRONT_L);
+	V_ClearDirty(SCR_BOTTOM);
+	
+	I_SignalEvent(present_start);
 }
 
 //
@@ -483,6 +778,8 @@ void I_InitGraphics(void)
 	/* Initialize palette */
 	I_UploadNewPalette(0);
 
+	I_StartPresentThread();
+
     /* Initialize the input system */
     I_InitInputs();
   }
@@ -516,6 +813,10 @@ void I_UpdateVideoMode(void)
     mode = I_GetModeFromString(myargv[i+1]);
   }
   
+  // the worker must not touch the framebuffers or screens while they change
+  if (present_thread)
+    I_WaitEvent(present_done);
+
   // reset video modes
   gfxExit();
   // disable console
@@ -524,6 +825,7 @@ void I_UpdateVideoMode(void)
   I_ClearFrameBuffer(GFX_TOP, GFX_LEFT);
   I_ClearFrameBuffer(GFX_TOP, GFX_RIGHT);
   I_ClearFrameBuffer(GFX_BOTTOM, 0);
+  I_InvalidateFrameBufferCache();
   
   V_InitMode(mode);
   V_DestroyUnusedTrueColorPalettes();
@@ -534,4 +836,11 @@ void I_UpdateVideoMode(void)
   V_AllocScreens();
 
   R_InitBuffer(SCREENWIDTH, SCREENHEIGHT);
+  I_AllocFrameBufferCache(&screens[SCR_BOTTOM]);
+
+  if (present_thread) {
+    I_AllocPresentScreens();
+    present_dirty.count = 0;
+    I_SignalEvent(present_done);
+  }
 }
@@ -0,0 +1,190 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      Startup and quit functions for the headless host build. There is
+ *      no frontend menu and no ENDOOM; the console is stdout/stderr.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "m_argv.h"
+#include "d_main.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "i_sound.h"
+#include "i_main.h"
+#include "z_zone.h"
+#include "lprintf.h"
+#include "doomstat.h"
+#include "g_game.h"
+#include "m_misc.h"
+#include "r_fps.h"
+
+int realtic_clock_rate = 100;
+static int_64_t I_GetTime_Scale = 1<<24;
+
+unsigned int endoom_mode;
+
+static int I_GetTime_Scaled(void)
+{
+  return (int)( (int_64_t) I_GetTime_RealTime() * I_GetTime_Scale >> 24);
+}
+
+static int  I_GetTime_FastDemo(void)
+{
+  static int fasttic;
+  return fasttic++;
+}
+
+static int I_GetTime_Error(void)
+{
+  I_Error("I_GetTime_Error: GetTime() used before initialization");
+  return 0;
+}
+
+int (*I_GetTime)(void) = I_GetTime_Error;
+
+void I_Init(void)
+{
+  /* killough 4/14/98: Adjustable speedup based on realtic_clock_rate */
+  if (fastdemo)
+    I_GetTime = I_GetTime_FastDemo;
+  else
+    if (realtic_clock_rate != 100)
+      {
+        I_GetTime_Scale = ((int_64_t) realtic_clock_rate << 24) / 100;
+        I_GetTime = I_GetTime_Scaled;
+      }
+    else
+      I_GetTime = I_GetTime_RealTime;
+
+  /* killough 2/21/98: avoid sound initialization if no sound & no music */
+  if (!(nomusicparm && nosfxparm))
+    I_InitSound();
+
+  R_InitInterpolation();
+}
+
+/* cleanup handling -- killough:
+ */
+static void I_SignalHandler(int s)
+{
+  char buf[2048];
+
+  signal(s,SIG_IGN);  /* Ignore future instances of this signal.*/
+
+  strcpy(buf,"Exiting on signal: ");
+  I_SigString(buf+strlen(buf),2000-strlen(buf),s);
+
+  /* If corrupted memory could cause crash, dump memory
+   * allocation history, which points out probable causes
+   */
+  if (s==SIGSEGV || s==SIGILL || s==SIGFPE)
+    Z_DumpHistory(buf);
+
+  I_Error("I_SignalHandler: %s", buf);
+}
+
+static void PrintVer(void)
+{
+  char vbuf[200];
+  lprintf(LO_INFO,"%s\n",I_GetVersionString(vbuf,200));
+}
+
+static int has_exited;
+
+/* I_SafeExit
+ * This function is called instead of exit() by functions that might be called
+ * during the exit process (i.e. after exit() has already been called)
+ * Prevent infinitely recursive exits -- killough
+ */
+
+void I_SafeExit(int rc)
+{
+  if (!has_exited)    /* If it hasn't exited yet, exit now -- killough */
+    {
+      has_exited=rc ? 2 : 1;
+      exit(rc);
+    }
+}
+
+static void I_Quit (void)
+{
+  if (!has_exited)
+    has_exited=1;   /* Prevent infinitely recursive exits -- killough */
+
+  if (has_exited == 1) {
+    if (demorecording)
+      G_CheckDemoStatus();
+    M_SaveDefaults ();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  myargc = argc;
+  myargv = (const char * const *)argv;
+
+  Init_ConsoleWin();
+
+  /* Version info */
+  lprintf(LO_INFO,"\n");
+  PrintVer();
+
+  /* cph - Z_Close must be done after I_Quit, so we register it first. */
+  atexit(Z_Close);
+
+  Z_Init();                  /* 1/18/98 killough: start up memory stuff first */
+  atexit(I_Quit);
+
+  signal(SIGSEGV, I_SignalHandler);
+  signal(SIGTERM, I_SignalHandler);
+  signal(SIGFPE,  I_SignalHandler);
+  signal(SIGILL,  I_SignalHandler);
+  signal(SIGINT,  I_SignalHandler);  /* killough 3/6/98: allow CTRL-BRK during init */
+  signal(SIGABRT, I_SignalHandler);
+
+  I_SetAffinityMask();
+
+  /* cphipps - call to video specific startup code */
+  I_PreInitGraphics();
+
+  D_DoomMain ();
+  return 0;
+}
@@ -0,0 +1,134 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2006 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Null sound and music for the headless host build. Nothing is mixed,
+ *  so every sound is reported finished as soon as it starts.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include "doomtype.h"
+#include "i_sound.h"
+#include "w_wad.h"
+
+int snd_card = 1;
+int mus_card = 1;
+int detect_voices = 0; // God knows
+int snd_samplerate=11025;
+
+void I_InitSound(void)
+{
+}
+
+void I_ShutdownSound(void)
+{
+}
+
+void I_SetChannels(void)
+{
+}
+
+int I_GetSfxLumpNum(sfxinfo_t* sfx)
+{
+  char namebuf[9];
+  sprintf(namebuf, "ds%s", sfx->name);
+  return W_GetNumForName(namebuf);
+}
+
+int I_StartSound(int id, int channel, int vol, int sep, int pitch, int priority)
+{
+  return channel;
+}
+
+void I_StopSound (int handle)
+{
+}
+
+boolean I_SoundIsPlaying(int handle)
+{
+  return false;
+}
+
+boolean I_AnySoundStillPlaying(void)
+{
+  return false;
+}
+
+void I_UpdateSoundParams(int handle, int volume, int seperation, int pitch)
+{
+}
+
+void I_InitMusic(void)
+{
+}
+
+void I_ShutdownMusic(void)
+{
+}
+
+void I_PlaySong(int handle, int looping)
+{
+}
+
+void I_PauseSong (int handle)
+{
+}
+
+void I_ResumeSong (int handle)
+{
+}
+
+void I_StopSong(int handle)
+{
+}
+
+void I_UnRegisterSong(int handle)
+{
+}
+
+int I_RegisterSong(const void *data, size_t len)
+{
+  return 0;
+}
+
+int I_RegisterMusic( const char* filename, musicinfo_t *song )
+{
+  return 1;
+}
+
+void I_SetMusicVolume(int volume)
+{
+}
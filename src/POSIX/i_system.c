@@ -0,0 +1,262 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2006 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Misc system stuff needed by Doom, implemented for POSIX systems.
+ *  Used by the headless host build.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "m_argv.h"
+#include "lprintf.h"
+#include "doomtype.h"
+#include "doomdef.h"
+#include "m_fixed.h"
+#include "r_fps.h"
+#include "i_system.h"
+
+static unsigned int start_displaytime;
+static unsigned int displaytime;
+static boolean InDisplay = false;
+
+// milliseconds since the first call, like osGetTime on the 3DS
+static unsigned int I_GetTimeMS(void)
+{
+  static int_64_t basetime;
+  int_64_t now = I_GetProfileTime() / 1000000;
+
+  if (!basetime)
+    basetime = now;
+  return (unsigned int)(now - basetime);
+}
+
+int_64_t I_GetProfileTime(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int_64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+boolean I_StartDisplay(void)
+{
+  if (InDisplay)
+    return false;
+
+  start_displaytime = I_GetTimeMS();
+  InDisplay = true;
+  return true;
+}
+
+void I_EndDisplay(void)
+{
+  displaytime = I_GetTimeMS() - start_displaytime;
+  InDisplay = false;
+}
+
+void I_uSleep(unsigned long usecs)
+{
+  usleep(usecs);
+}
+
+int ms_to_next_tick;
+
+int I_GetTime_RealTime (void)
+{
+  int t = I_GetTimeMS();
+  int i = t*(TICRATE/5)/200;
+  ms_to_next_tick = (i+1)*200/(TICRATE/5) - t;
+  if (ms_to_next_tick > 1000/TICRATE || ms_to_next_tick<1) ms_to_next_tick = 1;
+  return i;
+}
+
+fixed_t I_GetTimeFrac (void)
+{
+  unsigned long now;
+  fixed_t frac;
+
+  now = I_GetTimeMS();
+
+  if (tic_vars.step == 0)
+    return FRACUNIT;
+  else
+  {
+    frac = (fixed_t)((now - tic_vars.start + displaytime) * FRACUNIT / tic_vars.step);
+    if (frac < 0)
+      frac = 0;
+    if (frac > FRACUNIT)
+      frac = FRACUNIT;
+    return frac;
+  }
+}
+
+void I_GetTime_SaveMS(void)
+{
+  if (!movement_smooth)
+    return;
+
+  tic_vars.start = I_GetTimeMS();
+  tic_vars.next = (unsigned int) ((tic_vars.start * tic_vars.msec + 1.0f) / tic_vars.msec);
+  tic_vars.step = tic_vars.next - tic_vars.start;
+}
+
+unsigned long I_GetRandomTimeSeed(void)
+{
+  return (unsigned long)time(NULL);
+}
+
+const char* I_GetVersionString(char* buf, size_t sz)
+{
+  snprintf(buf,sz,"%s v%s (headless)",PACKAGE,VERSION);
+  return buf;
+}
+
+const char* I_SigString(char* buf, size_t sz, int signum)
+{
+  snprintf(buf,sz,"signal %d",signum);
+  return buf;
+}
+
+/*
+ * I_Read
+ *
+ * cph 2001/11/18 - wrapper for read(2) which handles partial reads and aborts
+ * on error.
+ */
+void I_Read(int fd, void* vbuf, size_t sz)
+{
+  unsigned char* buf = vbuf;
+
+  while (sz) {
+    int rc = read(fd,buf,sz);
+    if (rc <= 0) {
+      I_Error("I_Read: read failed: %s", rc ? strerror(errno) : "EOF");
+    }
+    sz -= rc; buf += rc;
+  }
+}
+
+int I_Filelength(int handle)
+{
+  struct stat   fileinfo;
+  if (fstat(handle,&fileinfo) == -1)
+    I_Error("I_Filelength: %s",strerror(errno));
+  return fileinfo.st_size;
+}
+
+// Return the path where the executable lies -- Lee Killough
+const char *I_DoomExeDir(void)
+{
+  static char *base;
+
+  if (!base) {
+    const char *slash = strrchr(myargv[0], '/');
+
+    if (slash) {
+      base = malloc(slash - myargv[0] + 1);
+      memcpy(base, myargv[0], slash - myargv[0]);
+      base[slash - myargv[0]] = '\0';
+    } else {
+      base = strdup(".");
+    }
+  }
+  return base;
+}
+
+boolean HasTrailingSlash(const char* dn)
+{
+  return (dn[strlen(dn)-1] == '/');
+}
+
+/*
+ * I_FindFile
+ *
+ * Searches the current directory, the executable's directory and
+ * DOOMWADDIR, as the 3DS build does, plus $DOOMWADDIR.
+ */
+char* I_FindFile(const char* wfname, const char* ext)
+{
+  static const struct {
+    const char *dir; // directory
+    const char *env; // environment variable
+    const char *(*func)(void); // for I_DoomExeDir
+  } search[] = {
+    {NULL}, // current working directory
+    {NULL, NULL, I_DoomExeDir}, // config directory
+    {NULL, "DOOMWADDIR"},
+    {DOOMWADDIR}, // build-time configured DOOMWADDIR
+  };
+
+  int   i;
+  size_t  pl = strlen(wfname) + strlen(ext) + 4;
+
+  for (i = 0; i < sizeof(search)/sizeof(*search); i++) {
+    char  * p;
+    const char  * d = NULL;
+
+    if (search[i].env) {
+      if (!(d = getenv(search[i].env)))
+        continue;
+    } else if (search[i].func)
+      d = search[i].func();
+    else
+      d = search[i].dir;
+
+    p = malloc((d ? strlen(d) : 0) + pl);
+    sprintf(p, "%s%s%s", d ? d : "", (d && !HasTrailingSlash(d)) ? "/" : "",
+                         wfname);
+
+    if (access(p,F_OK))
+      strcat(p, ext);
+    if (!access(p,F_OK)) {
+      lprintf(LO_INFO, " found %s\n", p);
+      return p;
+    }
+    free(p);
+  }
+  return NULL;
+}
+
+void I_SetAffinityMask(void)
+{
+}
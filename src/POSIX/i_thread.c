@@ -0,0 +1,159 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2006 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Threads and synchronisation on top of POSIX threads, for host builds.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "doomtype.h"
+#include "lprintf.h"
+#include "i_thread.h"
+
+struct i_thread_s {
+  pthread_t thread;
+  I_ThreadFunc_f func;
+  void *arg;
+};
+
+struct i_mutex_s {
+  pthread_mutex_t lock;
+};
+
+struct i_event_s {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  boolean signalled;
+};
+
+int I_GetNumCores(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (n > 0)
+    return n;
+#endif
+  return 1;
+}
+
+static void *I_ThreadStart(void *arg)
+{
+  i_thread_t *thread = arg;
+
+  thread->func(thread->arg);
+  return NULL;
+}
+
+i_thread_t *I_CreateThread(I_ThreadFunc_f func, void *arg, int core)
+{
+  i_thread_t *thread = malloc(sizeof(*thread));
+
+  // core placement is left to the host scheduler
+  thread->func = func;
+  thread->arg = arg;
+  if (pthread_create(&thread->thread, NULL, I_ThreadStart, thread)) {
+    lprintf(LO_WARN, "I_CreateThread: unable to start thread\n");
+    free(thread);
+    return NULL;
+  }
+  return thread;
+}
+
+void I_JoinThread(i_thread_t *thread)
+{
+  pthread_join(thread->thread, NULL);
+  free(thread);
+}
+
+i_mutex_t *I_CreateMutex(void)
+{
+  i_mutex_t *mutex = malloc(sizeof(*mutex));
+
+  pthread_mutex_init(&mutex->lock, NULL);
+  return mutex;
+}
+
+void I_DestroyMutex(i_mutex_t *mutex)
+{
+  pthread_mutex_destroy(&mutex->lock);
+  free(mutex);
+}
+
+void I_LockMutex(i_mutex_t *mutex)
+{
+  pthread_mutex_lock(&mutex->lock);
+}
+
+void I_UnlockMutex(i_mutex_t *mutex)
+{
+  pthread_mutex_unlock(&mutex->lock);
+}
+
+i_event_t *I_CreateEvent(void)
+{
+  i_event_t *event = malloc(sizeof(*event));
+
+  pthread_mutex_init(&event->lock, NULL);
+  pthread_cond_init(&event->cond, NULL);
+  event->signalled = false;
+  return event;
+}
+
+void I_DestroyEvent(i_event_t *event)
+{
+  pthread_cond_destroy(&event->cond);
+  pthread_mutex_destroy(&event->lock);
+  free(event);
+}
+
+void I_SignalEvent(i_event_t *event)
+{
+  pthread_mutex_lock(&event->lock);
+  event->signalled = true;
+  pthread_cond_signal(&event->cond);
+  pthread_mutex_unlock(&event->lock);
+}
+
+void I_WaitEvent(i_event_t *event)
+{
+  pthread_mutex_lock(&event->lock);
+  while (!event->signalled)
+    pthread_cond_wait(&event->cond, &event->lock);
+  event->signalled = false;
+  pthread_mutex_unlock(&event->lock);
+}
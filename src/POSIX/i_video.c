@@ -0,0 +1,386 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2006 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Null video and input for the headless host build. Frames are still
+ *  converted through the palette into an offscreen 24-bit buffer laid
+ *  out like the 3DS framebuffers, so the blit costs roughly what it
+ *  would on the device; nothing is ever shown.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "m_argv.h"
+#include "doomstat.h"
+#include "doomdef.h"
+#include "doomtype.h"
+#include "v_video.h"
+#include "r_draw.h"
+#include "r_main.h"
+#include "d_main.h"
+#include "i_joy.h"
+#include "i_video.h"
+#include "z_zone.h"
+#include "w_wad.h"
+#include "st_stuff.h"
+#include "am_map.h"
+#include "lprintf.h"
+#include "i_blit.h"
+
+int use_doublebuffer = 1; // Included not to break m_misc
+int use_fullscreen;
+int desired_fullscreen;
+
+// 3DS framebuffers are column-major with the origin at the bottom left
+#define FB_TOP_WIDTH    400
+#define FB_BOTTOM_WIDTH 320
+#define FB_HEIGHT       240
+
+static byte *fb_top, *fb_bottom;
+static byte *fb_right;  // the right eye's top screen, in stereo
+
+// -stereoshot <file>: the last frame's eyes side by side, as a PPM
+static const char *stereoshot;
+
+// -framehash <file>: one line per frame with a hash of the framebuffers
+static FILE *framehash;
+static int framecount;
+
+//
+// I_StartTic
+//
+void I_StartTic (void)
+{
+  I_PollJoystick();
+}
+
+//
+// I_StartFrame
+//
+// The 3DS build keeps the automap running on the bottom screen; do the
+// same so a benchmark includes it.
+//
+void I_StartFrame (void)
+{
+  if (gamestate == GS_LEVEL)
+    AM_Start();
+  else
+    AM_Stop();
+}
+
+///////////////////////////////////////////////////////////
+// Palette stuff.
+//
+
+static void I_UploadNewPalette(int pal)
+{
+  int pplump = W_GetNumForName("PLAYPAL");
+  int gtlump = (W_CheckNumForName)("GAMMATBL",ns_prboom);
+  const byte *palette = W_CacheLumpNum(pplump);
+  const byte *gtable = (const byte *)W_CacheLumpNum(gtlump) + 256*usegamma;
+  int num_pals = W_LumpLength(pplump) / (3*256);
+  int i;
+
+  if (pal < 0 || pal >= num_pals)
+    pal = 0;
+
+  palette += pal * 3*256;
+  for (i = 0; i < 256; i++, palette += 3)
+    I_BlitSetPaletteEntry(i, gtable[palette[0]], gtable[palette[1]], gtable[palette[2]]);
+
+  W_UnlockLumpNum(pplump);
+  W_UnlockLumpNum(gtlump);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Graphics API
+
+//
+// I_WriteStereoShot
+//
+// Unrotates both top framebuffers into one image, left eye first. The
+// right half repeats the left one if no frame was drawn in stereo.
+//
+static void I_WriteStereoShot(const char *name)
+{
+  FILE *f = fopen(name, "wb");
+  int x, y, eye;
+
+  if (!f) {
+    lprintf(LO_WARN, "I_WriteStereoShot: unable to write %s\n", name);
+    return;
+  }
+
+  fprintf(f, "P6\n%d %d\n255\n", 2*FB_TOP_WIDTH, FB_HEIGHT);
+  for (y = 0; y < FB_HEIGHT; y++)
+    for (eye = 0; eye < 2; eye++) {
+      const byte *fb = eye && fb_right ? fb_right : fb_top;
+
+      for (x = 0; x < FB_TOP_WIDTH; x++) {
+        const byte *p = fb + (x * FB_HEIGHT + FB_HEIGHT - 1 - y) * 3;
+
+        fputc(p[2], f);
+        fputc(p[1], f);
+        fputc(p[0], f);
+      }
+    }
+  fclose(f);
+}
+
+void I_ShutdownGraphics(void)
+{
+  if (stereoshot && fb_top)
+    I_WriteStereoShot(stereoshot);
+
+  if (framehash)
+    fclose(framehash);
+  framehash = NULL;
+
+  free(fb_top);
+  free(fb_bottom);
+  free(fb_right);
+  fb_top = fb_bottom = fb_right = NULL;
+}
+
+//
+// I_UpdateNoBlit
+//
+void I_UpdateNoBlit (void)
+{
+}
+
+//
+// I_BlitScreen
+//
+// Rotate and expand a screen into a framebuffer with the same kernels as
+// the 3DS build, see i_blit.c
+//
+static void I_BlitScreen(const screeninfo_t *scr, byte *fb, int fbwidth)
+{
+  blitdest_t dest;
+  blitrect_t rect;
+
+  if (!scr->data)
+    return;
+
+  dest.fb = fb;
+  dest.fb_width = FB_HEIGHT;
+  dest.fb_height = fbwidth;
+  rect.src = scr->data;
+  rect.src_pitch = scr->byte_pitch;
+  rect.width = MIN(scr->width, fbwidth);
+  rect.height = MIN(scr->height, FB_HEIGHT);
+  rect.x = 0;
+  rect.y = 0;
+  I_BlitGetKernel(V_GetMode(), &dest)(&rect, &dest);
+}
+
+//
+// I_HashFrameBuffer
+// FNV-1a, carried on from the previous buffer's hash
+//
+static unsigned I_HashFrameBuffer(unsigned h, const byte *fb, int size)
+{
+  while (size--)
+    h = (h ^ *fb++) * 16777619u;
+  return h;
+}
+
+//
+// I_WriteFrameHash
+//
+// Covers everything I_FinishUpdate blitted, so two runs of a demo can be
+// compared frame by frame, e.g. with different render_threads.
+//
+static void I_WriteFrameHash(void)
+{
+  unsigned h = 2166136261u;
+
+  h = I_HashFrameBuffer(h, fb_top, FB_TOP_WIDTH * FB_HEIGHT * 3);
+  h = I_HashFrameBuffer(h, fb_bottom, FB_BOTTOM_WIDTH * FB_HEIGHT * 3);
+  if (stereo_frame)
+    h = I_HashFrameBuffer(h, fb_right, FB_TOP_WIDTH * FB_HEIGHT * 3);
+  fprintf(framehash, "%d %d %08x\n", framecount++, gametic, h);
+}
+
+//
+// I_FinishUpdate
+//
+static int newpal = 0;
+#define NO_PALETTE_CHANGE 1000
+
+void I_FinishUpdate (void)
+{
+  if (newpal != NO_PALETTE_CHANGE) {
+    I_UploadNewPalette(newpal);
+    newpal = NO_PALETTE_CHANGE;
+  }
+
+  I_BlitScreen(&screens[SCR_FRONT_L], fb_top, FB_TOP_WIDTH);
+  I_BlitScreen(&screens[SCR_BOTTOM], fb_bottom, FB_BOTTOM_WIDTH);
+  if (stereo_frame) {
+    if (!fb_right)
+      fb_right = calloc(FB_TOP_WIDTH * FB_HEIGHT, 3);
+    I_BlitScreen(&screens[SCR_FRONT_R], fb_right, FB_TOP_WIDTH);
+  }
+  if (framehash)
+    I_WriteFrameHash();
+  V_ClearDirty(SCR_FRONT_L);
+  V_ClearDirty(SCR_BOTTOM);
+}
+
+//
+// I_SetPalette
+//
+void I_SetPalette (int pal)
+{
+  newpal = pal;
+}
+
+// I_PreInitGraphics
+
+void I_PreInitGraphics(void)
+{
+}
+
+// CPhipps -
+// I_CalculateRes
+// Calculates the screen resolution, possibly using the supplied guide
+void I_CalculateRes(unsigned int width, unsigned int height)
+{
+  if (width > MAX_SCREENWIDTH) width = MAX_SCREENWIDTH;
+  if (height > MAX_SCREENHEIGHT) height = MAX_SCREENHEIGHT;
+
+  SCREENWIDTH = (width+15) & ~15;
+  SCREENHEIGHT = height;
+  if (!(SCREENWIDTH % 1024)) {
+    SCREENPITCH = SCREENWIDTH*V_GetPixelDepth()+32;
+  } else {
+    SCREENPITCH = SCREENWIDTH*V_GetPixelDepth();
+  }
+}
+
+// CPhipps -
+// I_SetRes
+// Sets the screen resolution
+void I_SetRes(void)
+{
+  int i;
+
+  I_CalculateRes(SCREENWIDTH, SCREENHEIGHT);
+
+  // set first three to standard values
+  for (i=0; i<NUM_SCREENS; i++) {
+    screens[i].width = SCREENWIDTH;
+    screens[i].height = SCREENHEIGHT;
+    screens[i].byte_pitch = SCREENPITCH;
+    screens[i].short_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE16);
+    screens[i].int_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE32);
+  }
+
+  // statusbar
+  screens[SCR_STBAR].width = SCREENWIDTH;
+  screens[SCR_STBAR].height = (ST_SCALED_HEIGHT+1);
+  screens[SCR_STBAR].byte_pitch = SCREENPITCH;
+  screens[SCR_STBAR].short_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE16);
+  screens[SCR_STBAR].int_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE32);
+
+  // automap
+  screens[SCR_BOTTOM].width = 320;
+  screens[SCR_BOTTOM].height = SCREENHEIGHT;
+  screens[SCR_BOTTOM].byte_pitch = 320 * V_GetPixelDepth();
+  screens[SCR_BOTTOM].short_pitch = screens[SCR_BOTTOM].byte_pitch / V_GetModePixelDepth(VID_MODE16);
+  screens[SCR_BOTTOM].int_pitch = screens[SCR_BOTTOM].byte_pitch / V_GetModePixelDepth(VID_MODE32);
+
+  lprintf(LO_INFO,"I_SetRes: Using resolution %dx%d\n", SCREENWIDTH, SCREENHEIGHT);
+}
+
+void I_InitGraphics(void)
+{
+  static int    firsttime=1;
+  int p;
+
+  if (firsttime)
+  {
+    firsttime = 0;
+
+    atexit(I_ShutdownGraphics);
+    if ((p = M_CheckParm("-stereoshot")) && ++p < myargc)
+      stereoshot = myargv[p];
+    if ((p = M_CheckParm("-framehash")) && ++p < myargc
+        && !(framehash = fopen(myargv[p], "w")))
+      I_Error("I_InitGraphics: unable to write %s", myargv[p]);
+    lprintf(LO_INFO, "I_InitGraphics: %dx%d\n", SCREENWIDTH, SCREENHEIGHT);
+
+    /* Set the video mode */
+    I_UpdateVideoMode();
+
+    /* Initialize palette */
+    I_UploadNewPalette(0);
+
+    /* Initialize the input system */
+    I_InitJoystick();
+  }
+}
+
+void I_UpdateVideoMode(void)
+{
+  lprintf(LO_INFO, "I_UpdateVideoMode: %dx%d\n", SCREENWIDTH, SCREENHEIGHT);
+
+  // the drawers and the blit only handle 8-bit screens here
+  V_InitMode(VID_MODE8);
+  V_DestroyUnusedTrueColorPalettes();
+  V_FreeScreens();
+
+  I_SetRes();
+
+  V_AllocScreens();
+
+  R_InitBuffer(SCREENWIDTH, SCREENHEIGHT);
+
+  if (!fb_top) {
+    fb_top = calloc(FB_TOP_WIDTH * FB_HEIGHT, 3);
+    fb_bottom = calloc(FB_BOTTOM_WIDTH * FB_HEIGHT, 3);
+  }
+}
+
+//
+// I_ScreenShot
+//
+int I_ScreenShot (const char *fname)
+{
+  return 0;
+}
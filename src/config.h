@@ -1,4 +1,6 @@
+#ifdef _3DS
 #define HAVE_STRLWR
+#endif
 
 /* config.h.  Generated from config.h.in by configure.  */
 /* config.h.in.  Generated from configure.ac by autoheader.  */
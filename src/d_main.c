@@ -81,6 +81,8 @@
 #include "d_main.h"
 #include "d_deh.h"  // Ty 04/08/98 - Externalizations
 #include "lprintf.h"  // jff 08/03/98 - declaration of lprintf
+#include "m_bench.h"
+#include "p_tick.h"
 #include "am_map.h"
 
 void GetFirstMap(int *ep, int *map); // Ty 08/29/98 - add "-warp x" functionality
@@ -220,6 +222,8 @@ void D_Display (void)
   if (!I_StartDisplay())
     return;
 
+  stereo_frame = false; // until R_RenderPlayerView draws both eyes
+
   // save the current screen if about to wipe
   if ((wipe = gamestate != wipegamestate) && (V_GetMode() != VID_MODEGL))
     wipe_StartScreen();
@@ -311,10 +315,14 @@ void D_Display (void)
 #endif
 
   // normal update
-  if (!wipe || (V_GetMode() == VID_MODEGL))
+  if (!wipe || (V_GetMode() == VID_MODEGL)) {
+    R_FinishStereoFrame();
+    M_BenchBegin(bench_blit);
     I_FinishUpdate ();              // page flip or blit buffer
-  else {
+    M_BenchEnd(bench_blit);
+  } else {
     // wipe update
+    stereo_frame = false;
     wipe_EndScreen();
     D_Wipe();
   }
@@ -350,6 +358,7 @@ static void D_DoomLoop(void)
       WasRenderedInTryRunTics = false;
       // frame syncronous IO operations
       I_StartFrame ();
+      W_PrefetchPoll ();
 
       if (ffmap == gamemap) ffmap = 0;
 
@@ -1175,6 +1184,10 @@ static void D_DoomMainSetup(void)
     } while (rsp_found==true);
   }
 
+  // compare two -checksum streams and quit, see p_checksum.c
+  if ((p = M_CheckParm("-checksumcompare")) && p+2 < myargc)
+    I_SafeExit(P_CompareChecksums(myargv[p+1], myargv[p+2]));
+
   lprintf(LO_INFO,"M_LoadDefaults: Load system defaults.\n");
   M_LoadDefaults();              // load before initing other systems
 
@@ -1505,6 +1518,9 @@ static void D_DoomMainSetup(void)
       if ((p = M_CheckParm ("-ffmap")) && p < myargc-1) {
         ffmap = atoi(myargv[p+1]);
       }
+      if ((p = M_CheckParm ("-skipsec")) && p < myargc-1) {
+        demoskiptics = (int)(atof(myargv[p+1]) * TICRATE);
+      }
 
     }
 
@@ -1607,8 +1623,24 @@ static void D_DoomMainSetup(void)
   if ((p = M_CheckParm ("-checksum")) && ++p < myargc)
     {
       P_RecordChecksum (myargv[p]);
+      if ((p = M_CheckParm ("-checksumdump")) && ++p < myargc)
+        P_DumpChecksumTic (atoi(myargv[p]));
+      if (M_CheckParm ("-checksumverify"))
+        P_VerifyChecksums ();
     }
 
+  // time each subsystem during -timedemo/-fastdemo, see m_bench.c
+  if ((p = M_CheckParm ("-benchmark")) && ++p < myargc)
+    M_BenchInit(myargv[p]);
+
+  // thinker profiling and the flat thinker array, see p_tick.c
+  thinkerprofile = M_CheckParm("-thinkerprofile") > 0;
+  thinkerarray = M_CheckParm("-thinkerarray") > 0;
+
+  // draw both eyes, overriding stereo_separation, see r_main.c
+  if ((p = M_CheckParm ("-stereo")) && ++p < myargc)
+    stereo_separation = atoi(myargv[p]);
+
   if ((p = M_CheckParm ("-fastdemo")) && ++p < myargc)
     {                                 // killough
       fastdemo = true;                // run at fastest speed possible
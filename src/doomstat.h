@@ -267,6 +267,7 @@ extern  int             mouseSensitivity_vert;
 extern  boolean         singletics;
 
 extern  int             bodyqueslot;
+extern  mobj_t          **bodyque;      // player corpses, see G_CheckSpot
 
 // Needed to store the number of the dummy sky flat.
 // Used for rendering, as well as tracking projectiles etc.
@@ -85,10 +85,12 @@ typedef unsigned __int64 uint_64_t;
 #define CONSTFUNC __attribute__((const))
 #define PUREFUNC __attribute__((pure))
 #define NORETURN __attribute__ ((noreturn))
+#define THREADLOCAL __thread
 #else
 #define CONSTFUNC
 #define PUREFUNC
 #define NORETURN
+#define THREADLOCAL
 #endif
 
 /* CPhipps - use limits.h instead of depreciated values.h */
@@ -86,8 +86,10 @@
 #include "i_system.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#include "m_bench.h"
 
 #define SAVEGAMESIZE  0x20000
+#define DEMOSEEKSTEP  (10*TICRATE)  // tics skipped by key_demo_rewind/forward
 #define SAVESTRINGSIZE  24
 
 static size_t   savegamesize = SAVEGAMESIZE; // killough
@@ -96,6 +98,8 @@ static const byte *demobuffer;   /* cph - only used for playback */
 static int demolength; // check for overrun (missing DEMOMARKER)
 static FILE    *demofp; /* cph - record straight to file */
 static const byte *demo_p;
+static int demotic;              // demo tics read, see G_DemoSeek
+static int demoseektic = -1;     // pending seek target, -1 = none
 static short    consistancy[MAXPLAYERS][BACKUPTICS];
 
 gameaction_t    gameaction;
@@ -191,6 +195,8 @@ int     key_quit;
 int     key_gamma;
 int     key_spy;
 int     key_pause;
+int     key_demo_rewind;
+int     key_demo_forward;
 int     key_setup;
 int     destination_keys[MAXPLAYERS];
 int     key_weaponcycleup;
@@ -261,6 +267,8 @@ int    bodyqueslot, bodyquesize;        // killough 2/8/98
 mobj_t **bodyque = 0;                   // phares 8/10/98
 
 static void G_DoSaveGame (boolean menu);
+static void G_TakeDemoSnapshot(void);
+static void G_DoDemoSeek(void);
 static const byte* G_ReadDemoHeader(const byte* demo_p, size_t size, boolean failonerror);
 
 //
@@ -693,6 +701,17 @@ boolean G_Responder (event_t* ev)
     return true;
   }
 
+      // skip back or ahead in the demo, see G_DemoSeek
+      if (ev->type == ev_keydown && demoplayback &&
+          (ev->data1 == key_demo_rewind || ev->data1 == key_demo_forward))
+  {
+    int tic = demoseektic >= 0 ? demoseektic : demotic;
+
+    G_DemoSeek(ev->data1 == key_demo_rewind ?
+               tic - DEMOSEEKSTEP : tic + DEMOSEEKSTEP);
+    return true;
+  }
+
       // killough 10/98:
       // Don't pop up menu, if paused in middle
       // of demo playback, or if automap active.
@@ -775,6 +794,11 @@ void G_Ticker (void)
 #endif
     G_ChangedPlayerColour(consoleplayer, mapcolor_me);
   }
+  // run the tics up to a pending seek target first, so this tic
+  // continues from there as usual
+  if (demoseektic >= 0)
+    G_DoDemoSeek();
+
   P_MapStart();
   // do player reborns if needed
   for (i=0 ; i<MAXPLAYERS ; i++)
@@ -819,6 +843,9 @@ void G_Ticker (void)
         }
     }
 
+  if (demoplayback && gamestate == GS_LEVEL)
+    G_TakeDemoSnapshot();
+
   if (paused & 2 || (!demoplayback && menuactive && !netgame))
     basetic++;  // For revenant tracers and RNG -- we must maintain sync
   else {
@@ -861,6 +888,8 @@ void G_Ticker (void)
             }
         }
     }
+    if (demoplayback)
+      demotic++;
 
     // check for special buttons
     for (i=0; i<MAXPLAYERS; i++) {
@@ -938,7 +967,9 @@ void G_Ticker (void)
   switch (gamestate)
     {
     case GS_LEVEL:
+      M_BenchBegin(bench_playsim);
       P_Ticker ();
+      M_BenchEnd(bench_playsim);
       ST_Ticker ();
       AM_Ticker ();
       HU_Ticker ();
@@ -2236,6 +2267,194 @@ void G_ReadDemoTiccmd (ticcmd_t* cmd)
     }
 }
 
+//
+// DEMO SEEKING
+//
+// While a demo plays, the game state is archived into memory with the
+// savegame code every demo_snapshot_interval tics. A seek restores the
+// last snapshot at or before the target and runs the remaining tics
+// without drawing, so it never costs more than one interval of playsim
+// time. When the snapshots outgrow demo_snapshot_kb every other one is
+// dropped and the interval doubles. Demos that can't be seeked in, like
+// the title loop, take no snapshots.
+//
+
+int demo_snapshot_interval;   // tics between snapshots, 0 = no snapshots
+int demo_snapshot_kb;         // memory for the snapshots of one demo
+int demoskiptics;             // -skipsec, seek as soon as the demo starts
+
+typedef struct {
+  int demotic;                // demo tics read when it was taken
+  int demopos;                // offset of demo_p into the demo
+  size_t size;
+  byte *data;
+} demosnapshot_t;
+
+static demosnapshot_t *demosnapshots;
+static int numdemosnapshots, maxdemosnapshots;
+static size_t demosnapshotbytes;
+static int demosnapshotstep;
+static boolean demoskipped;   // this demo started with -skipsec
+
+static void G_FreeDemoSnapshots(void)
+{
+  while (numdemosnapshots)
+    free(demosnapshots[--numdemosnapshots].data);
+  demosnapshotbytes = 0;
+  demosnapshotstep = demo_snapshot_interval;
+}
+
+// Keep every other snapshot. The first one stays, so the start of the
+// demo can always be reached again.
+static void G_ThinDemoSnapshots(void)
+{
+  int i, j;
+
+  for (i = j = 0; i < numdemosnapshots; i++)
+    if (i & 1) {
+      demosnapshotbytes -= demosnapshots[i].size;
+      free(demosnapshots[i].data);
+    } else
+      demosnapshots[j++] = demosnapshots[i];
+  numdemosnapshots = j;
+  demosnapshotstep *= 2;
+}
+
+//
+// G_TakeDemoSnapshot
+// Called between tics while a level is being played back
+//
+static void G_TakeDemoSnapshot(void)
+{
+  demosnapshot_t *snap;
+  int tics = gametic - basetic;
+
+  if (!demo_snapshot_interval || (numdemosnapshots &&
+      demotic < demosnapshots[numdemosnapshots-1].demotic + demosnapshotstep))
+    return;
+  if (!key_demo_rewind && !key_demo_forward && !demoskipped)
+    return;
+
+  save_p = savebuffer = malloc(savegamesize);
+
+  CheckSaveGame(3+sizeof leveltime+sizeof totalleveltimes+sizeof tics);
+  *save_p++ = gameskill;
+  *save_p++ = gameepisode;
+  *save_p++ = gamemap;
+  memcpy(save_p, &leveltime, sizeof leveltime);
+  save_p += sizeof leveltime;
+  memcpy(save_p, &totalleveltimes, sizeof totalleveltimes);
+  save_p += sizeof totalleveltimes;
+  // the whole revenant tracer phase, not just the low byte a savegame keeps
+  memcpy(save_p, &tics, sizeof tics);
+  save_p += sizeof tics;
+
+  P_ArchivePlayers();
+  P_ThinkerToIndex();
+  P_ArchiveWorld();
+  P_ArchiveThinkers();
+  P_IndexToThinker();
+  P_ArchiveSpecials();
+  P_ArchiveExtras();
+  P_IndexToThinker();
+  P_ArchiveRNG();
+  P_ArchiveMap();
+
+  if (numdemosnapshots >= maxdemosnapshots)
+    demosnapshots = realloc(demosnapshots, sizeof(*demosnapshots) *
+      (maxdemosnapshots = maxdemosnapshots ? maxdemosnapshots*2 : 32));
+  snap = &demosnapshots[numdemosnapshots++];
+  snap->demotic = demotic;
+  snap->demopos = demo_p - demobuffer;
+  snap->size = save_p - savebuffer;
+  snap->data = realloc(savebuffer, snap->size);
+  savebuffer = save_p = NULL;
+
+  demosnapshotbytes += snap->size;
+  while (numdemosnapshots > 1 &&
+         demosnapshotbytes > (size_t)demo_snapshot_kb * 1024)
+    G_ThinDemoSnapshots();
+}
+
+// Same order as G_DoLoadGame, without the header and options, which
+// can't change during a demo
+static void G_RestoreDemoSnapshot(const demosnapshot_t *snap)
+{
+  int tics;
+
+  save_p = snap->data;
+  G_InitNew(save_p[0], save_p[1], save_p[2]);
+  save_p += 3;
+  memcpy(&leveltime, save_p, sizeof leveltime);
+  save_p += sizeof leveltime;
+  memcpy(&totalleveltimes, save_p, sizeof totalleveltimes);
+  save_p += sizeof totalleveltimes;
+  memcpy(&tics, save_p, sizeof tics);
+  save_p += sizeof tics;
+  basetic = gametic - tics;
+
+  P_MapStart();
+  P_UnArchivePlayers();
+  P_UnArchiveWorld();
+  P_UnArchiveThinkers();
+  P_UnArchiveSpecials();
+  P_UnArchiveExtras();
+  P_UnArchiveRNG();
+  P_UnArchiveMap();
+  P_MapEnd();
+  R_SmoothPlaying_Reset(NULL);
+  save_p = NULL;
+
+  demo_p = demobuffer + snap->demopos;
+  demotic = snap->demotic;
+  usergame = false;           // G_InitNew set it
+}
+
+//
+// G_DoDemoSeek
+// Called at the start of G_Ticker, so the tic that follows is the one
+// the seek asked for
+//
+static void G_DoDemoSeek(void)
+{
+  int target = demoseektic;
+  int i;
+
+  demoseektic = -1;
+  if (paused & 2) {
+    paused &= ~2;
+    S_ResumeSound();
+  }
+
+  // restore the last snapshot before the target, unless it's
+  // quicker to carry on from here
+  for (i = numdemosnapshots; i-- > 0; )
+    if (demosnapshots[i].demotic <= target)
+      break;
+  if (i >= 0 && (target < demotic || demosnapshots[i].demotic > demotic))
+    G_RestoreDemoSnapshot(&demosnapshots[i]);
+  else if (target < demotic)
+    return;                   // snapshots are off, can't go back
+
+  // gametic stands still so the main loop keeps its pace; basetic moves
+  // instead to keep the revenant tracers in step
+  while (demoplayback && demotic < target && *demo_p != DEMOMARKER &&
+         demo_p < demobuffer + demolength) {
+    G_Ticker();
+    basetic--;
+  }
+}
+
+//
+// G_DemoSeek
+// Continue playback from the given demo tic
+//
+void G_DemoSeek(int tic)
+{
+  if (demoplayback)
+    demoseektic = MAX(tic, 0);
+}
+
 /* Demo limits removed -- killough
  * cph - record straight to file
  */
@@ -2903,7 +3122,14 @@ void G_DoPlayDemo(void)
   demoplayback = true;
   R_SmoothPlaying_Reset(NULL); // e6y
 
+  G_FreeDemoSnapshots();
+  demotic = 0;
+  demoseektic = demoskiptics ? demoskiptics : -1;
+  demoskipped = demoskiptics > 0;
+  demoskiptics = 0;
+
   starttime = I_GetTime_RealTime ();
+  M_BenchReset();
 }
 
 /* G_CheckDemoStatus
@@ -2928,6 +3154,13 @@ boolean G_CheckDemoStatus (void)
       int endtime = I_GetTime_RealTime ();
       // killough -- added fps information and made it work for longer demos:
       unsigned realtics = endtime-starttime;
+      if (benchmarking)
+        {
+          M_BenchReport(gametic);
+          lprintf(LO_INFO, "Timed %u gametics in %u realtics\n",
+                  (unsigned) gametic, realtics);
+          I_SafeExit(0);
+        }
       I_Error ("Timed %u gametics in %u realtics = %-.1f frames per second",
                (unsigned) gametic,realtics,
                (unsigned) gametic * (double) TICRATE / realtics);
@@ -2938,6 +3171,9 @@ boolean G_CheckDemoStatus (void)
       if (singledemo)
         exit(0);  // killough
 
+      G_FreeDemoSnapshots();
+      demoseektic = -1;
+
       if (demolumpnum != -1) {
   // cph - unlock the demo lump
   W_UnlockLumpNum(demolumpnum);
@@ -70,6 +70,7 @@ void G_DoPlayDemo(void);
 void G_DoCompleted(void);
 void G_ReadDemoTiccmd(ticcmd_t *cmd);
 void G_WriteDemoTiccmd(ticcmd_t *cmd);
+void G_DemoSeek(int tic);        // continue playback from this demo tic
 void G_DoWorldDone(void);
 void G_Compatibility(void);
 const byte *G_ReadOptions(const byte *demo_p);   /* killough 3/1/98 - cph: const byte* */
@@ -126,6 +127,8 @@ extern int  key_quit;
 extern int  key_gamma;
 extern int  key_spy;
 extern int  key_pause;
+extern int  key_demo_rewind;
+extern int  key_demo_forward;
 extern int  key_setup;
 extern int  key_forward;
 extern int  key_leftturn;
@@ -166,6 +169,11 @@ extern boolean haswolflevels;  //jff 4/18/98 wolf levels present
 
 extern int  bodyquesize;       // killough 2/8/98: adustable corpse limit
 
+// in-memory snapshots for seeking in demos, see G_DemoSeek
+extern int  demo_snapshot_interval;
+extern int  demo_snapshot_kb;
+extern int  demoskiptics;
+
 // killough 5/2/98: moved from d_deh.c:
 // Par times (new item with BOOM) - from g_game.c
 extern int pars[4][10];  // hardcoded array size
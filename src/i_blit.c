@@ -0,0 +1,251 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2006 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *  Copyright 2015 by
+ *  Devin Acker
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Palette expansion and 90 degree rotation of the software screens
+ *  into the 3DS framebuffer layout.
+ *
+ *  The tiled kernels read an 8x8 block of the source, transpose it, and
+ *  write each of the 8 resulting framebuffer runs as six aligned words
+ *  (8 pixels * 3 bytes). The scalar kernels do one pixel at a time and
+ *  are used for ragged edges and for destinations that can't take
+ *  word stores.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <stdint.h>
+
+#include "doomtype.h"
+#include "v_video.h"
+#include "lprintf.h"
+#include "i_blit.h"
+
+// palette entries packed as 0x00RRGGBB, i.e. B,G,R in memory order
+static uint32_t blit_palette[256];
+
+int_64_t blit_pixels;  // pixels handed to the kernels, for -benchmark
+
+void I_BlitSetPaletteEntry(int index, byte r, byte g, byte b)
+{
+  blit_palette[index & 255] = b | (g << 8) | (r << 16);
+}
+
+//
+// address of rect pixel (row, col) in the rotated framebuffer
+//
+static inline byte *I_BlitDestPixel(const blitdest_t *dest, int x, int y)
+{
+  return dest->fb + ((x * dest->fb_width) + (dest->fb_width - y - 1)) * 3;
+}
+
+//
+// Scalar kernels
+//
+
+static void I_Blit8_ScalarArea(const blitrect_t *rect, const blitdest_t *dest,
+                               int r1, int r2, int c1, int c2)
+{
+  int r, c;
+
+  for (r = r1; r < r2; r++) {
+    const byte *src = rect->src + r * rect->src_pitch + c1;
+
+    for (c = c1; c < c2; c++) {
+      byte *d = I_BlitDestPixel(dest, rect->x + c, rect->y + r);
+      uint32_t px = blit_palette[*src++];
+
+      d[0] = (byte)px;
+      d[1] = (byte)(px >> 8);
+      d[2] = (byte)(px >> 16);
+    }
+  }
+}
+
+static void I_Blit32_ScalarArea(const blitrect_t *rect, const blitdest_t *dest,
+                                int r1, int r2, int c1, int c2)
+{
+  int r, c;
+
+  for (r = r1; r < r2; r++) {
+    const byte *src = rect->src + r * rect->src_pitch + c1 * 4;
+
+    for (c = c1; c < c2; c++, src += 4) {
+      byte *d = I_BlitDestPixel(dest, rect->x + c, rect->y + r);
+
+      d[0] = src[0];
+      d[1] = src[1];
+      d[2] = src[2];
+    }
+  }
+}
+
+void I_Blit8_Scalar(const blitrect_t *rect, const blitdest_t *dest)
+{
+  blit_pixels += rect->width * rect->height;
+  I_Blit8_ScalarArea(rect, dest, 0, rect->height, 0, rect->width);
+}
+
+void I_Blit32_Scalar(const blitrect_t *rect, const blitdest_t *dest)
+{
+  blit_pixels += rect->width * rect->height;
+  I_Blit32_ScalarArea(rect, dest, 0, rect->height, 0, rect->width);
+}
+
+#ifndef WORDS_BIGENDIAN
+
+//
+// Tiled kernels
+//
+// Framebuffer runs go bottom to top, so source row r0+7 of a tile is the
+// lowest address of each run and row r0 the highest.
+//
+
+// store 8 packed 24 bit pixels (q[0] lowest address) as 6 words
+static inline void I_BlitStoreRun(uint32_t *d, const uint32_t *q)
+{
+  d[0] = q[0]        | (q[1] << 24);
+  d[1] = (q[1] >> 8) | (q[2] << 16);
+  d[2] = (q[2] >> 16)| (q[3] << 8);
+  d[3] = q[4]        | (q[5] << 24);
+  d[4] = (q[5] >> 8) | (q[6] << 16);
+  d[5] = (q[6] >> 16)| (q[7] << 8);
+}
+
+// first row at which a tile's runs land on a word boundary
+static inline int I_BlitAlignRow(const blitrect_t *rect, const blitdest_t *dest)
+{
+  return (dest->fb_width - rect->y) & 3;
+}
+
+static void I_Blit8_Tiled(const blitrect_t *rect, const blitdest_t *dest)
+{
+  int r0, c0, j, k;
+  int rstart = MIN(I_BlitAlignRow(rect, dest), rect->height);
+  int rend = rstart + ((rect->height - rstart) & ~7);
+  int cend = rect->width & ~7;
+
+  blit_pixels += rect->width * rect->height;
+  for (r0 = rstart; r0 < rend; r0 += 8) {
+    for (c0 = 0; c0 < cend; c0 += 8) {
+      byte tile[8][8];
+      uint32_t q[8];
+
+      for (k = 0; k < 8; k++)
+        memcpy(tile[k], rect->src + (r0 + k) * rect->src_pitch + c0, 8);
+
+      for (j = 0; j < 8; j++) {
+        uint32_t *d = (uint32_t *)I_BlitDestPixel(dest, rect->x + c0 + j, rect->y + r0 + 7);
+
+        for (k = 0; k < 8; k++)
+          q[k] = blit_palette[tile[7 - k][j]];
+        I_BlitStoreRun(d, q);
+      }
+    }
+  }
+
+  // ragged edges
+  I_Blit8_ScalarArea(rect, dest, 0, rstart, 0, rect->width);
+  I_Blit8_ScalarArea(rect, dest, rend, rect->height, 0, rect->width);
+  I_Blit8_ScalarArea(rect, dest, rstart, rend, cend, rect->width);
+}
+
+static void I_Blit32_Tiled(const blitrect_t *rect, const blitdest_t *dest)
+{
+  int r0, c0, j, k;
+  int rstart = MIN(I_BlitAlignRow(rect, dest), rect->height);
+  int rend = rstart + ((rect->height - rstart) & ~7);
+  int cend = rect->width & ~7;
+
+  blit_pixels += rect->width * rect->height;
+  for (r0 = rstart; r0 < rend; r0 += 8) {
+    for (c0 = 0; c0 < cend; c0 += 8) {
+      uint32_t tile[8][8];
+      uint32_t q[8];
+
+      for (k = 0; k < 8; k++)
+        memcpy(tile[k], rect->src + (r0 + k) * rect->src_pitch + c0 * 4, 8 * 4);
+
+      for (j = 0; j < 8; j++) {
+        uint32_t *d = (uint32_t *)I_BlitDestPixel(dest, rect->x + c0 + j, rect->y + r0 + 7);
+
+        for (k = 0; k < 8; k++)
+          q[k] = tile[7 - k][j] & 0xffffff;
+        I_BlitStoreRun(d, q);
+      }
+    }
+  }
+
+  I_Blit32_ScalarArea(rect, dest, 0, rstart, 0, rect->width);
+  I_Blit32_ScalarArea(rect, dest, rend, rect->height, 0, rect->width);
+  I_Blit32_ScalarArea(rect, dest, rstart, rend, cend, rect->width);
+}
+
+#endif // WORDS_BIGENDIAN
+
+//
+// I_BlitGetKernel
+//
+// The tiled kernels need word aligned framebuffer lines; anything else
+// (or a big-endian host) gets the scalar ones.
+//
+I_BlitKernel_f I_BlitGetKernel(video_mode_t mode, const blitdest_t *dest)
+{
+#ifndef WORDS_BIGENDIAN
+  boolean aligned = !((uintptr_t)dest->fb & 3) && !(dest->fb_width & 3);
+#else
+  boolean aligned = false;
+#endif
+
+  switch (mode) {
+  case VID_MODE8:
+#ifndef WORDS_BIGENDIAN
+    if (aligned)
+      return I_Blit8_Tiled;
+#endif
+    return I_Blit8_Scalar;
+
+  case VID_MODE32:
+#ifndef WORDS_BIGENDIAN
+    if (aligned)
+      return I_Blit32_Tiled;
+#endif
+    return I_Blit32_Scalar;
+
+  default:
+    I_Error("I_BlitGetKernel: unsupported video mode");
+  }
+  return NULL;
+}
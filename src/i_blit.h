@@ -0,0 +1,77 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2006 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *  Copyright 2015 by
+ *  Devin Acker
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Palette expansion and 90 degree rotation of the software screens
+ *  into the 3DS framebuffer layout. Contains no libctru calls so it
+ *  can be built and timed on any host.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef __I_BLIT__
+#define __I_BLIT__
+
+#include "doomtype.h"
+#include "v_video.h"
+
+/* The 3DS LCDs are mounted sideways: every framebuffer line is one screen
+ * column, stored bottom to top, three bytes (B,G,R) per pixel. */
+typedef struct {
+  byte *fb;            // framebuffer base
+  int fb_width;        // pixels per framebuffer line (screen height)
+  int fb_height;       // number of framebuffer lines (screen width)
+} blitdest_t;
+
+/* One source rectangle to blit, in screen coordinates. */
+typedef struct {
+  const byte *src;     // top-left pixel of the rectangle
+  int src_pitch;       // bytes per source line
+  int width, height;   // size of the rectangle
+  int x, y;            // destination position on the LCD
+} blitrect_t;
+
+typedef void (*I_BlitKernel_f)(const blitrect_t *rect, const blitdest_t *dest);
+
+// Set one entry of the packed palette used by the 8 bit kernels.
+void I_BlitSetPaletteEntry(int index, byte r, byte g, byte b);
+
+// Pick the best kernel for a mode and destination; done once per frame
+// rather than per pixel.
+I_BlitKernel_f I_BlitGetKernel(video_mode_t mode, const blitdest_t *dest);
+
+// Pixels blitted so far, over all kernels
+extern int_64_t blit_pixels;
+
+// Reference kernels, kept around for benchmarking against the tiled ones.
+void I_Blit8_Scalar(const blitrect_t *rect, const blitdest_t *dest);
+void I_Blit32_Scalar(const blitrect_t *rect, const blitdest_t *dest);
+
+#endif
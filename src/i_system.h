@@ -53,6 +53,9 @@ unsigned long I_GetRandomTimeSeed(void); /* cphipps */
 
 void I_uSleep(unsigned long usecs);
 
+/* Monotonic clock in nanoseconds, for profiling (see m_bench.c) */
+int_64_t I_GetProfileTime(void);
+
 /* cphipps - I_GetVersionString
  * Returns a version string in the given buffer
  */
@@ -0,0 +1,65 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      System interface, threads.
+ *
+ *-----------------------------------------------------------------------------*/
+
+
+#ifndef __I_THREAD__
+#define __I_THREAD__
+
+#include "doomtype.h"
+
+typedef struct i_thread_s i_thread_t;
+typedef struct i_mutex_s i_mutex_t;
+typedef struct i_event_s i_event_t;
+
+typedef void (*I_ThreadFunc_f)(void *arg);
+
+/* Number of CPU cores worker threads can run on, including the main one */
+int I_GetNumCores(void);
+
+/* Starts a thread, preferably on the given core (-1 for any) */
+i_thread_t *I_CreateThread(I_ThreadFunc_f func, void *arg, int core);
+void I_JoinThread(i_thread_t *thread);
+
+i_mutex_t *I_CreateMutex(void);
+void I_DestroyMutex(i_mutex_t *mutex);
+void I_LockMutex(i_mutex_t *mutex);
+void I_UnlockMutex(i_mutex_t *mutex);
+
+/* Auto-reset events: I_WaitEvent blocks until the event is signalled,
+ * then clears it again. Signalling an already signalled event does nothing. */
+i_event_t *I_CreateEvent(void);
+void I_DestroyEvent(i_event_t *event);
+void I_SignalEvent(i_event_t *event);
+void I_WaitEvent(i_event_t *event);
+
+#endif
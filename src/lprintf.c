@@ -37,7 +37,9 @@
 #include "config.h"
 #endif
 
+#ifdef _3DS
 #include <3ds.h>
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -63,8 +65,10 @@ int Init_ConsoleWin(void)
 {
 	if (!showconsole) {
 		showconsole = 1;
+#ifdef _3DS
 		consoleInit(GFX_BOTTOM, 0);
 		consoleDebugInit(debugDevice_3DMOO);
+#endif
 	}
 	return 1;
 }
@@ -125,11 +129,13 @@ void I_Error(const char *error, ...)
   
   Init_ConsoleWin();
   lprintf(LO_ERROR, "%s\n", errmsg);
+#ifdef _3DS
   lprintf(LO_ERROR, "press any button to quit\n");
   gfxFlushBuffers();
   gfxSwapBuffers();
   gspWaitForVBlank();
   while (hidScanInput(), !hidKeysDown());
+#endif
   
   I_SafeExit(-1);
 }
@@ -0,0 +1,354 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Per-subsystem timing of demo playback. The clock is only read when
+ *  -benchmark is given; the report is a small JSON object so scripts
+ *  can compare runs.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "i_system.h"
+#include "lprintf.h"
+#include "p_map.h"
+#include "p_tick.h"
+#include "info.h"
+#include "r_main.h"
+#include "r_patch.h"
+#include "r_segs.h"
+#include "i_blit.h"
+#include "m_bench.h"
+
+boolean benchmarking;
+
+static const char *benchreport;
+static int_64_t benchepoch;
+static unsigned int benchframes;
+
+static const char *const benchnames[NUMBENCH] = {
+  "playsim", "bsp", "segs", "planes", "masked", "blit"
+};
+
+static int_64_t benchstart[NUMBENCH];
+static int_64_t benchtotal[NUMBENCH];
+
+// traces are bucketed by intercept count: 0, 1, 2-3, 4-7 ... 256+
+#define NUMTRACEBUCKETS 10
+
+static int_64_t tracetime[NUMTRACEBUCKETS];
+static unsigned int tracecount[NUMTRACEBUCKETS];
+
+// stereo totals at the start of the demo
+static stereostats_t stereobase;
+static int_64_t wallbase[2];
+static int_64_t blitbase;
+
+void M_BenchInit(const char *reportname)
+{
+  benchreport = reportname;
+  benchmarking = true;
+  M_BenchReset();
+}
+
+//
+// M_BenchReset
+// Called when demo playback starts, so startup isn't counted
+//
+void M_BenchReset(void)
+{
+  memset(benchtotal, 0, sizeof(benchtotal));
+  memset(tracetime, 0, sizeof(tracetime));
+  memset(tracecount, 0, sizeof(tracecount));
+  P_ResetThinkerStats();
+  R_GetStereoStats(&stereobase);
+  memcpy(wallbase, wallcolumns, sizeof(wallbase));
+  blitbase = blit_pixels;
+  benchframes = 0;
+  benchepoch = I_GetProfileTime();
+}
+
+void M_BenchFrame(void)
+{
+  if (benchmarking)
+    benchframes++;
+}
+
+void M_BenchBeginSection(benchsection_t section)
+{
+  benchstart[section] = I_GetProfileTime();
+}
+
+void M_BenchEndSection(benchsection_t section)
+{
+  benchtotal[section] += I_GetProfileTime() - benchstart[section];
+}
+
+void M_BenchTrace(unsigned int intercepts, int_64_t start)
+{
+  int bucket = 0;
+
+  while (intercepts && bucket < NUMTRACEBUCKETS-1) {
+    intercepts >>= 1;
+    bucket++;
+  }
+  tracetime[bucket] += I_GetProfileTime() - start;
+  tracecount[bucket]++;
+}
+
+//
+// M_BenchThinkers
+// Thinker functions and mobj types that ran, with -thinkerprofile
+//
+static void M_BenchThinkers(FILE *f)
+{
+  const thinkerstat_t *stat = P_GetThinkerStats();
+  const char *sep = "";
+  int i;
+
+  fprintf(f, "  \"thinkers\": [");
+  for (i = 0; i < NUMTHINKERSTATS; i++)
+    if (stat[i].calls) {
+      fprintf(f, "%s\n    { \"function\": \"%s\", \"calls\": %u, \"ms\": %.3f }",
+              sep, stat[i].name, stat[i].calls, stat[i].time / 1e6);
+      sep = ",";
+    }
+  fprintf(f, "\n  ],\n");
+
+  stat = P_GetMobjThinkerStats();
+  sep = "";
+  fprintf(f, "  \"mobjs\": [");
+  for (i = 0; i < NUMMOBJTYPES; i++)
+    if (stat[i].calls) {
+      fprintf(f, "%s\n    { \"type\": %d, \"doomednum\": %d, \"calls\": %u, \"ms\": %.3f }",
+              sep, i, mobjinfo[i].doomednum, stat[i].calls, stat[i].time / 1e6);
+      sep = ",";
+    }
+  fprintf(f, "\n  ]\n");
+}
+
+//
+// M_BenchBlitLoop
+// The loop I_TranslateFrameBuffer used before the blit kernels, kept as
+// the baseline: one pixel at a time, switching on V_GetMode() for each
+// and reading the palette as separate r, g, b bytes
+//
+static struct { byte r, g, b; } benchpal[256];
+
+static void M_BenchBlitLoop(const blitrect_t *rect, const blitdest_t *dest)
+{
+  byte *fb = dest->fb;
+  uint16_t width = dest->fb_width;
+  uint16_t x, y;
+  const byte *src = rect->src;
+
+  for (x = rect->y; x < rect->height + rect->y; x++) {
+    for (y = rect->x; y < rect->width + rect->x; y++) {
+      byte *d = fb + ((y * width + (width - x - 1)) * 3);
+      byte px;
+
+      switch (V_GetMode()) {
+      case VID_MODE8:
+        px = *src++;
+
+        *d++ = benchpal[px].b;
+        *d++ = benchpal[px].g;
+        *d++ = benchpal[px].r;
+        break;
+
+      case VID_MODE32:
+        *d++ = *src++;
+        *d++ = *src++;
+        *d++ = *src++;
+        src++;
+        break;
+
+      default:
+        I_Error("M_BenchBlitLoop: unsupported video mode");
+      }
+    }
+  }
+}
+
+//
+// M_BenchBlitKernels
+// Mpixels/s of the kernel the 3DS picks for an 8 bit top screen, of the
+// scalar reference and of the old per-pixel loop, blitting a 400x240
+// screen into a framebuffer laid out like the 3DS one
+//
+static void M_BenchBlitKernels(double *tiled, double *scalar, double *loop)
+{
+  enum { W = 400, H = 240, REPS = 50 };
+  byte *src = malloc(W * H);
+  byte *fb = malloc(W * H * 3);
+  int_64_t pixels = blit_pixels;
+  I_BlitKernel_f kernel[3];
+  double *result[3];
+  blitdest_t dest;
+  blitrect_t rect;
+  int i, k;
+
+  for (i = 0; i < W * H; i++)
+    src[i] = (byte)(i * 7);
+  for (i = 0; i < 256; i++) {
+    benchpal[i].r = (byte)i;
+    benchpal[i].g = (byte)(i * 3);
+    benchpal[i].b = (byte)(i * 5);
+  }
+  dest.fb = fb;
+  dest.fb_width = H;
+  dest.fb_height = W;
+  rect.src = src;
+  rect.src_pitch = W;
+  rect.width = W;
+  rect.height = H;
+  rect.x = rect.y = 0;
+
+  kernel[0] = I_BlitGetKernel(VID_MODE8, &dest);
+  kernel[1] = I_Blit8_Scalar;
+  kernel[2] = M_BenchBlitLoop;
+  result[0] = tiled;
+  result[1] = scalar;
+  result[2] = loop;
+  for (k = 0; k < 3; k++) {
+    int_64_t start = I_GetProfileTime();
+
+    for (i = 0; i < REPS; i++)
+      kernel[k](&rect, &dest);
+    *result[k] = (double)W * H * REPS * 1e3 / (I_GetProfileTime() - start);
+  }
+
+  blit_pixels = pixels;  // not part of the demo
+  free(src);
+  free(fb);
+}
+
+//
+// M_BenchReport
+// Write the totals for the demo that just finished, times in milliseconds
+//
+void M_BenchReport(unsigned int tics)
+{
+  double elapsed = (I_GetProfileTime() - benchepoch) / 1e9;
+  double total[NUMBENCH];
+  sightcachestats_t sight;
+  mobjpoolstats_t pool;
+  stereostats_t stereo;
+  texstorestats_t tex;
+  double tiled, scalar, loop;
+  FILE *f;
+  int i;
+
+  if (!benchmarking)
+    return;
+
+  for (i = 0; i < NUMBENCH; i++)
+    total[i] = benchtotal[i] / 1e6;
+  // segs are drawn from inside the BSP walk
+  total[bench_bsp] -= total[bench_segs];
+
+  if (!strcmp(benchreport, "-"))
+    f = stdout;
+  else if (!(f = fopen(benchreport, "w"))) {
+    lprintf(LO_WARN, "M_BenchReport: unable to write %s\n", benchreport);
+    return;
+  }
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"tics\": %u,\n", tics);
+  fprintf(f, "  \"frames\": %u,\n", benchframes);
+  fprintf(f, "  \"seconds\": %.3f,\n", elapsed);
+  fprintf(f, "  \"tics_per_sec\": %.1f,\n", elapsed > 0 ? tics / elapsed : 0);
+  fprintf(f, "  \"total_ms\": {");
+  for (i = 0; i < NUMBENCH; i++)
+    fprintf(f, "%s\"%s\": %.3f", i ? ", " : " ", benchnames[i], total[i]);
+  fprintf(f, " },\n");
+  fprintf(f, "  \"frame_ms\": {");
+  for (i = 0; i < NUMBENCH; i++)
+    fprintf(f, "%s\"%s\": %.4f", i ? ", " : " ", benchnames[i],
+            benchframes ? total[i] / benchframes : 0);
+  fprintf(f, " },\n");
+  fprintf(f, "  \"traces\": [");
+  for (i = 0; i < NUMTRACEBUCKETS; i++)
+    fprintf(f, "%s\n    { \"intercepts\": %u, \"count\": %u, \"us\": %.3f }",
+            i ? "," : "", i ? 1u << (i-1) : 0, tracecount[i],
+            tracecount[i] ? tracetime[i] / 1e3 / tracecount[i] : 0);
+  fprintf(f, "\n  ],\n");
+  P_GetSightCacheStats(&sight);
+  fprintf(f, "  \"sight\": { \"hits\": %u, \"misses\": %u, \"hit_rate\": %.3f, \"saved_ms\": %.3f },\n",
+          sight.hits, sight.misses,
+          sight.hits + sight.misses ? (double)sight.hits / (sight.hits + sight.misses) : 0,
+          sight.saved / 1e6);
+  // wall columns per second of seg time, and how many skipped rcolumn_t
+  {
+    int_64_t direct = wallcolumns[0] - wallbase[0];
+    int_64_t columns = direct + wallcolumns[1] - wallbase[1];
+
+    fprintf(f, "  \"walls\": { \"columns\": %.0f, \"direct\": %.0f, \"columns_per_sec\": %.0f },\n",
+            (double)columns, (double)direct,
+            benchtotal[bench_segs] ? columns * 1e9 / benchtotal[bench_segs] : 0);
+  }
+  // the demo's blits, and the kernels on their own
+  M_BenchBlitKernels(&tiled, &scalar, &loop);
+  fprintf(f, "  \"blit\": { \"mpixels\": %.3f, \"mpixels_per_sec\": %.1f, \"tiled_mpixels_per_sec\": %.1f, \"scalar_mpixels_per_sec\": %.1f, \"loop_mpixels_per_sec\": %.1f },\n",
+          (blit_pixels - blitbase) / 1e6,
+          benchtotal[bench_blit] ? (blit_pixels - blitbase) * 1e3 / benchtotal[bench_blit] : 0,
+          tiled, scalar, loop);
+  R_GetTextureStoreStats(&tex);
+  fprintf(f, "  \"textures\": { \"hits\": %u, \"misses\": %u, \"loaded\": %u, \"build_ms\": %.3f, \"store_kb\": %u },\n",
+          tex.hits, tex.misses, tex.loaded, tex.buildtime / 1e6,
+          (unsigned)(tex.bytes >> 10));
+  // time per stereo frame for each eye
+  R_GetStereoStats(&stereo);
+  if ((stereo.frames -= stereobase.frames))
+    fprintf(f, "  \"stereo\": { \"frames\": %u, \"left_ms\": %.4f, \"right_ms\": %.4f, \"left_bsp_ms\": %.4f, \"right_bsp_ms\": %.4f },\n",
+            stereo.frames,
+            (stereo.eye[0] - stereobase.eye[0]) / 1e6 / stereo.frames,
+            (stereo.eye[1] - stereobase.eye[1]) / 1e6 / stereo.frames,
+            (stereo.bsp[0] - stereobase.bsp[0]) / 1e6 / stereo.frames,
+            (stereo.bsp[1] - stereobase.bsp[1]) / 1e6 / stereo.frames);
+  P_GetMobjPoolStats(&pool);
+  fprintf(f, "  \"mobj_pool\": { \"live\": %u, \"peak\": %u, \"slabs\": %u }%s\n",
+          pool.live, pool.peak, pool.slabs, thinkerprofile ? "," : "");
+  if (thinkerprofile)
+    M_BenchThinkers(f);
+  fprintf(f, "}\n");
+
+  if (f != stdout)
+    fclose(f);
+}
@@ -0,0 +1,71 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Per-subsystem timing of demo playback (-benchmark).
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __M_BENCH__
+#define __M_BENCH__
+
+#include "doomtype.h"
+
+// Sections are timed separately. BSP time includes the segs it emits,
+// the report subtracts them again.
+typedef enum {
+  bench_playsim,  // P_Ticker
+  bench_bsp,      // R_RenderBSPNode
+  bench_segs,     // R_StoreWallRange
+  bench_planes,   // R_DrawPlanes and the slab flush
+  bench_masked,   // R_DrawMasked
+  bench_blit,     // I_FinishUpdate
+  NUMBENCH
+} benchsection_t;
+
+extern boolean benchmarking;
+
+void M_BenchInit(const char *reportname);
+void M_BenchReset(void);
+void M_BenchFrame(void);
+void M_BenchReport(unsigned int tics);
+
+void M_BenchBeginSection(benchsection_t section);
+void M_BenchEndSection(benchsection_t section);
+
+// Cost of ordering and visiting the intercepts of one trace, reported
+// by intercept count (see P_TraverseIntercepts)
+void M_BenchTrace(unsigned int intercepts, int_64_t start);
+
+// Keep the cost to a flag test when -benchmark isn't given
+#define M_BenchBegin(section) \
+  do { if (benchmarking) M_BenchBeginSection(section); } while (0)
+#define M_BenchEnd(section) \
+  do { if (benchmarking) M_BenchEndSection(section); } while (0)
+
+#endif
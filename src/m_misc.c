@@ -164,6 +164,11 @@ extern int realtic_clock_rate;         // killough 4/13/98: adjustable timer
 extern int tran_filter_pct;            // killough 2/21/98
 
 extern int screenblocks;
+extern int render_threads;
+extern int stereo_separation, stereo_convergence;
+extern int levelcache;
+extern int texture_store_kb, texture_cache;
+extern int thing_index;
 extern int showMessages;
 
 #ifndef DJGPP
@@ -199,6 +204,24 @@ default_t defaults[] =
    def_hex, ss_none}, // 0, +1 for colours, +2 for non-ascii chars, +4 for skip-last-line
   {"level_precache",{(int*)&precache},{0},0,1,
    def_bool,ss_none}, // precache level data?
+  {"level_cache",{&levelcache},{0},0,1,
+   def_bool,ss_none}, // keep post-processed map data on disk for faster loads
+  {"lump_cache_kb",{&lumpcache_budget},{0},0,UL,
+   def_int,ss_none}, // memory for cached wad lumps, 0 = as much as the zone allows
+  {"lump_cache_pin",{&lumpcache_pin},{1},0,1,
+   def_bool,ss_none}, // keep the flats and sky of the current level cached
+  {"wad_preload_kb",{&wad_preload_kb},{0},0,UL,
+   def_int,ss_none}, // read wads up to this size into memory at startup
+  {"texture_store_kb",{&texture_store_kb},{4096},0,UL,
+   def_int,ss_none}, // memory for composited wall textures kept across levels, 0 = purgeable
+  {"texture_cache",{&texture_cache},{0},0,1,
+   def_bool,ss_none}, // keep composited wall textures on disk for later runs
+  {"thing_index",{&thing_index},{0},0,2,
+   def_int,ss_none}, // link things into every block they overlap, 1 = not in demos, 2 = always
+  {"demo_snapshot_interval",{&demo_snapshot_interval},{10*TICRATE},0,UL,
+   def_int,ss_none}, // tics between demo playback snapshots for seeking, 0 = off
+  {"demo_snapshot_kb",{&demo_snapshot_kb},{4096},0,UL,
+   def_int,ss_none}, // memory for demo playback snapshots
   {"demo_smoothturns", {&demo_smoothturns},  {0},0,1,
    def_bool,ss_stat},
   {"demo_smoothturnsfactor", {&demo_smoothturnsfactor},  {6},1,SMOOTH_PLAYING_MAXFACTOR,
@@ -344,6 +367,12 @@ default_t defaults[] =
    RDRAW_MASKEDCOLUMNEDGE_SQUARE, RDRAW_MASKEDCOLUMNEDGE_SLOPED, def_int,ss_none},
   {"patch_edges",{(int*)&drawvars.patch_edges},{RDRAW_MASKEDCOLUMNEDGE_SQUARE},
    RDRAW_MASKEDCOLUMNEDGE_SQUARE, RDRAW_MASKEDCOLUMNEDGE_SLOPED, def_int,ss_none},
+  {"render_threads",{&render_threads},{1},1,MAX_RENDER_SLABS,
+   def_int,ss_none}, // threads drawing walls and flats, 1 = main thread only
+  {"stereo_separation",{&stereo_separation},{0},0,64,
+   def_int,ss_none}, // map units between the eyes, 0 = no stereo
+  {"stereo_convergence",{&stereo_convergence},{128},16,4096,
+   def_int,ss_none}, // map units ahead where the eyes meet
 
 #ifdef GL_DOOM
   {"OpenGL settings",{NULL},{0},UL,UL,def_none,ss_none},
@@ -456,6 +485,10 @@ default_t defaults[] =
    0,MAX_KEY,def_key,ss_keys}, // key to view from another coop player's view
   {"key_pause",       {&key_pause},          {0}     ,
    0,MAX_KEY,def_key,ss_keys}, // key to pause the game
+  {"key_demo_rewind", {&key_demo_rewind},    {0}     ,
+   0,MAX_KEY,def_key,ss_keys}, // key to skip back in demo playback
+  {"key_demo_forward",{&key_demo_forward},   {0}     ,
+   0,MAX_KEY,def_key,ss_keys}, // key to skip ahead in demo playback
   {"key_autorun",     {&key_autorun},        {0}  ,
    0,MAX_KEY,def_key,ss_keys}, // key to toggle always run mode
   {"key_chat",        {&key_chat},           {0}            ,
@@ -6,15 +6,74 @@
 #include "p_checksum.h"
 #include "md5.h"
 #include "doomstat.h" /* players{,ingame} */
+#include "p_tick.h"
+#include "p_setup.h"
+#include "r_state.h"
+#include "m_random.h"
 #include "lprintf.h"
 
+/*
+ * Each tic writes one hash per subsystem (players, mobjs, sectors, RNG),
+ * so two streams from the same demo show the first tic and the part of
+ * the game that went out of sync. -checksumdump <tic> also writes every
+ * object with its fields at that tic; -checksumcompare finds the first
+ * divergence between two streams and, given dumps of that tic, prints
+ * the objects that differ.
+ *
+ * Each mobj and sector hashes a cheap word-wise FNV-1a over the fields
+ * that matter for sync, seeded with its spawn order or sector number,
+ * and a subsystem's hash is the sum of its objects' hashes. The playsim
+ * reports the objects it changes through P_ChecksumMobj and
+ * P_ChecksumSector, so each tic only rehashes those and swaps them in
+ * the sums; mobjs that sit still and sectors nothing moves cost nothing.
+ * The few players and the RNG are simply hashed every tic.
+ *
+ * -checksumverify rehashes everything every tic as well and stops at
+ * the first object whose change went unreported.
+ */
+
+enum {
+    cs_players,
+    cs_mobjs,
+    cs_sectors,
+    cs_rng,
+    NUMCHECKSUMS
+};
+
+static const char *const checksumnames[NUMCHECKSUMS] = {
+    "players", "mobjs", "sectors", "rng"
+};
+
+#define HASHINIT  2166136261u
+#define HASHMUL   16777619u
+
+/* the fields of one object, hashed and, for dumps, printed */
+#define MAXFIELDS 48
+
+static struct {
+    const char *name;
+    int value;
+} fields[MAXFIELDS];
+static int numfields;
+
+#define FIELD(n, v) \
+    (fields[numfields].name = (n), fields[numfields++].value = (int)(v))
+
 /* forward decls */
 static void p_checksum_cleanup(void);
 void checksum_gamestate(int tic);
+static void checksum_mobj(mobj_t *mo);
+static void checksum_remove_mobj(mobj_t *mo);
+static void checksum_sector(sector_t *sec);
 
 /* vars */
 static void p_checksum_nop(int tic){} /* do nothing */
+static void p_checksum_nop_mobj(mobj_t *mo){}
+static void p_checksum_nop_sector(sector_t *sec){}
 void (*P_Checksum)(int) = p_checksum_nop;
+void (*P_ChecksumMobj)(mobj_t *) = p_checksum_nop_mobj;
+void (*P_ChecksumRemoveMobj)(mobj_t *) = p_checksum_nop_mobj;
+void (*P_ChecksumSector)(sector_t *) = p_checksum_nop_sector;
 
 /*
  * P_RecordChecksum
@@ -22,6 +81,8 @@ void (*P_Checksum)(int) = p_checksum_nop;
  */
 static FILE *outfile = NULL;
 static struct MD5Context md5global;
+static int dumptic = -1;
+static boolean verify;
 
 void P_RecordChecksum(const char *file) {
     size_t fnsize;
@@ -41,8 +102,23 @@ void P_RecordChecksum(const char *file) {
     }
 
     MD5Init(&md5global);
+    fprintf(outfile, "# tic, %s %s %s %s\n", checksumnames[cs_players],
+            checksumnames[cs_mobjs], checksumnames[cs_sectors],
+            checksumnames[cs_rng]);
 
     P_Checksum = checksum_gamestate;
+    P_ChecksumMobj = checksum_mobj;
+    P_ChecksumRemoveMobj = checksum_remove_mobj;
+    P_ChecksumSector = checksum_sector;
+    P_ChecksumReset();
+}
+
+void P_DumpChecksumTic(int tic) {
+    dumptic = tic;
+}
+
+void P_VerifyChecksums(void) {
+    verify = true;
 }
 
 void P_ChecksumFinal(void) {
@@ -65,36 +141,541 @@ static void p_checksum_cleanup(void) {
         fclose(outfile);
 }
 
+/*
+ * per-object fields
+ */
+static void player_fields(const player_t *p) {
+    int i, bits;
+
+    numfields = 0;
+    FIELD("state", p->playerstate);
+    FIELD("health", p->health);
+    FIELD("armor", p->armorpoints);
+    FIELD("armortype", p->armortype);
+    FIELD("viewz", p->viewz);
+    FIELD("viewheight", p->viewheight);
+    FIELD("deltaviewheight", p->deltaviewheight);
+    FIELD("bob", p->bob);
+    FIELD("ready", p->readyweapon);
+    FIELD("pending", p->pendingweapon);
+    for (i = bits = 0; i < NUMWEAPONS; i++)
+        bits |= (p->weaponowned[i] != 0) << i;
+    FIELD("weapons", bits);
+    for (i = bits = 0; i < NUMCARDS; i++)
+        bits |= (p->cards[i] != 0) << i;
+    FIELD("cards", bits);
+    FIELD("ammo0", p->ammo[0]);
+    FIELD("ammo1", p->ammo[1]);
+    FIELD("ammo2", p->ammo[2]);
+    FIELD("ammo3", p->ammo[3]);
+    for (i = 0; i < NUMPOWERS; i++)
+        FIELD("power", p->powers[i]);
+    FIELD("refire", p->refire);
+    FIELD("kills", p->killcount);
+    FIELD("items", p->itemcount);
+    FIELD("secrets", p->secretcount);
+    FIELD("psprite", p->psprites[ps_weapon].state ?
+          p->psprites[ps_weapon].state - states : -1);
+    FIELD("psptics", p->psprites[ps_weapon].tics);
+    FIELD("flash", p->psprites[ps_flash].state ?
+          p->psprites[ps_flash].state - states : -1);
+}
+
+static void mobj_fields(const mobj_t *mo) {
+    numfields = 0;
+    FIELD("type", mo->type);
+    FIELD("x", mo->x);
+    FIELD("y", mo->y);
+    FIELD("z", mo->z);
+    FIELD("momx", mo->momx);
+    FIELD("momy", mo->momy);
+    FIELD("momz", mo->momz);
+    FIELD("angle", mo->angle);
+    FIELD("floorz", mo->floorz);
+    FIELD("ceilingz", mo->ceilingz);
+    FIELD("health", mo->health);
+    FIELD("flags", mo->flags);
+    FIELD("state", mo->state - states);
+    FIELD("tics", mo->tics);
+    FIELD("movedir", mo->movedir);
+    FIELD("movecount", mo->movecount);
+    FIELD("reactiontime", mo->reactiontime);
+    FIELD("threshold", mo->threshold);
+    FIELD("target", mo->target ? mo->target->type : -1);
+    FIELD("tracer", mo->tracer ? mo->tracer->type : -1);
+}
+
+static void sector_fields(const sector_t *sec) {
+    numfields = 0;
+    FIELD("floor", sec->floorheight);
+    FIELD("ceiling", sec->ceilingheight);
+    FIELD("light", sec->lightlevel);
+    FIELD("special", sec->special);
+    FIELD("floorpic", sec->floorpic);
+    FIELD("ceilingpic", sec->ceilingpic);
+    FIELD("floorxoffs", sec->floor_xoffs);
+    FIELD("flooryoffs", sec->floor_yoffs);
+}
+
+/*
+ * The RNG indices that drive the game; pr_misc (M_Random) only feeds
+ * effects like the wipe and sound pitch. Vanilla demos don't store a
+ * seed, so the seeds only count when they're used.
+ */
+static void rng_fields(void) {
+    int i;
+
+    numfields = 0;
+    FIELD("rndindex", rng.rndindex);
+    if (!demo_compatibility)
+        for (i = 0; i < NUMPRCLASS; i++)
+            if (i != pr_misc)
+                FIELD("seed", rng.seed[i]);
+}
+
+static unsigned int hash_fields(unsigned int h) {
+    int i;
+
+    for (i = 0; i < numfields; i++)
+        h = (h ^ (unsigned int)fields[i].value) * HASHMUL;
+    return h;
+}
+
+static void dump_fields(int tic, int cs, int index) {
+    int i;
+
+    fprintf(outfile, "%6d %s %d %08x", tic, checksumnames[cs], index,
+            hash_fields(HASHINIT));
+    for (i = 0; i < numfields; i++)
+        fprintf(outfile, " %s=%d", fields[i].name, fields[i].value);
+    fprintf(outfile, "\n");
+}
+
+/* an object's hash starts from its spawn order or sector number */
+#define HASHSEED(n) ((HASHINIT ^ (unsigned int)(n)) * HASHMUL)
+
+/*
+ * What each mobj adds to the mobjs hash, found by the mobj's address:
+ * open addressing with linear probing, never more than half full.
+ */
+typedef struct {
+    const mobj_t *mo;       /* NULL if the slot is free */
+    unsigned int hash;
+    int id;                 /* spawn order */
+    boolean dirty;          /* on dirtymobjs, to be rehashed */
+} mobjsum_t;
+
+static mobjsum_t *mobjsums;
+static int mobjsumsize, nummobjsums, nextmobjid;
+
+static const mobj_t **dirtymobjs;
+static int numdirtymobjs, maxdirtymobjs;
+
+static unsigned int *sectorsums;
+static boolean *sectordirty;
+static int *dirtysectors, numdirtysectors;
+static int numsumsectors;   /* 0 until the sectors are first hashed */
+
+static unsigned int mobjsum, sectorsum;
+static boolean rehashall = true;
+
+static int mobjsum_home(const mobj_t *mo) {
+    return ((unsigned int)((size_t)mo / sizeof(*mo)) * 2654435761u) &
+        (mobjsumsize - 1);
+}
+
+static mobjsum_t *find_mobjsum(const mobj_t *mo) {
+    int i = mobjsum_home(mo);
+
+    while (mobjsums[i].mo && mobjsums[i].mo != mo)
+        i = (i + 1) & (mobjsumsize - 1);
+    return &mobjsums[i];
+}
+
+static mobjsum_t *add_mobjsum(const mobj_t *mo) {
+    mobjsum_t *ms;
+
+    if (2 * (nummobjsums + 1) > mobjsumsize) {
+        mobjsum_t *old = mobjsums;
+        int i, oldsize = mobjsumsize;
+
+        mobjsums = calloc(mobjsumsize *= 2, sizeof(*mobjsums));
+        for (i = 0; i < oldsize; i++)
+            if (old[i].mo)
+                *find_mobjsum(old[i].mo) = old[i];
+        free(old);
+    }
+    ms = find_mobjsum(mo);
+    ms->mo = mo;
+    ms->hash = 0;
+    ms->id = nextmobjid++;
+    ms->dirty = false;
+    nummobjsums++;
+    return ms;
+}
+
+/* close the gap so later probes still find what follows */
+static void remove_mobjsum(mobjsum_t *ms) {
+    int i = ms - mobjsums, j = i;
+
+    for (;;) {
+        int home;
+
+        j = (j + 1) & (mobjsumsize - 1);
+        if (!mobjsums[j].mo)
+            break;
+        home = mobjsum_home(mobjsums[j].mo);
+        if (j > i ? home <= i || home > j : home <= i && home > j) {
+            mobjsums[i] = mobjsums[j];
+            i = j;
+        }
+    }
+    mobjsums[i].mo = NULL;
+    nummobjsums--;
+}
+
+/*
+ * P_ChecksumMobj, P_ChecksumRemoveMobj and P_ChecksumSector when
+ * recording: note what changed, the hashing waits for the end of the tic
+ */
+static void checksum_mobj(mobj_t *mo) {
+    mobjsum_t *ms;
+
+    if (mo->thinker.function != P_MobjThinker)
+        return;             /* still being spawned, or removed */
+    ms = find_mobjsum(mo);
+    if (!ms->mo)
+        ms = add_mobjsum(mo);
+    if (!ms->dirty) {
+        ms->dirty = true;
+        if (numdirtymobjs >= maxdirtymobjs)
+            dirtymobjs = realloc(dirtymobjs, sizeof(*dirtymobjs) *
+                (maxdirtymobjs = maxdirtymobjs ? maxdirtymobjs*2 : 256));
+        dirtymobjs[numdirtymobjs++] = mo;
+    }
+}
+
+static void checksum_remove_mobj(mobj_t *mo) {
+    mobjsum_t *ms = find_mobjsum(mo);
+
+    if (ms->mo) {
+        mobjsum -= ms->hash;
+        remove_mobjsum(ms);
+    }
+}
+
+static void checksum_sector(sector_t *sec) {
+    int i = sec - sectors;
+
+    if (i < numsumsectors && !sectordirty[i]) {
+        sectordirty[i] = true;
+        dirtysectors[numdirtysectors++] = i;
+    }
+}
+
+/*
+ * P_ChecksumReset
+ * P_InitThinkers calls this for each level and savegame. Everything is
+ * hashed afresh at the end of the tic, and mobjs that weren't spawned
+ * (loaded ones) are numbered then, in thinker order.
+ */
+void P_ChecksumReset(void) {
+    if (!outfile)
+        return;
+
+    if (!mobjsums)
+        mobjsums = calloc(mobjsumsize = 1024, sizeof(*mobjsums));
+    else
+        memset(mobjsums, 0, mobjsumsize * sizeof(*mobjsums));
+    nummobjsums = nextmobjid = 0;
+    numdirtymobjs = 0;
+    numsumsectors = numdirtysectors = 0;
+    rehashall = true;
+}
+
+static unsigned int hash_mobj(const mobj_t *mo, int id) {
+    mobj_fields(mo);
+    return hash_fields(HASHSEED(id));
+}
+
+static unsigned int hash_sector(int i) {
+    sector_fields(&sectors[i]);
+    return hash_fields(HASHSEED(i));
+}
+
+static void rehash_all(void) {
+    thinker_t *th;
+    int i;
+
+    mobjsum = 0;
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        if (th->function == P_MobjThinker) {
+            mobjsum_t *ms = find_mobjsum((mobj_t *) th);
+
+            if (!ms->mo)
+                ms = add_mobjsum((mobj_t *) th);
+            ms->hash = hash_mobj(ms->mo, ms->id);
+            ms->dirty = false;
+            mobjsum += ms->hash;
+        }
+    numdirtymobjs = 0;
+
+    sectorsums = realloc(sectorsums, numsectors * sizeof(*sectorsums));
+    sectordirty = realloc(sectordirty, numsectors * sizeof(*sectordirty));
+    dirtysectors = realloc(dirtysectors, numsectors * sizeof(*dirtysectors));
+    sectorsum = 0;
+    for (i = 0; i < numsectors; i++) {
+        sectorsum += sectorsums[i] = hash_sector(i);
+        sectordirty[i] = false;
+    }
+    numsumsectors = numsectors;
+    numdirtysectors = 0;
+    rehashall = false;
+}
+
+static void rehash_dirty(void) {
+    while (numdirtymobjs) {
+        mobjsum_t *ms = find_mobjsum(dirtymobjs[--numdirtymobjs]);
+
+        if (ms->mo && ms->dirty) { /* else removed since */
+            mobjsum -= ms->hash;
+            mobjsum += ms->hash = hash_mobj(ms->mo, ms->id);
+            ms->dirty = false;
+        }
+    }
+
+    while (numdirtysectors) {
+        int i = dirtysectors[--numdirtysectors];
+
+        sectorsum -= sectorsums[i];
+        sectorsum += sectorsums[i] = hash_sector(i);
+        sectordirty[i] = false;
+    }
+}
+
+/* -checksumverify: catch a change the playsim didn't report */
+static void verify_sums(int tic) {
+    thinker_t *th;
+    int i;
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        if (th->function == P_MobjThinker) {
+            const mobjsum_t *ms = find_mobjsum((mobj_t *) th);
+
+            if (!ms->mo)
+                I_Error("checksum_gamestate: tic %d: mobj of type %d "
+                        "was never reported", tic, ((mobj_t *) th)->type);
+            if (hash_mobj(ms->mo, ms->id) != ms->hash)
+                I_Error("checksum_gamestate: tic %d: mobj %d of type %d "
+                        "changed unreported", tic, ms->id, ms->mo->type);
+        }
+
+    for (i = 0; i < numsectors; i++)
+        if (hash_sector(i) != sectorsums[i])
+            I_Error("checksum_gamestate: tic %d: sector %d changed "
+                    "unreported", tic, i);
+}
+
 /*
  * runs on each tic when recording checksums
  */
 void checksum_gamestate(int tic) {
+    unsigned int hash[NUMCHECKSUMS];
+    boolean dump = tic == dumptic;
+    thinker_t *th;
     int i;
-    struct MD5Context md5ctx;
-    unsigned char digest[16];
-    char buffer[2048];
-
-    fprintf(outfile,"%6d, ", tic);
 
-    /* based on "ArchivePlayers" */
-    MD5Init(&md5ctx);
+    hash[cs_players] = HASHINIT;
     for (i=0 ; i<MAXPLAYERS ; i++) {
         if (!playeringame[i]) continue;
+        player_fields(&players[i]);
+        hash[cs_players] = hash_fields(hash[cs_players]);
+        if (dump)
+            dump_fields(tic, cs_players, i);
+    }
 
-#ifdef HAVE_SNPRINTF
-        snprintf (buffer, sizeof(buffer), "%d", players[i].health);
-#else
-        sprintf (buffer, "%d", players[i].health);
-#endif
-        buffer[sizeof(buffer)-1] = 0;
+    if (rehashall)
+        rehash_all();
+    else
+        rehash_dirty();
+    if (verify)
+        verify_sums(tic);
+    hash[cs_mobjs] = mobjsum;
+    hash[cs_sectors] = sectorsum;
 
-        MD5Update(&md5ctx, (md5byte const *)&buffer, strlen(buffer));
+    if (dump) {
+        for (th = thinkercap.next; th != &thinkercap; th = th->next)
+            if (th->function == P_MobjThinker) {
+                mobj_fields((mobj_t *) th);
+                dump_fields(tic, cs_mobjs, find_mobjsum((mobj_t *) th)->id);
+            }
+        for (i = 0; i < numsectors; i++) {
+            sector_fields(&sectors[i]);
+            dump_fields(tic, cs_sectors, i);
+        }
     }
-    MD5Final(digest, &md5ctx);
-    for (i=0; i<16; i++) {
-        MD5Update(&md5global, (md5byte const *)&digest[i], sizeof(digest[i]));
-        fprintf(outfile,"%x", digest[i]);
+
+    rng_fields();
+    hash[cs_rng] = hash_fields(HASHINIT);
+    if (dump)
+        dump_fields(tic, cs_rng, 0);
+
+    fprintf(outfile, "%6d, %08x %08x %08x %08x\n", tic,
+            hash[cs_players], hash[cs_mobjs], hash[cs_sectors], hash[cs_rng]);
+    MD5Update(&md5global, (md5byte const *)hash, sizeof(hash));
+}
+
+/*
+ * P_CompareChecksums
+ * -checksumcompare: reports the first tic and subsystems where two
+ * streams differ, and the objects that differ if both streams have a
+ * dump of that tic. Returns 0 if the streams agree.
+ */
+typedef struct {
+    int tic;
+    unsigned int hash[NUMCHECKSUMS];
+} checksumtic_t;
+
+typedef struct {
+    int cs, index;      /* the object on the line */
+    char *line;
+} checksumdump_t;
+
+typedef struct {
+    checksumtic_t *tics;
+    int numtics, maxtics;
+    checksumdump_t *dump;   /* dump lines of the tic being compared */
+    int numdump, maxdump;
+} checksumfile_t;
+
+static void read_checksums(const char *name, checksumfile_t *cf, int dumpat) {
+    FILE *f = fopen(name, "r");
+    char line[1024];
+
+    if (!f)
+        I_Error("P_CompareChecksums: cannot open %s:\n%s\n",
+                name, strerror(errno));
+    while (fgets(line, sizeof line, f)) {
+        checksumtic_t ct;
+        int tic, index;
+        char sep, name[32];
+
+        if (sscanf(line, "%d%c %x %x %x %x", &ct.tic, &sep,
+                   &ct.hash[0], &ct.hash[1], &ct.hash[2], &ct.hash[3]) == 6
+            && sep == ',') {
+            if (cf->numtics >= cf->maxtics)
+                cf->tics = realloc(cf->tics, sizeof(*cf->tics) *
+                    (cf->maxtics = cf->maxtics ? cf->maxtics*2 : 1024));
+            cf->tics[cf->numtics++] = ct;
+        }
+        else if (dumpat >= 0 && sscanf(line, "%d %31s %d", &tic, name,
+                                       &index) == 3 && tic == dumpat) {
+            checksumdump_t *cd;
+
+            if (cf->numdump >= cf->maxdump)
+                cf->dump = realloc(cf->dump, sizeof(*cf->dump) *
+                    (cf->maxdump = cf->maxdump ? cf->maxdump*2 : 256));
+            cd = &cf->dump[cf->numdump++];
+            for (cd->cs = 0; cd->cs < NUMCHECKSUMS; cd->cs++)
+                if (!strcmp(name, checksumnames[cd->cs]))
+                    break;
+            cd->index = index;
+            line[strcspn(line, "\r\n")] = 0;
+            cd->line = strdup(line);
+        }
+    }
+    fclose(f);
+}
+
+static void free_checksums(checksumfile_t *cf) {
+    while (cf->numdump)
+        free(cf->dump[--cf->numdump].line);
+    free(cf->dump);
+    free(cf->tics);
+    memset(cf, 0, sizeof(*cf));
+}
+
+/* the dump line of an object, or NULL */
+static const char *find_dump(const checksumfile_t *cf, int cs, int index) {
+    int i;
+
+    for (i = 0; i < cf->numdump; i++)
+        if (cf->dump[i].cs == cs && cf->dump[i].index == index)
+            return cf->dump[i].line;
+    return NULL;
+}
+
+/* the objects of a subsystem that differ, or are only in one dump */
+static void compare_dumps(const checksumfile_t *cf, int cs) {
+    int i;
+
+    for (i = 0; i < cf[0].numdump; i++)
+        if (cf[0].dump[i].cs == cs) {
+            const char *a = cf[0].dump[i].line;
+            const char *b = find_dump(&cf[1], cs, cf[0].dump[i].index);
+
+            if (!b || strcmp(a, b))
+                lprintf(LO_INFO, "< %s\n> %s\n", a, b ? b : "(none)");
+        }
+    for (i = 0; i < cf[1].numdump; i++)
+        if (cf[1].dump[i].cs == cs &&
+            !find_dump(&cf[0], cs, cf[1].dump[i].index))
+            lprintf(LO_INFO, "< (none)\n> %s\n", cf[1].dump[i].line);
+}
+
+int P_CompareChecksums(const char *name1, const char *name2) {
+    checksumfile_t cf[2];
+    int i, cs, tic = -1, diff = 0, result;
+
+    memset(cf, 0, sizeof(cf));
+    read_checksums(name1, &cf[0], -1);
+    read_checksums(name2, &cf[1], -1);
+
+    for (i = 0; i < cf[0].numtics && i < cf[1].numtics; i++) {
+        const checksumtic_t *a = &cf[0].tics[i], *b = &cf[1].tics[i];
+
+        for (cs = 0; cs < NUMCHECKSUMS; cs++)
+            if (a->hash[cs] != b->hash[cs])
+                diff |= 1 << cs;
+        if (diff || a->tic != b->tic) {
+            tic = a->tic;
+            break;
+        }
+    }
+
+    if (tic < 0) {
+        if (cf[0].numtics != cf[1].numtics)
+            lprintf(LO_INFO, "%s: %d tics, %s: %d tics, the same up to there\n",
+                    name1, cf[0].numtics, name2, cf[1].numtics);
+        else
+            lprintf(LO_INFO, "%d tics, no differences\n", cf[0].numtics);
+        result = cf[0].numtics != cf[1].numtics;
+        free_checksums(&cf[0]);
+        free_checksums(&cf[1]);
+        return result;
+    }
+
+    lprintf(LO_INFO, "first difference at tic %d:", tic);
+    for (cs = 0; cs < NUMCHECKSUMS; cs++)
+        if (diff & (1 << cs))
+            lprintf(LO_INFO, " %s", checksumnames[cs]);
+    lprintf(LO_INFO, "\n");
+
+    free_checksums(&cf[0]);
+    free_checksums(&cf[1]);
+    read_checksums(name1, &cf[0], tic);
+    read_checksums(name2, &cf[1], tic);
+
+    if (!cf[0].numdump || !cf[1].numdump) {
+        lprintf(LO_INFO, "record both again with -checksumdump %d to see "
+                "the objects that differ\n", tic);
     }
+    else
+        for (cs = 0; cs < NUMCHECKSUMS; cs++)
+            if (diff & (1 << cs))
+                compare_dumps(cf, cs);
 
-    fprintf(outfile,"\n");
+    free_checksums(&cf[0]);
+    free_checksums(&cf[1]);
+    return 1;
 }
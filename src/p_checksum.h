@@ -1,4 +1,16 @@
+#include "r_defs.h"
+
 extern void (*P_Checksum)(int);
 extern void P_ChecksumFinal(void);
 void P_RecordChecksum(const char *file);
 //void P_VerifyChecksum(const char *file);
+void P_DumpChecksumTic(int tic);
+void P_VerifyChecksums(void);
+int P_CompareChecksums(const char *file1, const char *file2);
+
+// the playsim calls these where it changes a mobj or sector, so the
+// hashes only need redoing for what changed; no-ops unless recording
+extern void (*P_ChecksumMobj)(mobj_t *mo);
+extern void (*P_ChecksumRemoveMobj)(mobj_t *mo);
+extern void (*P_ChecksumSector)(sector_t *sec);
+void P_ChecksumReset(void);
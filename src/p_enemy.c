@@ -76,46 +76,156 @@ void P_ZBumpCheck(mobj_t *);                                        // phares
 //
 
 //
-// Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
-// sound blocking lines cut off traversal.
+// Sound propagation
+//
+// Each sector's two-sided lines are collected once per level into one
+// flat array, with the sector on the far side resolved ahead of time.
+// Door openings still have to be checked at alert time.
 //
-// killough 5/5/98: reformatted, cleaned up
 
-static void P_RecursiveSound(sector_t *sec, int soundblocks,
-           mobj_t *soundtarget)
+typedef struct {
+  const line_t *line;
+  sector_t *other;      // sector the sound reaches through this line
+  boolean soundblock;
+} soundline_t;
+
+// The flood is a depth-first walk over an explicit stack, visiting
+// sectors and lines in the same order the recursive version did.
+typedef struct {
+  sector_t *sec;
+  int soundblocks;
+  int next;             // next entry of this sector's sound lines
+} soundframe_t;
+
+static soundline_t *soundlines;
+static int *soundlinestart;     // numsectors+1 offsets into soundlines
+static soundframe_t *soundstack;
+
+//
+// P_InitSoundLines
+// Called by P_SetupLevel once the sectors' line lists are built
+//
+void P_InitSoundLines(void)
 {
-  int i;
+  int i, j, count = 0;
+
+  for (i = 0; i < numsectors; i++)
+    for (j = 0; j < sectors[i].linecount; j++)
+      if (sectors[i].lines[j]->flags & ML_TWOSIDED)
+        count++;
+
+  soundlines = Z_Malloc((count ? count : 1) * sizeof(*soundlines), PU_LEVEL, 0);
+  soundlinestart = Z_Malloc((numsectors+1) * sizeof(*soundlinestart), PU_LEVEL, 0);
+  // a sector is only pushed when its state improves, which can happen
+  // at most twice per alert (untraversed -> blocked -> clear)
+  soundstack = Z_Malloc((2*numsectors+1) * sizeof(*soundstack), PU_LEVEL, 0);
+
+  for (count = i = 0; i < numsectors; i++)
+    {
+      sector_t *sec = &sectors[i];
+
+      soundlinestart[i] = count;
+      for (j = 0; j < sec->linecount; j++)
+        {
+          const line_t *check = sec->lines[j];
+          soundline_t *sl;
+
+          if (!(check->flags & ML_TWOSIDED))
+            continue;
+
+          sl = &soundlines[count++];
+          sl->line = check;
+          sl->soundblock = (check->flags & ML_SOUNDBLOCK) != 0;
+          // a two-sided flag without a back side never opens
+          sl->other = check->sidenum[1] == NO_INDEX ? NULL :
+            sides[check->sidenum[sides[check->sidenum[0]].sector==sec]].sector;
+        }
+    }
+  soundlinestart[numsectors] = count;
+}
 
+// Mark one sector as reached, false if it already was at this level
+static boolean P_FloodSector(sector_t *sec, int soundblocks,
+           mobj_t *soundtarget)
+{
   // wake up all monsters in this sector
   if (sec->validcount == validcount && sec->soundtraversed <= soundblocks+1)
-    return;             // already flooded
+    return false;       // already flooded
 
   sec->validcount = validcount;
   sec->soundtraversed = soundblocks+1;
   P_SetTarget(&sec->soundtarget, soundtarget);
+  return true;
+}
+
+//
+// Called by P_NoiseAlert.
+// Traverse adjacent sectors,
+// sound blocking lines cut off traversal.
+//
+// killough 5/5/98: reformatted, cleaned up
+//
+
+static void P_PropagateSound(sector_t *sec, int soundblocks,
+           mobj_t *soundtarget)
+{
+  soundframe_t *sp = soundstack;
+  const line_t *last = NULL;
+
+  if (!P_FloodSector(sec, soundblocks, soundtarget))
+    return;
+
+  sp->sec = sec;
+  sp->soundblocks = soundblocks;
+  sp->next = soundlinestart[sec - sectors];
 
-  for (i=0; i<sec->linecount; i++)
+  while (sp >= soundstack)
     {
+      const soundline_t *sl;
       sector_t *other;
-      line_t *check = sec->lines[i];
+      fixed_t top, bottom;
 
-      if (!(check->flags & ML_TWOSIDED))
-        continue;
+      if (sp->next == soundlinestart[sp->sec - sectors + 1])
+        {
+          sp--;
+          continue;
+        }
 
-      P_LineOpening(check);
+      sl = &soundlines[sp->next++];
+      last = sl->line;
 
-      if (openrange <= 0)
-        continue;       // closed door
+      if (!(other = sl->other))
+        continue;       // never open
 
-      other=sides[check->sidenum[sides[check->sidenum[0]].sector==sec]].sector;
+      // same as P_LineOpening, the sectors are the line's two sides
+      top = sp->sec->ceilingheight < other->ceilingheight ?
+        sp->sec->ceilingheight : other->ceilingheight;
+      bottom = sp->sec->floorheight > other->floorheight ?
+        sp->sec->floorheight : other->floorheight;
+
+      if (top - bottom <= 0)
+        continue;       // closed door
 
-      if (!(check->flags & ML_SOUNDBLOCK))
-        P_RecursiveSound(other, soundblocks, soundtarget);
+      if (!sl->soundblock)
+        soundblocks = sp->soundblocks;
       else
-        if (!soundblocks)
-          P_RecursiveSound(other, 1, soundtarget);
+        if (!sp->soundblocks)
+          soundblocks = 1;
+        else
+          continue;
+
+      if (P_FloodSector(other, soundblocks, soundtarget))
+        {
+          sp++;
+          sp->sec = other;
+          sp->soundblocks = soundblocks;
+          sp->next = soundlinestart[other - sectors];
+        }
     }
+
+  // leave the opening globals as the recursive version did
+  if (last)
+    P_LineOpening(last);
 }
 
 //
@@ -126,7 +236,7 @@ static void P_RecursiveSound(sector_t *sec, int soundblocks,
 void P_NoiseAlert(mobj_t *target, mobj_t *emitter)
 {
   validcount++;
-  P_RecursiveSound(emitter->subsector->sector, 0, target);
+  P_PropagateSound(emitter->subsector->sector, 0, target);
 }
 
 //
@@ -623,7 +733,7 @@ static fixed_t P_AvoidDropoff(mobj_t *actor)
   validcount++;
   for (bx=xl ; bx<=xh ; bx++)
     for (by=yl ; by<=yh ; by++)
-      P_BlockLinesIterator(bx, by, PIT_AvoidDropoff);  // all contacted lines
+      P_BlockLinesIteratorBox(bx, by, tmbbox, PIT_AvoidDropoff);  // all contacted lines
 
   return dropoff_deltax | dropoff_deltay;   // Non-zero if movement prescribed
 }
@@ -1632,12 +1742,49 @@ static boolean PIT_VileCheck(mobj_t *thing)
 // Check for ressurecting a body
 //
 
-void A_VileChase(mobj_t* actor)
+//
+// P_FindVileCorpse
+// Look for a corpse to raise around viletryx, viletryy; PIT_VileCheck
+// leaves it in corpsehit
+//
+
+static boolean P_FindVileCorpse(void)
 {
   int xl, xh;
   int yl, yh;
   int bx, by;
 
+  if (thingindex)
+    {
+      // things are in every block they overlap, so only the vile's own
+      // reach needs adding, not another MAXRADIUS
+      fixed_t dist = MAXRADIUS + mobjinfo[MT_VILE].radius;
+      fixed_t box[4];
+
+      box[BOXTOP] = viletryy + dist;
+      box[BOXBOTTOM] = viletryy - dist;
+      box[BOXRIGHT] = viletryx + dist;
+      box[BOXLEFT] = viletryx - dist;
+      return !P_BoxThingsIterator(box, PIT_VileCheck);
+    }
+
+  xl = (viletryx - bmaporgx - MAXRADIUS*2)>>MAPBLOCKSHIFT;
+  xh = (viletryx - bmaporgx + MAXRADIUS*2)>>MAPBLOCKSHIFT;
+  yl = (viletryy - bmaporgy - MAXRADIUS*2)>>MAPBLOCKSHIFT;
+  yh = (viletryy - bmaporgy + MAXRADIUS*2)>>MAPBLOCKSHIFT;
+
+  for (bx=xl ; bx<=xh ; bx++)
+    for (by=yl ; by<=yh ; by++)
+      // Call PIT_VileCheck to check
+      // whether object is a corpse
+      // that canbe raised.
+      if (!P_BlockThingsIterator(bx,by,PIT_VileCheck))
+        return true;
+  return false;
+}
+
+void A_VileChase(mobj_t* actor)
+{
   if (actor->movedir != DI_NODIR)
     {
       // check for corpses to raise
@@ -1646,67 +1793,53 @@ void A_VileChase(mobj_t* actor)
       viletryy =
         actor->y + actor->info->speed*yspeed[actor->movedir];
 
-      xl = (viletryx - bmaporgx - MAXRADIUS*2)>>MAPBLOCKSHIFT;
-      xh = (viletryx - bmaporgx + MAXRADIUS*2)>>MAPBLOCKSHIFT;
-      yl = (viletryy - bmaporgy - MAXRADIUS*2)>>MAPBLOCKSHIFT;
-      yh = (viletryy - bmaporgy + MAXRADIUS*2)>>MAPBLOCKSHIFT;
-
       vileobj = actor;
-      for (bx=xl ; bx<=xh ; bx++)
+      if (P_FindVileCorpse())
         {
-          for (by=yl ; by<=yh ; by++)
-            {
-              // Call PIT_VileCheck to check
-              // whether object is a corpse
-              // that canbe raised.
-              if (!P_BlockThingsIterator(bx,by,PIT_VileCheck))
-                {
-      mobjinfo_t *info;
-
-                  // got one!
-                  mobj_t* temp = actor->target;
-                  actor->target = corpsehit;
-                  A_FaceTarget(actor);
-                  actor->target = temp;
-
-                  P_SetMobjState(actor, S_VILE_HEAL1);
-                  S_StartSound(corpsehit, sfx_slop);
-                  info = corpsehit->info;
-
-                  P_SetMobjState(corpsehit,info->raisestate);
-
-                  if (comp[comp_vile])                              // phares
-                    corpsehit->height <<= 2;                        //   |
-                  else                                              //   V
-                    {
-                      corpsehit->height = info->height; // fix Ghost bug
-                      corpsehit->radius = info->radius; // fix Ghost bug
-                    }                                               // phares
-
-      /* killough 7/18/98:
-       * friendliness is transferred from AV to raised corpse
-       */
-      corpsehit->flags =
-        (info->flags & ~MF_FRIEND) | (actor->flags & MF_FRIEND);
-
-		  if (!((corpsehit->flags ^ MF_COUNTKILL) & (MF_FRIEND | MF_COUNTKILL)))
-		    totallive++;
-		  
-                  corpsehit->health = info->spawnhealth;
-      P_SetTarget(&corpsehit->target, NULL);  // killough 11/98
-
-      if (mbf_features)
-        {         /* kilough 9/9/98 */
-          P_SetTarget(&corpsehit->lastenemy, NULL);
-          corpsehit->flags &= ~MF_JUSTHIT;
-        }
+          mobjinfo_t *info;
+
+          // got one!
+          mobj_t* temp = actor->target;
+          actor->target = corpsehit;
+          A_FaceTarget(actor);
+          actor->target = temp;
+
+          P_SetMobjState(actor, S_VILE_HEAL1);
+          S_StartSound(corpsehit, sfx_slop);
+          info = corpsehit->info;
 
-      /* killough 8/29/98: add to appropriate thread */
-      P_UpdateThinker(&corpsehit->thinker);
+          P_SetMobjState(corpsehit,info->raisestate);
 
-                  return;
-                }
+          if (comp[comp_vile])                              // phares
+            corpsehit->height <<= 2;                        //   |
+          else                                              //   V
+            {
+              corpsehit->height = info->height; // fix Ghost bug
+              corpsehit->radius = info->radius; // fix Ghost bug
+            }                                               // phares
+
+          /* killough 7/18/98:
+           * friendliness is transferred from AV to raised corpse
+           */
+          corpsehit->flags =
+            (info->flags & ~MF_FRIEND) | (actor->flags & MF_FRIEND);
+
+          if (!((corpsehit->flags ^ MF_COUNTKILL) & (MF_FRIEND | MF_COUNTKILL)))
+            totallive++;
+
+          corpsehit->health = info->spawnhealth;
+          P_SetTarget(&corpsehit->target, NULL);  // killough 11/98
+
+          if (mbf_features)
+            {         /* kilough 9/9/98 */
+              P_SetTarget(&corpsehit->lastenemy, NULL);
+              corpsehit->flags &= ~MF_JUSTHIT;
             }
+
+          /* killough 8/29/98: add to appropriate thread */
+          P_UpdateThinker(&corpsehit->thinker);
+
+          return;
         }
     }
   A_Chase(actor);  // Return to normal attack.
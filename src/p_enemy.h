@@ -39,6 +39,7 @@
 #include "p_mobj.h"
 
 void P_NoiseAlert (mobj_t *target, mobj_t *emmiter);
+void P_InitSoundLines(void);
 void P_SpawnBrainTargets(void); /* killough 3/26/98: spawn icon landings */
 
 extern struct brain_s {         /* killough 3/26/98: global state of boss brain */
@@ -39,6 +39,7 @@
 #include "p_tick.h"
 #include "s_sound.h"
 #include "sounds.h"
+#include "p_checksum.h"
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -75,6 +76,9 @@ result_e T_MovePlane
   fixed_t       destheight; //jff 02/04/98 used to keep floors/ceilings
                             // from moving thru each other
 
+  P_InvalidateSightCache();   // sight lines depend on sector heights
+  P_ChecksumSector(sector);
+
   switch(floorOrCeiling)
   {
     case 0:
@@ -560,6 +564,7 @@ int EV_DoFloor
         sec->special = line->frontsector->special;
         //jff 3/14/98 transfer both old and new special
         sec->oldspecial = line->frontsector->oldspecial;
+        P_ChecksumSector(sec);
         break;
 
       case raiseToTexture:
@@ -670,6 +675,7 @@ int EV_DoChange
         sec->floorpic = line->frontsector->floorpic;
         sec->special = line->frontsector->special;
         sec->oldspecial = line->frontsector->oldspecial;
+        P_ChecksumSector(sec);
         break;
       case numChangeOnly:
         secm = P_FindModelFloorSector(sec->floorheight,secnum);
@@ -678,6 +684,7 @@ int EV_DoChange
           sec->floorpic = secm->floorpic;
           sec->special = secm->special;
           sec->oldspecial = secm->oldspecial;
+          P_ChecksumSector(sec);
         }
         break;
       default:
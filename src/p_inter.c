@@ -41,6 +41,7 @@
 #include "d_deh.h"  // Ty 03/22/98 - externalized strings
 #include "p_tick.h"
 #include "lprintf.h"
+#include "p_checksum.h"
 
 #include "p_inter.h"
 #include "p_enemy.h"
@@ -623,6 +624,7 @@ static void P_KillMobj(mobj_t *source, mobj_t *target)
   mobjtype_t item;
   mobj_t     *mo;
 
+  P_ChecksumMobj(target);
   target->flags &= ~(MF_SHOOTABLE|MF_FLOAT|MF_SKULLFLY);
 
   if (target->type != MT_SKULL)
@@ -754,6 +756,8 @@ void P_DamageMobj(mobj_t *target,mobj_t *inflictor, mobj_t *source, int damage)
   if (target->health <= 0)
     return;
 
+  P_ChecksumMobj(target);
+
   if (target->flags & MF_SKULLFLY)
     target->momx = target->momy = target->momz = 0;
 
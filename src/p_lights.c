@@ -39,6 +39,7 @@
 #include "r_main.h"
 #include "p_spec.h"
 #include "p_tick.h"
+#include "p_checksum.h"
 
 //////////////////////////////////////////////////////////
 //
@@ -67,6 +68,7 @@ void T_FireFlicker (fireflicker_t* flick)
     flick->sector->lightlevel = flick->minlight;
   else
     flick->sector->lightlevel = flick->maxlight - amount;
+  P_ChecksumSector(flick->sector);
 
   flick->count = 4;
 }
@@ -94,6 +96,7 @@ void T_LightFlash (lightflash_t* flash)
     flash-> sector->lightlevel = flash->maxlight;
     flash->count = (P_Random(pr_lights)&flash->maxtime)+1;
   }
+  P_ChecksumSector(flash->sector);
 
 }
 
@@ -120,6 +123,7 @@ void T_StrobeFlash (strobe_t*   flash)
     flash-> sector->lightlevel = flash->minlight;
     flash->count =flash->darktime;
   }
+  P_ChecksumSector(flash->sector);
 }
 
 //
@@ -155,6 +159,7 @@ void T_Glow(glow_t* g)
       }
       break;
   }
+  P_ChecksumSector(g->sector);
 }
 
 //////////////////////////////////////////////////////////
@@ -181,6 +186,7 @@ void P_SpawnFireFlicker (sector_t*  sector)
   // Note that we are resetting sector attributes.
   // Nothing special about it during gameplay.
   sector->special &= ~31; //jff 3/14/98 clear non-generalized sector type
+  P_ChecksumSector(sector);
 
   flick = Z_Malloc ( sizeof(*flick), PU_LEVSPEC, 0);
 
@@ -208,6 +214,7 @@ void P_SpawnLightFlash (sector_t* sector)
 
   // nothing special about it during gameplay
   sector->special &= ~31; //jff 3/14/98 clear non-generalized sector type
+  P_ChecksumSector(sector);
 
   flash = Z_Malloc ( sizeof(*flash), PU_LEVSPEC, 0);
 
@@ -258,6 +265,7 @@ void P_SpawnStrobeFlash
 
   // nothing special about it during gameplay
   sector->special &= ~31; //jff 3/14/98 clear non-generalized sector type
+  P_ChecksumSector(sector);
 
   if (!inSync)
     flash->count = (P_Random(pr_lights)&7)+1;
@@ -289,6 +297,7 @@ void P_SpawnGlowingLight(sector_t*  sector)
   g->direction = -1;
 
   sector->special &= ~31; //jff 3/14/98 clear non-generalized sector type
+  P_ChecksumSector(sector);
 }
 
 //////////////////////////////////////////////////////////
@@ -353,6 +362,7 @@ int EV_TurnTagLightsOff(line_t* line)
       tsec->lightlevel < min)
     min = tsec->lightlevel;
       sector->lightlevel = min;
+      P_ChecksumSector(sector);
     }
   return 1;
 }
@@ -389,6 +399,7 @@ int EV_LightTurnOn(line_t *line, int bright)
       tbright = temp->lightlevel;
 
       sector->lightlevel = tbright;
+      P_ChecksumSector(sector);
 
       //jff 5/17/98 unless compatibility optioned
       //then maximum near ANY tagged sector
@@ -437,6 +448,7 @@ int EV_LightTurnOnPartway(line_t *line, fixed_t level)
 
       sector->lightlevel =   // Set level in-between extremes
   (level * bright + (FRACUNIT-level) * min) >> FRACBITS;
+      P_ChecksumSector(sector);
     }
   return 1;
 }
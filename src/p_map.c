@@ -45,6 +45,7 @@
 #include "m_random.h"
 #include "m_bbox.h"
 #include "lprintf.h"
+#include "p_checksum.h"
 
 static mobj_t    *tmthing;
 static fixed_t   tmx;
@@ -751,10 +752,16 @@ boolean P_CheckPosition (mobj_t* thing,fixed_t x,fixed_t y)
   yh = (tmbbox[BOXTOP] - bmaporgy + MAXRADIUS)>>MAPBLOCKSHIFT;
 
 
-  for (bx=xl ; bx<=xh ; bx++)
-    for (by=yl ; by<=yh ; by++)
-      if (!P_BlockThingsIterator(bx,by,PIT_CheckThing))
+  if (thingindex)
+    {
+      if (!P_BoxThingsIterator(tmbbox, PIT_CheckThing))
         return false;
+    }
+  else
+    for (bx=xl ; bx<=xh ; bx++)
+      for (by=yl ; by<=yh ; by++)
+        if (!P_BlockThingsIterator(bx,by,PIT_CheckThing))
+          return false;
 
   // check lines
 
@@ -765,7 +772,7 @@ boolean P_CheckPosition (mobj_t* thing,fixed_t x,fixed_t y)
 
   for (bx=xl ; bx<=xh ; bx++)
     for (by=yl ; by<=yh ; by++)
-      if (!P_BlockLinesIterator (bx,by,PIT_CheckLine))
+      if (!P_BlockLinesIteratorBox (bx,by,tmbbox,PIT_CheckLine))
         return false; // doesn't fit
 
   return true;
@@ -984,7 +991,7 @@ void P_ApplyTorque(mobj_t *mo)
 
   for (bx = xl ; bx <= xh ; bx++)
     for (by = yl ; by <= yh ; by++)
-      P_BlockLinesIterator(bx, by, PIT_ApplyTorque);
+      P_BlockLinesIteratorBox(bx, by, tmbbox, PIT_ApplyTorque);
 
   /* If any momentum, mark object as 'falling' using engine-internal flags */
   if (mo->momx | mo->momy)
@@ -1022,6 +1029,7 @@ boolean P_ThingHeightClip (mobj_t* thing)
 {
   boolean   onfloor;
 
+  P_ChecksumMobj(thing);
   onfloor = (thing->z == thing->floorz);
 
   P_CheckPosition (thing, thing->x, thing->y);
@@ -1841,6 +1849,19 @@ void P_RadiusAttack(mobj_t* spot,mobj_t* source,int damage)
   bombsource = source;
   bombdamage = damage;
 
+  if (thingindex)
+    {
+      fixed_t box[4];
+
+      dist = damage<<FRACBITS;
+      box[BOXTOP] = spot->y + dist;
+      box[BOXBOTTOM] = spot->y - dist;
+      box[BOXRIGHT] = spot->x + dist;
+      box[BOXLEFT] = spot->x - dist;
+      P_BoxThingsIterator(box, PIT_RadiusAttack);
+      return;
+    }
+
   for (y=yl ; y<=yh ; y++)
     for (x=xl ; x<=xh ; x++)
       P_BlockThingsIterator (x, y, PIT_RadiusAttack );
@@ -2216,7 +2237,7 @@ void P_CreateSecNodeList(mobj_t* thing,fixed_t x,fixed_t y)
 
   for (bx=xl ; bx<=xh ; bx++)
     for (by=yl ; by<=yh ; by++)
-      P_BlockLinesIterator(bx,by,PIT_GetSectors);
+      P_BlockLinesIteratorBox(bx,by,tmbbox,PIT_GetSectors);
 
   // Add the sector of the (x,y) point to sector_list.
 
@@ -52,6 +52,15 @@ boolean P_TryMove(mobj_t *thing, fixed_t x, fixed_t y, boolean dropoff);
 boolean P_TeleportMove(mobj_t *thing, fixed_t x, fixed_t y,boolean boss);
 void    P_SlideMove(mobj_t *mo);
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
+
+typedef struct
+{
+  unsigned int hits, misses;  // BSP descents answered from the cache or not
+  int_64_t saved;             // estimated nanoseconds saved, -benchmark only
+} sightcachestats_t;
+
+void    P_InvalidateSightCache(void);
+void    P_GetSightCacheStats(sightcachestats_t *stats);
 void    P_UseLines(player_t *player);
 
 // killough 8/2/98: add 'mask' argument to prevent friends autoaiming at others
@@ -35,11 +35,15 @@
  *-----------------------------------------------------------------------------*/
 
 #include "doomstat.h"
+#include "d_event.h"
 #include "m_bbox.h"
 #include "r_main.h"
 #include "p_maputl.h"
 #include "p_map.h"
 #include "p_setup.h"
+#include "i_system.h"
+#include "m_bench.h"
+#include "p_checksum.h"
 
 //
 // P_AproxDistance
@@ -214,7 +218,196 @@ void P_LineOpening(const line_t *linedef)
 //
 
 //
-// P_UnsetThingPosition
+// THING INDEX
+//
+// Normally a thing is linked only into the block holding its centre,
+// so searches have to widen their box by MAXRADIUS. With thing_index
+// set, things are also linked into every block their radius overlaps,
+// and P_CheckPosition, P_RadiusAttack and A_VileChase search just the
+// blocks their box touches. Things are then found in a different
+// order, so the original linking is kept for demos and netgames unless
+// thing_index is 2.
+//
+
+int thing_index;        // 0 = off, 1 = outside demos and netgames, 2 = always
+boolean thingindex;     // in use for the current level
+
+typedef struct {
+  mobj_t *mobj;
+  int cnext, cprev;     // other nodes in the block, -1 at the ends
+  int block;
+  int mnext;            // the mobj's next node, or next free node
+  short x1, y1;         // lowest block the mobj is linked into
+} thingnode_t;
+
+static int *thingblocks;        // first node of each block
+static thingnode_t *thingnodes;
+static int numthingnodes, maxthingnodes;
+static int freethingnode = -1;
+static int pendingthingnode = -1;
+static int thingquerydepth;
+
+//
+// P_InitThingIndex
+// Called by P_SetupLevel after the blockmap is loaded
+//
+void P_InitThingIndex(void)
+{
+  int i;
+
+  // G_DoPlayDemo only sets demoplayback after the demo's first map is
+  // set up, so check for a pending ga_playdemo as well
+  thingindex = thing_index == 2 ||
+    (thing_index == 1 && !demoplayback && gameaction != ga_playdemo &&
+     !demorecording && !netgame);
+  numthingnodes = 0;
+  freethingnode = pendingthingnode = -1;
+  thingquerydepth = 0;
+  if (!thingindex)
+    return;
+
+  thingblocks = Z_Malloc(bmapwidth*bmapheight*sizeof(*thingblocks), PU_LEVEL, 0);
+  for (i = 0; i < bmapwidth*bmapheight; i++)
+    thingblocks[i] = -1;
+}
+
+static int P_NewThingNode(void)
+{
+  int n;
+
+  if ((n = freethingnode) >= 0)
+    freethingnode = thingnodes[n].mnext;
+  else
+    {
+      if (numthingnodes >= maxthingnodes)
+        thingnodes = realloc(thingnodes, sizeof(*thingnodes) *
+                             (maxthingnodes = maxthingnodes ? maxthingnodes*2 : 256));
+      n = numthingnodes++;
+    }
+  return n;
+}
+
+static void P_LinkThingIndex(mobj_t *thing)
+{
+  int x1 = (thing->x - thing->radius - bmaporgx)>>MAPBLOCKSHIFT;
+  int x2 = (thing->x + thing->radius - bmaporgx)>>MAPBLOCKSHIFT;
+  int y1 = (thing->y - thing->radius - bmaporgy)>>MAPBLOCKSHIFT;
+  int y2 = (thing->y + thing->radius - bmaporgy)>>MAPBLOCKSHIFT;
+  int prev = -1;
+  int x, y;
+
+  if (x2 < 0 || y2 < 0 || x1 >= bmapwidth || y1 >= bmapheight)
+    return;     // off the map
+  if (x1 < 0) x1 = 0;
+  if (y1 < 0) y1 = 0;
+  if (x2 >= bmapwidth) x2 = bmapwidth-1;
+  if (y2 >= bmapheight) y2 = bmapheight-1;
+
+  for (x = x1; x <= x2; x++)
+    for (y = y1; y <= y2; y++)
+      {
+        int n = P_NewThingNode();
+        thingnode_t *node = &thingnodes[n];
+        int block = y*bmapwidth+x;
+
+        node->mobj = thing;
+        node->block = block;
+        node->x1 = x1;
+        node->y1 = y1;
+        node->cprev = -1;
+        if ((node->cnext = thingblocks[block]) >= 0)
+          thingnodes[node->cnext].cprev = n;
+        thingblocks[block] = n;
+
+        node->mnext = -1;
+        if (prev < 0)
+          thing->blocknode = n+1;
+        else
+          thingnodes[prev].mnext = n;
+        prev = n;
+      }
+}
+
+static void P_UnlinkThingIndex(mobj_t *thing)
+{
+  int n = thing->blocknode-1;
+
+  thing->blocknode = 0;
+  while (n >= 0)
+    {
+      thingnode_t *node = &thingnodes[n];
+      int next = node->mnext;
+
+      if (node->cprev >= 0)
+        thingnodes[node->cprev].cnext = node->cnext;
+      else
+        thingblocks[node->block] = node->cnext;
+      if (node->cnext >= 0)
+        thingnodes[node->cnext].cprev = node->cprev;
+
+      // A search may still be standing on this node, so its cnext is
+      // left alone and it isn't reused until the search is over
+      if (thingquerydepth)
+        node->mnext = pendingthingnode, pendingthingnode = n;
+      else
+        node->mnext = freethingnode, freethingnode = n;
+      n = next;
+    }
+}
+
+//
+// P_BoxThingsIterator
+// Things whose radius overlaps the blocks box touches, each once, in
+// block order. Only with thingindex set.
+//
+boolean P_BoxThingsIterator(const fixed_t *box, boolean func(mobj_t*))
+{
+  int xl = (box[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
+  int xh = (box[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
+  int yl = (box[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
+  int yh = (box[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
+  boolean result = true;
+  int bx, by;
+
+  if (xl < 0) xl = 0;
+  if (yl < 0) yl = 0;
+  if (xh >= bmapwidth) xh = bmapwidth-1;
+  if (yh >= bmapheight) yh = bmapheight-1;
+
+  thingquerydepth++;
+  for (bx = xl; bx <= xh && result; bx++)
+    for (by = yl; by <= yh && result; by++)
+      {
+        int n = thingblocks[by*bmapwidth+bx];
+
+        while (n >= 0)
+          {
+            const thingnode_t *node = &thingnodes[n];
+            mobj_t *mobj = node->mobj;
+
+            n = node->cnext;
+            // a thing in several of these blocks is only seen in the first
+            if (bx != MAX(xl, node->x1) || by != MAX(yl, node->y1))
+              continue;
+            if (!func(mobj))
+              {
+                result = false;
+                break;
+              }
+          }
+      }
+
+  if (!--thingquerydepth)
+    while (pendingthingnode >= 0)
+      {
+        int n = pendingthingnode;
+
+        pendingthingnode = thingnodes[n].mnext;
+        thingnodes[n].mnext = freethingnode;
+        freethingnode = n;
+      }
+  return result;
+}
 // Unlinks a thing from block map and sectors.
 // On each position change, BLOCKMAP and other
 // lookups maintaining lists ot things inside
@@ -271,6 +464,9 @@ void P_UnsetThingPosition (mobj_t *thing)
       if (bprev && (*bprev = bnext = thing->bnext))  // unlink from block map
         bnext->bprev = bprev;
     }
+
+  if (thing->blocknode)
+    P_UnlinkThingIndex(thing);
 }
 
 //
@@ -284,6 +480,8 @@ void P_UnsetThingPosition (mobj_t *thing)
 void P_SetThingPosition(mobj_t *thing)
 {                                                      // link into subsector
   subsector_t *ss = thing->subsector = R_PointInSubsector(thing->x, thing->y);
+
+  P_ChecksumMobj(thing);
   if (!(thing->flags & MF_NOSECTOR))
     {
       // invisible things don't go into the sector links
@@ -336,6 +534,9 @@ void P_SetThingPosition(mobj_t *thing)
       }
       else        // thing is off the map
         thing->bnext = NULL, thing->bprev = NULL;
+
+      if (thingindex)
+        P_LinkThingIndex(thing);
     }
 }
 
@@ -357,13 +558,11 @@ void P_SetThingPosition(mobj_t *thing)
 //
 // killough 5/3/98: reformatted, cleaned up
 
-boolean P_BlockLinesIterator(int x, int y, boolean func(line_t*))
+static const long *P_BlockLines(int x, int y)
 {
   int        offset;
   const long *list;   // killough 3/1/98: for removal of blockmap limit
 
-  if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
-    return true;
   offset = y*bmapwidth+x;
   offset = *(blockmap+offset);
   list = blockmaplump+offset;     // original was reading         // phares
@@ -375,13 +574,96 @@ boolean P_BlockLinesIterator(int x, int y, boolean func(line_t*))
 
   if (!demo_compatibility) // killough 2/22/98: demo_compatibility check
     list++;     // skip 0 starting delimiter                      // phares
-  for ( ; *list != -1 ; list++)                                   // phares
+  return list;
+}
+
+boolean P_BlockLinesIterator(int x, int y, boolean func(line_t*))
+{
+  const long *list;
+
+  if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
+    return true;
+  for (list = P_BlockLines(x, y); *list != -1 ; list++)           // phares
     {
-      line_t *ld = &lines[*list];
-      if (ld->validcount == validcount)
+      linegeom_t *lg = &linegeom[*list];
+      if (lg->validcount == validcount)
         continue;       // line has already been checked
-      ld->validcount = validcount;
-      if (!func(ld))
+      lg->validcount = validcount;
+      if (!func(&lines[*list]))
+        return false;
+    }
+  return true;  // everything was checked
+}
+
+//
+// P_BoxOnLineGeomSide
+// P_BoxOnLineSide on the packed copy of a line
+//
+
+static int PUREFUNC P_PointOnLineGeomSide(fixed_t x, fixed_t y, const linegeom_t *lg)
+{
+  return
+    !lg->dx ? x <= lg->x ? lg->dy > 0 : lg->dy < 0 :
+    !lg->dy ? y <= lg->y ? lg->dx < 0 : lg->dx > 0 :
+    FixedMul(y-lg->y, lg->dx>>FRACBITS) >=
+    FixedMul(lg->dy>>FRACBITS, x-lg->x);
+}
+
+static int PUREFUNC P_BoxOnLineGeomSide(const fixed_t *tmbox, const linegeom_t *lg)
+{
+  switch (lg->slopetype)
+    {
+      int p;
+    default:
+    case ST_HORIZONTAL:
+      return
+      (tmbox[BOXBOTTOM] > lg->y) == (p = tmbox[BOXTOP] > lg->y) ?
+        p ^ (lg->dx < 0) : -1;
+    case ST_VERTICAL:
+      return
+        (tmbox[BOXLEFT] < lg->x) == (p = tmbox[BOXRIGHT] < lg->x) ?
+        p ^ (lg->dy < 0) : -1;
+    case ST_POSITIVE:
+      return
+        P_PointOnLineGeomSide(tmbox[BOXRIGHT], tmbox[BOXBOTTOM], lg) ==
+        (p = P_PointOnLineGeomSide(tmbox[BOXLEFT], tmbox[BOXTOP], lg)) ? p : -1;
+    case ST_NEGATIVE:
+      return
+        (P_PointOnLineGeomSide(tmbox[BOXLEFT], tmbox[BOXBOTTOM], lg)) ==
+        (p = P_PointOnLineGeomSide(tmbox[BOXRIGHT], tmbox[BOXTOP], lg)) ? p : -1;
+    }
+}
+
+//
+// P_BlockLinesIteratorBox
+//
+// Same lines in the same order as P_BlockLinesIterator, but lines that
+// don't cross box are skipped without calling func. A line whose
+// bounding box only touches box at an edge doesn't cross it. Only for
+// callbacks that ignore those lines themselves (PIT_CheckLine and the
+// like), so the outcome is unchanged.
+//
+
+boolean P_BlockLinesIteratorBox(int x, int y, const fixed_t *box,
+                                boolean func(line_t*))
+{
+  const long *list;
+
+  if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
+    return true;
+  for (list = P_BlockLines(x, y); *list != -1 ; list++)
+    {
+      linegeom_t *lg = &linegeom[*list];
+      if (lg->validcount == validcount)
+        continue;       // line has already been checked
+      lg->validcount = validcount;
+      if (box[BOXRIGHT]  <= lg->bbox[BOXLEFT]   ||
+          box[BOXLEFT]   >= lg->bbox[BOXRIGHT]  ||
+          box[BOXTOP]    <= lg->bbox[BOXBOTTOM] ||
+          box[BOXBOTTOM] >= lg->bbox[BOXTOP]    ||
+          P_BoxOnLineGeomSide(box, lg) != -1)
+        continue;
+      if (!func(&lines[*list]))
         return false;
     }
   return true;  // everything was checked
@@ -535,24 +817,74 @@ boolean PIT_AddThingIntercepts(mobj_t *thing)
 // for all lines.
 //
 // killough 5/3/98: reformatted, cleaned up
+//
+// The intercepts used to be found by rescanning the whole list for the
+// nearest one each time, which is quadratic in long traces. They're
+// now kept in a binary heap ordered on frac, ties going to the one
+// added first, so they're visited in exactly the old order.
+
+static intercept_t **interceptheap;
+
+#define INTERCEPT_BEFORE(a, b) \
+  ((a)->frac < (b)->frac || ((a)->frac == (b)->frac && (a) < (b)))
+
+static void P_SiftIntercept(int i, int count)
+{
+  intercept_t *in = interceptheap[i];
+
+  for (;;)
+    {
+      int child = 2*i + 1;
+      if (child >= count)
+        break;
+      if (child+1 < count &&
+          INTERCEPT_BEFORE(interceptheap[child+1], interceptheap[child]))
+        child++;
+      if (!INTERCEPT_BEFORE(interceptheap[child], in))
+        break;
+      interceptheap[i] = interceptheap[child];
+      i = child;
+    }
+  interceptheap[i] = in;
+}
 
 boolean P_TraverseIntercepts(traverser_t func, fixed_t maxfrac)
 {
-  intercept_t *in = NULL;
-  int count = intercept_p - intercepts;
-  while (count--)
+  static size_t heapsize;
+  size_t total = intercept_p - intercepts;
+  int_64_t start = benchmarking ? I_GetProfileTime() : 0;
+  intercept_t *scan;
+  int count = 0, i;
+
+  if (total > heapsize)
     {
-      fixed_t dist = INT_MAX;
-      intercept_t *scan;
-      for (scan = intercepts; scan < intercept_p; scan++)
-        if (scan->frac < dist)
-          dist = (in=scan)->frac;
-      if (dist > maxfrac)
-        return true;    // checked everything in range
+      while (heapsize < total)
+        heapsize = heapsize ? heapsize*2 : 128;
+      interceptheap = realloc(interceptheap, sizeof(*interceptheap)*heapsize);
+    }
+
+  // anything past maxfrac would never have been reached
+  for (scan = intercepts; scan < intercept_p; scan++)
+    if (scan->frac <= maxfrac)
+      interceptheap[count++] = scan;
+
+  for (i = count/2 - 1; i >= 0; i--)
+    P_SiftIntercept(i, count);
+
+  while (count)
+    {
+      intercept_t *in = interceptheap[0];
+      interceptheap[0] = interceptheap[--count];
+      P_SiftIntercept(0, count);
       if (!func(in))
-        return false;           // don't bother going farther
-      in->frac = INT_MAX;
+        {
+          if (benchmarking)
+            M_BenchTrace(total, start);
+          return false;           // don't bother going farther
+        }
     }
+  if (benchmarking)
+    M_BenchTrace(total, start);
   return true;                  // everything was traversed
 }
 
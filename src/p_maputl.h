@@ -76,7 +76,15 @@ void    P_LineOpening (const line_t *linedef);
 void    P_UnsetThingPosition(mobj_t *thing);
 void    P_SetThingPosition(mobj_t *thing);
 boolean P_BlockLinesIterator (int x, int y, boolean func(line_t *));
+boolean P_BlockLinesIteratorBox (int x, int y, const fixed_t *box,
+                                 boolean func(line_t *));
 boolean P_BlockThingsIterator(int x, int y, boolean func(mobj_t *));
+
+/* Things linked into every block they overlap, see p_maputl.c */
+extern int thing_index;
+extern boolean thingindex;
+void    P_InitThingIndex(void);
+boolean P_BoxThingsIterator(const fixed_t *box, boolean func(mobj_t *));
 boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
                        int flags, boolean trav(intercept_t *));
 
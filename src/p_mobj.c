@@ -47,6 +47,7 @@
 #include "p_inter.h"
 #include "lprintf.h"
 #include "r_demo.h"
+#include "p_checksum.h"
 
 //
 // P_SetMobjState
@@ -66,6 +67,8 @@ boolean P_SetMobjState(mobj_t* mobj,statenum_t state)
   boolean ret = true;                         // return value
   statenum_t tempstate[NUMSTATES];            // for use with recursion
 
+  P_ChecksumMobj(mobj);
+
   if (recursion++)                            // if recursion detected,
     memset(seenstate=tempstate,0,sizeof tempstate); // clear state table
 
@@ -732,6 +735,11 @@ void P_MobjThinker (mobj_t* mobj)
   mobj->PrevY = mobj->y;
   mobj->PrevZ = mobj->z;
 
+  // things at rest with no state to count down keep their hash
+  if (mobj->momx | mobj->momy | mobj->momz || mobj->z != mobj->floorz ||
+      mobj->tics != -1 || mobj->flags & MF_SKULLFLY)
+    P_ChecksumMobj(mobj);
+
   // momentum movement
   if (mobj->momx | mobj->momy || mobj->flags & MF_SKULLFLY)
     {
@@ -757,7 +765,10 @@ void P_MobjThinker (mobj_t* mobj)
   if (mobj->z > mobj->dropoffz &&      // Only objects contacting dropoff
       !(mobj->flags & MF_NOGRAVITY) && // Only objects which fall
       !comp[comp_falloff]) // Not in old demos
-    P_ApplyTorque(mobj);               // Apply torque
+    {
+      P_ChecksumMobj(mobj);
+      P_ApplyTorque(mobj);             // Apply torque
+    }
   else
     mobj->intflags &= ~MIF_FALLING, mobj->gear = 0;  // Reset torque
       }
@@ -786,6 +797,7 @@ void P_MobjThinker (mobj_t* mobj)
     if (!respawnmonsters)
       return;
 
+    P_ChecksumMobj(mobj);
     mobj->movecount++;
 
     if (mobj->movecount < 12*35)
@@ -803,6 +815,81 @@ void P_MobjThinker (mobj_t* mobj)
   }
 
 
+//
+// Mobj pool
+//
+// Mobjs are carved from slabs of MOBJSPERSLAB, allocated PU_LEVEL and
+// only released with the rest of the level. A removed mobj's slot goes
+// on a free list once P_RemoveMobjDelayed sees nothing referencing it
+// any more, and the most recently freed slot is reused first.
+//
+
+#define MOBJSPERSLAB 128
+
+static mobj_t **mobjslabs;
+static int nummobjslabs, maxmobjslabs;
+static mobj_t *freemobjs;       // linked through thinker.next
+static unsigned int livemobjs, peakmobjs;
+
+//
+// P_InitMobjPool
+// Called by P_SetupLevel after the previous level's memory is freed
+//
+void P_InitMobjPool(void)
+{
+  nummobjslabs = 0;
+  freemobjs = NULL;
+  livemobjs = 0;
+}
+
+mobj_t *P_AllocMobj(void)
+{
+  mobj_t *mobj;
+
+  if (!freemobjs)
+    {
+      int i;
+
+      if (nummobjslabs >= maxmobjslabs)
+        mobjslabs = realloc(mobjslabs, sizeof(*mobjslabs) *
+                            (maxmobjslabs = maxmobjslabs ? maxmobjslabs*2 : 16));
+      mobj = mobjslabs[nummobjslabs++] =
+        Z_Malloc(MOBJSPERSLAB * sizeof(*mobj), PU_LEVEL, NULL);
+
+      // hand out the new slab in address order
+      for (i = MOBJSPERSLAB; i--; )
+        {
+          mobj[i].thinker.next = (thinker_t *) freemobjs;
+          freemobjs = &mobj[i];
+        }
+    }
+
+  mobj = freemobjs;
+  freemobjs = (mobj_t *) mobj->thinker.next;
+
+  if (++livemobjs > peakmobjs)
+    peakmobjs = livemobjs;
+  return mobj;
+}
+
+//
+// P_FreeMobj
+// Return a mobj's memory to the pool
+//
+void P_FreeMobj(mobj_t *mobj)
+{
+  mobj->thinker.next = (thinker_t *) freemobjs;
+  freemobjs = mobj;
+  livemobjs--;
+}
+
+void P_GetMobjPoolStats(mobjpoolstats_t *stats)
+{
+  stats->live = livemobjs;
+  stats->peak = peakmobjs;
+  stats->slabs = nummobjslabs;
+}
+
 //
 // P_SpawnMobj
 //
@@ -812,7 +899,7 @@ mobj_t* P_SpawnMobj(fixed_t x,fixed_t y,fixed_t z,mobjtype_t type)
   state_t*    st;
   mobjinfo_t* info;
 
-  mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+  mobj = P_AllocMobj();
   memset (mobj, 0, sizeof (*mobj));
   info = &mobjinfo[type];
   mobj->type = type;
@@ -872,12 +959,13 @@ mobj_t* P_SpawnMobj(fixed_t x,fixed_t y,fixed_t z,mobjtype_t type)
   P_AddThinker (&mobj->thinker);
   if (!((mobj->flags ^ MF_COUNTKILL) & (MF_FRIEND | MF_COUNTKILL)))
     totallive++;
+  P_ChecksumMobj(mobj);
   return mobj;
   }
 
 
-static mapthing_t itemrespawnque[ITEMQUESIZE];
-static int        itemrespawntime[ITEMQUESIZE];
+mapthing_t itemrespawnque[ITEMQUESIZE];
+int        itemrespawntime[ITEMQUESIZE];
 int        iquehead;
 int        iquetail;
 
@@ -903,6 +991,8 @@ void P_RemoveMobj (mobj_t* mobj)
       iquetail = (iquetail+1)&(ITEMQUESIZE-1);
     }
 
+  P_ChecksumRemoveMobj(mobj);
+
   // unlink from sector and block lists
 
   P_UnsetThingPosition (mobj);
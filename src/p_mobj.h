@@ -351,7 +351,10 @@ typedef struct mobj_s
     fixed_t             PrevY;
     fixed_t             PrevZ;
 
-    fixed_t             pad; // cph - needed so I can get the size unambiguously on amd64
+    // cph - needed so I can get the size unambiguously on amd64.
+    // Savegames don't restore it, so the thing index keeps the first of
+    // the mobj's block nodes here, plus one (see p_maputl.c)
+    int                 blocknode;
 
     // SEE WARNING ABOVE ABOUT POINTER FIELDS!!!
 } mobj_t;
@@ -382,6 +385,8 @@ typedef struct mobj_s
 // Whether an object is "sentient" or not. Used for environmental influences.
 #define sentient(mobj) ((mobj)->health > 0 && (mobj)->info->seestate)
 
+extern mapthing_t itemrespawnque[ITEMQUESIZE];
+extern int itemrespawntime[ITEMQUESIZE];
 extern int iquehead;
 extern int iquetail;
 
@@ -399,5 +404,18 @@ void    P_SpawnMapThing (const mapthing_t*  mthing);
 void    P_SpawnPlayer(int n, const mapthing_t *mthing);
 void    P_CheckMissileSpawn(mobj_t*);  // killough 8/2/98
 void    P_ExplodeMissile(mobj_t*);    // killough
+
+// Mobj storage: slabs that live as long as the level, with freed
+// slots reused before new ones are carved
+typedef struct {
+  unsigned int live;    // mobjs allocated and not yet freed
+  unsigned int peak;    // most live at once since startup
+  unsigned int slabs;   // slabs held by the current level
+} mobjpoolstats_t;
+
+void    P_InitMobjPool(void);
+mobj_t  *P_AllocMobj(void);
+void    P_FreeMobj(mobj_t *mobj);
+void    P_GetMobjPoolStats(mobjpoolstats_t *stats);
 #endif
 
@@ -38,6 +38,7 @@
 #include "p_tick.h"
 #include "s_sound.h"
 #include "sounds.h"
+#include "p_checksum.h"
 
 platlist_t *activeplats;       // killough 2/14/98: made global again
 
@@ -245,6 +246,7 @@ int EV_DoPlat
         sec->special = 0;
         //jff 3/14/98 clear old field as well
         sec->oldspecial = 0;
+        P_ChecksumSector(sec);
 
         S_StartSound((mobj_t *)&sec->soundorg,sfx_stnmov);
         break;
@@ -252,6 +254,7 @@ int EV_DoPlat
       case raiseAndChange:
         plat->speed = PLATSPEED/2;
         sec->floorpic = sides[line->sidenum[0]].sector->floorpic;
+        P_ChecksumSector(sec);
         plat->high = sec->floorheight + amount*FRACUNIT;
         plat->wait = 0;
         plat->status = up;
@@ -41,6 +41,9 @@
 #include "am_map.h"
 #include "p_enemy.h"
 #include "lprintf.h"
+#include "p_map.h"
+#include "p_setup.h"
+#include "g_game.h"
 
 byte *save_p;
 
@@ -195,6 +198,8 @@ void P_UnArchiveWorld (void)
 
   PADSAVEP();                // killough 3/22/98
 
+  P_InvalidateSightCache();  // sector heights are about to change
+
   get = (short *) save_p;
 
   // do sectors
@@ -441,6 +446,9 @@ void P_UnArchiveThinkers (void)
       thinker_t *next = th->next;
       if (th->function == P_MobjThinker)
         P_RemoveMobj ((mobj_t *) th);
+      // mobjs live in the pool, removed ones too
+      if (th->function == P_RemoveMobjDelayed)
+        P_FreeMobj ((mobj_t *) th);
       else
         Z_Free (th);
       th = next;
@@ -468,7 +476,7 @@ void P_UnArchiveThinkers (void)
   // read in saved thinkers
   for (size = 1; *save_p++ == tc_mobj; size++)    // killough 2/14/98
     {
-      mobj_t *mobj = Z_Malloc(sizeof(mobj_t), PU_LEVEL, NULL);
+      mobj_t *mobj = P_AllocMobj();
 
       // killough 2/14/98 -- insert pointers to thinkers into table, in order:
       mobj_p[size] = mobj;
@@ -501,6 +509,7 @@ void P_UnArchiveThinkers (void)
       if (mobj->player)
         (mobj->player = &players[(int) mobj->player - 1]) -> mo = mobj;
 
+      mobj->blocknode = 0;
       P_SetThingPosition (mobj);
       mobj->info = &mobjinfo[mobj->type];
 
@@ -957,6 +966,325 @@ void P_UnArchiveSpecials (void)
       }
 }
 
+//
+// P_ArchiveExtras
+//
+// What a savegame leaves out, for the demo snapshots in g_game.c. It keeps
+// every thinker but not the order of the lists they are threaded on:
+// loading one builds the thinker list as all mobjs followed by all
+// specials and links the things into the blockmap and sectors afresh,
+// which plays fine but visits things (and calls P_Random) in a different
+// order than before. The mobj layout in the savegame also has no room for
+// friction and movefactor, and the corpse and item respawn queues aren't
+// saved at all. Any of these is enough to break demo sync.
+// Savegames don't use this, so their format stays the same.
+//
+// Must follow P_ArchiveSpecials, and P_UnArchiveExtras must follow
+// P_UnArchiveSpecials. Uses the prev fields like P_ThinkerToIndex, call
+// P_IndexToThinker afterwards.
+//
+
+// Whether P_ArchiveSpecials saves this thinker
+static boolean P_IsArchivedSpecial(thinker_t *th)
+{
+  if (!th->function)
+    {
+      platlist_t *pl;
+      ceilinglist_t *cl;
+
+      for (pl=activeplats; pl; pl=pl->next)
+        if (pl->plat == (plat_t *) th)
+          return true;
+      for (cl=activeceilings; cl; cl=cl->next)
+        if (cl->ceiling == (ceiling_t *) th)
+          return true;
+      return false;
+    }
+  return
+    th->function==T_MoveCeiling  || th->function==T_VerticalDoor ||
+    th->function==T_MoveFloor    || th->function==T_PlatRaise    ||
+    th->function==T_LightFlash   || th->function==T_StrobeFlash  ||
+    th->function==T_Glow         || th->function==T_MoveElevator ||
+    th->function==T_Scroll       || th->function==T_Pusher       ||
+    th->function==T_FireFlicker;
+}
+
+#define LINKINDEX(th) ((int)(size_t)(th)->prev)
+
+static void P_ArchiveExtraInt(int value)
+{
+  CheckSaveGame(sizeof value);
+  memcpy(save_p, &value, sizeof value);
+  save_p += sizeof value;
+}
+
+static int P_UnArchiveExtraInt(void)
+{
+  int value;
+
+  memcpy(&value, save_p, sizeof value);
+  save_p += sizeof value;
+  return value;
+}
+
+void P_ArchiveExtras(void)
+{
+  thinker_t *th;
+  int n = 0, i;
+
+  // number the saved thinkers in list order, 0 for the rest
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    th->prev = th->function == P_MobjThinker || P_IsArchivedSpecial(th) ?
+      (thinker_t *)(size_t) ++n : NULL;
+
+  // which of them are mobjs, to merge the two lists again
+  P_ArchiveExtraInt(n);
+  CheckSaveGame(n);
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    if (th->prev)
+      *save_p++ = th->function == P_MobjThinker;
+
+  for (i = 0; i < NUMTHCLASS; i++)
+    {
+      for (th = thinkerclasscap[i].cnext; th != &thinkerclasscap[i]; th = th->cnext)
+        if (th->prev)
+          P_ArchiveExtraInt(LINKINDEX(th));
+      P_ArchiveExtraInt(0);
+    }
+
+  // blockmap and sector thing lists, head first
+  for (i = 0; i < bmapwidth*bmapheight; i++)
+    if (blocklinks[i])
+      {
+        mobj_t *mo;
+
+        P_ArchiveExtraInt(i+1);
+        for (mo = blocklinks[i]; mo; mo = mo->bnext)
+          P_ArchiveExtraInt(LINKINDEX(&mo->thinker));
+        P_ArchiveExtraInt(0);
+      }
+  P_ArchiveExtraInt(0);
+
+  for (i = 0; i < numsectors; i++)
+    if (sectors[i].thinglist)
+      {
+        mobj_t *mo;
+
+        P_ArchiveExtraInt(i+1);
+        for (mo = sectors[i].thinglist; mo; mo = mo->snext)
+          P_ArchiveExtraInt(LINKINDEX(&mo->thinker));
+        P_ArchiveExtraInt(0);
+      }
+  P_ArchiveExtraInt(0);
+
+  // both threads of the sector nodes (phares 3/14/98)
+  for (i = 0; i < numsectors; i++)
+    if (sectors[i].touching_thinglist)
+      {
+        msecnode_t *node;
+
+        P_ArchiveExtraInt(i+1);
+        for (node = sectors[i].touching_thinglist; node; node = node->m_snext)
+          P_ArchiveExtraInt(LINKINDEX(&node->m_thing->thinker));
+        P_ArchiveExtraInt(0);
+      }
+  P_ArchiveExtraInt(0);
+
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    if (th->function == P_MobjThinker)
+      {
+        mobj_t *mo = (mobj_t *) th;
+        msecnode_t *node;
+
+        P_ArchiveExtraInt(mo->friction);
+        P_ArchiveExtraInt(mo->movefactor);
+        for (node = mo->touching_sectorlist; node; node = node->m_tnext)
+          P_ArchiveExtraInt(node->m_sector - sectors + 1);
+        P_ArchiveExtraInt(0);
+      }
+
+  // the player corpses G_CheckSpot removes when the queue wraps
+  P_ArchiveExtraInt(bodyqueslot);
+  for (i = 0; i < MIN(bodyqueslot, bodyquesize); i++)
+    P_ArchiveExtraInt(bodyque[i] ? LINKINDEX(&bodyque[i]->thinker) : 0);
+
+  // the items P_RespawnSpecials brings back
+  P_ArchiveExtraInt(iquehead);
+  P_ArchiveExtraInt(iquetail);
+  CheckSaveGame(ITEMQUESIZE * (sizeof *itemrespawnque + sizeof *itemrespawntime));
+  for (i = iquetail; i != iquehead; i = (i+1)&(ITEMQUESIZE-1))
+    {
+      memcpy(save_p, &itemrespawnque[i], sizeof *itemrespawnque);
+      save_p += sizeof *itemrespawnque;
+      P_ArchiveExtraInt(itemrespawntime[i]);
+    }
+}
+
+void P_UnArchiveExtras(void)
+{
+  thinker_t **thinkers, **mobjs, **specials, *th;
+  int n, nummobjs = 0, numspecials = 0, i, j;
+
+  n = P_UnArchiveExtraInt();
+  thinkers = malloc((n+1) * sizeof *thinkers);
+  mobjs = malloc(n * sizeof *mobjs);
+  specials = malloc(n * sizeof *specials);
+
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    if (th->function == P_MobjThinker)
+      mobjs[nummobjs++] = th;
+    else
+      specials[numspecials++] = th;
+  if (nummobjs + numspecials != n)
+    I_Error("P_UnArchiveExtras: %d thinkers, expected %d", nummobjs + numspecials, n);
+
+  // rebuild the thinker list in the saved order
+  thinkers[0] = NULL;
+  for (i = 1, nummobjs = numspecials = 0; i <= n; i++)
+    thinkers[i] = *save_p++ ? mobjs[nummobjs++] : specials[numspecials++];
+
+  th = &thinkercap;
+  for (i = 1; i <= n; i++)
+    {
+      th->next = thinkers[i];
+      thinkers[i]->prev = th;
+      th = thinkers[i];
+    }
+  th->next = &thinkercap;
+  thinkercap.prev = th;
+
+  for (i = 0; i < NUMTHCLASS; i++)
+    {
+      thinker_t *cap = &thinkerclasscap[i];
+
+      th = cap;
+      while ((j = P_UnArchiveExtraInt()))
+        {
+          th->cnext = thinkers[j];
+          thinkers[j]->cprev = th;
+          th = thinkers[j];
+        }
+      th->cnext = cap;
+      cap->cprev = th;
+    }
+
+  while ((i = P_UnArchiveExtraInt()))
+    {
+      mobj_t **link = &blocklinks[i-1];
+
+      while ((j = P_UnArchiveExtraInt()))
+        {
+          mobj_t *mo = (mobj_t *) thinkers[j];
+
+          *link = mo;
+          mo->bprev = link;
+          link = &mo->bnext;
+        }
+      *link = NULL;
+    }
+
+  while ((i = P_UnArchiveExtraInt()))
+    {
+      mobj_t **link = &sectors[i-1].thinglist;
+
+      while ((j = P_UnArchiveExtraInt()))
+        {
+          mobj_t *mo = (mobj_t *) thinkers[j];
+
+          *link = mo;
+          mo->sprev = link;
+          link = &mo->snext;
+        }
+      *link = NULL;
+    }
+
+  // the same nodes exist again, only their order needs changing
+  while ((i = P_UnArchiveExtraInt()))
+    {
+      sector_t *sec = &sectors[i-1];
+      msecnode_t *prev = NULL, *node;
+
+      while ((j = P_UnArchiveExtraInt()))
+        {
+          for (node = sec->touching_thinglist; node; node = node->m_snext)
+            if (node->m_thing == (mobj_t *) thinkers[j])
+              break;
+          if (!node)
+            I_Error("P_UnArchiveExtras: missing sector node");
+
+          // unlink, then relink after the ones already in order
+          if (node->m_sprev)
+            node->m_sprev->m_snext = node->m_snext;
+          else
+            sec->touching_thinglist = node->m_snext;
+          if (node->m_snext)
+            node->m_snext->m_sprev = node->m_sprev;
+
+          node->m_sprev = prev;
+          node->m_snext = prev ? prev->m_snext : sec->touching_thinglist;
+          if (node->m_snext)
+            node->m_snext->m_sprev = node;
+          if (prev)
+            prev->m_snext = node;
+          else
+            sec->touching_thinglist = node;
+          prev = node;
+        }
+    }
+
+  for (i = 1; i <= n; i++)
+    if (thinkers[i]->function == P_MobjThinker)
+      {
+        mobj_t *mo = (mobj_t *) thinkers[i];
+        msecnode_t *prev = NULL, *node;
+
+        mo->friction = P_UnArchiveExtraInt();
+        mo->movefactor = P_UnArchiveExtraInt();
+        while ((j = P_UnArchiveExtraInt()))
+          {
+            for (node = mo->touching_sectorlist; node; node = node->m_tnext)
+              if (node->m_sector == &sectors[j-1])
+                break;
+            if (!node)
+              I_Error("P_UnArchiveExtras: missing thing node");
+
+            if (node->m_tprev)
+              node->m_tprev->m_tnext = node->m_tnext;
+            else
+              mo->touching_sectorlist = node->m_tnext;
+            if (node->m_tnext)
+              node->m_tnext->m_tprev = node->m_tprev;
+
+            node->m_tprev = prev;
+            node->m_tnext = prev ? prev->m_tnext : mo->touching_sectorlist;
+            if (node->m_tnext)
+              node->m_tnext->m_tprev = node;
+            if (prev)
+              prev->m_tnext = node;
+            else
+              mo->touching_sectorlist = node;
+            prev = node;
+          }
+      }
+
+  bodyqueslot = P_UnArchiveExtraInt();
+  for (i = 0; i < MIN(bodyqueslot, bodyquesize); i++)
+    bodyque[i] = (mobj_t *) thinkers[P_UnArchiveExtraInt()];
+
+  iquehead = P_UnArchiveExtraInt();
+  iquetail = P_UnArchiveExtraInt();
+  for (i = iquetail; i != iquehead; i = (i+1)&(ITEMQUESIZE-1))
+    {
+      memcpy(&itemrespawnque[i], save_p, sizeof *itemrespawnque);
+      save_p += sizeof *itemrespawnque;
+      itemrespawntime[i] = P_UnArchiveExtraInt();
+    }
+
+  free(specials);
+  free(mobjs);
+  free(thinkers);
+}
+
 // killough 2/16/98: save/restore random number generator state information
 
 void P_ArchiveRNG(void)
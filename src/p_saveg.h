@@ -51,6 +51,10 @@ void P_UnArchiveSpecials(void);
 void P_ThinkerToIndex(void); /* phares 9/13/98: save soundtarget in savegame */
 void P_IndexToThinker(void); /* phares 9/13/98: save soundtarget in savegame */
 
+/* list orders and mobj fields savegames leave out, for demo snapshots */
+void P_ArchiveExtras(void);
+void P_UnArchiveExtras(void);
+
 /* 1/18/98 killough: add RNG info to savegame */
 void P_ArchiveRNG(void);
 void P_UnArchiveRNG(void);
@@ -33,6 +33,9 @@
  *-----------------------------------------------------------------------------*/
 
 #include <math.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #include "doomstat.h"
 #include "m_bbox.h"
@@ -52,6 +55,8 @@
 #include "v_video.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#include "i_system.h"
+#include "md5.h"
 
 //
 // MAP related Lookup tables.
@@ -137,11 +142,14 @@ long      *blockmap;              // was short -- killough
 
 // offsets in blockmap are from here
 long      *blockmaplump;          // was short -- killough
+static long blockmapsize;         // entries in blockmaplump
 
 fixed_t   bmaporgx, bmaporgy;     // origin of block map
 
 mobj_t    **blocklinks;           // for thing chains
 
+linegeom_t *linegeom;             // per line, for the blockmap iterators
+
 //
 // REJECT
 // For fast sight rejection.
@@ -355,6 +363,299 @@ static int GetOffset(vertex_t *v1, vertex_t *v2)
 
 
 
+//
+// Level cache
+//
+// Everything P_SetupLevel derives from the map lumps beyond a plain copy
+// (the blockmap, seg lengths and offsets, sector line lists and boxes,
+// and vertexes moved by P_RemoveSlimeTrails) is written to a file the
+// first time a map is set up, named after an MD5 of the lumps and
+// settings it was built from. Later loads of the same map read it back
+// instead of rebuilding. A changed map or setting hashes to another file;
+// a file from an older layout fails the version check and is rebuilt.
+// Off by default, as nothing ever deletes the files.
+//
+
+#define LEVELCACHE_VERSION 1
+
+int levelcache = 0;              // use and write level cache files
+
+typedef struct
+{
+  char magic[8];                 // "PRBLVLC"
+  int version;
+  byte key[16];
+  int numvertexes, numsegs, numsubsectors, numsectors, numlines;
+  int linetotal;                 // sector line list entries
+  int blockmapsize;              // entries in blockmaplump
+  fixed_t bmaporgx, bmaporgy;
+  int bmapwidth, bmapheight;
+} levelcache_t;
+
+// per sector, following the seg and subsector arrays
+typedef struct
+{
+  int linecount;
+  int blockbox[4];
+  fixed_t soundx, soundy;
+} levelcachesector_t;
+
+static byte levelcache_key[16];
+static byte *levelcache_data;    // whole cache file while a level is set up
+static const levelcache_t *levelcache_hdr;
+
+static void P_LevelCacheName(char *name, const byte *key)
+{
+  int i;
+
+  name += sprintf(name, "%s/levelcache", I_DoomExeDir());
+  *name++ = '/';
+  for (i = 0; i < 16; i++)
+    name += sprintf(name, "%02x", key[i]);
+  strcpy(name, ".dat");
+}
+
+static void P_HashLumps(struct MD5Context *md5, int first, int last)
+{
+  int i;
+
+  for (i = first; i <= last; i++)
+  {
+    int len = W_LumpLength(i);
+
+    MD5Update(md5, (const md5byte *)&len, sizeof len);
+    if (len)
+    {
+      MD5Update(md5, W_CacheLumpNum(i), len);
+      W_UnlockLumpNum(i);
+    }
+  }
+}
+
+//
+// P_OpenLevelCache
+// Works out the key for the map about to be loaded and reads its cache
+// file, if there is one.
+//
+static void P_OpenLevelCache(int lumpnum, int gl_lumpnum, boolean slimetrails)
+{
+  struct MD5Context md5;
+  int settings[5];
+  char name[PATH_MAX+1];
+  FILE *fp;
+  long size;
+
+  levelcache_data = NULL;
+  levelcache_hdr = NULL;
+  if (!levelcache)
+    return;
+
+  settings[0] = LEVELCACHE_VERSION;
+  settings[1] = nodesVersion;
+  settings[2] = M_CheckParm("-blockmap") != 0;
+  settings[3] = slimetrails;
+  settings[4] = comp[comp_sound];
+
+  MD5Init(&md5);
+  MD5Update(&md5, (const md5byte *)settings, sizeof settings);
+  P_HashLumps(&md5, lumpnum + ML_LINEDEFS, lumpnum + ML_SECTORS);
+  P_HashLumps(&md5, lumpnum + ML_BLOCKMAP, lumpnum + ML_BLOCKMAP);
+  if (nodesVersion > 0)
+    P_HashLumps(&md5, gl_lumpnum + ML_GL_VERTS, gl_lumpnum + ML_GL_NODES);
+  MD5Final(levelcache_key, &md5);
+
+  P_LevelCacheName(name, levelcache_key);
+  if (!(fp = fopen(name, "rb")))
+    return;
+
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (size >= (long)sizeof(levelcache_t))
+  {
+    levelcache_data = Z_Malloc(size, PU_STATIC, 0);
+    levelcache_hdr = (const levelcache_t *)levelcache_data;
+    if (fread(levelcache_data, 1, size, fp) != (size_t)size ||
+        memcmp(levelcache_hdr->magic, "PRBLVLC", 8) ||
+        levelcache_hdr->version != LEVELCACHE_VERSION ||
+        memcmp(levelcache_hdr->key, levelcache_key, 16) ||
+        size != (long)(sizeof(levelcache_t) +
+          levelcache_hdr->numvertexes * sizeof(vertex_t) +
+          levelcache_hdr->numsegs * (sizeof(float) + sizeof(fixed_t) + sizeof(angle_t)) +
+          levelcache_hdr->numsubsectors * sizeof(int) +
+          levelcache_hdr->numsectors * sizeof(levelcachesector_t) +
+          levelcache_hdr->linetotal * sizeof(int) +
+          levelcache_hdr->blockmapsize * sizeof(int)))
+    {
+      lprintf(LO_WARN, "P_OpenLevelCache: ignoring stale %s\n", name);
+      Z_Free(levelcache_data);
+      levelcache_data = NULL;
+      levelcache_hdr = NULL;
+    }
+  }
+  fclose(fp);
+}
+
+static void P_CloseLevelCache(void)
+{
+  Z_Free(levelcache_data);
+  levelcache_data = NULL;
+  levelcache_hdr = NULL;
+}
+
+// the cached arrays, in file order
+#define LC_VERTEXES(h)   ((const vertex_t *)((h) + 1))
+#define LC_SEGLENGTH(h)  ((const float *)(LC_VERTEXES(h) + (h)->numvertexes))
+#define LC_SEGOFFSET(h)  ((const fixed_t *)(LC_SEGLENGTH(h) + (h)->numsegs))
+#define LC_SEGANGLE(h)   ((const angle_t *)(LC_SEGOFFSET(h) + (h)->numsegs))
+#define LC_SSECTOR(h)    ((const int *)(LC_SEGANGLE(h) + (h)->numsegs))
+#define LC_SECTORS(h)    ((const levelcachesector_t *)(LC_SSECTOR(h) + (h)->numsubsectors))
+#define LC_LINES(h)      ((const int *)(LC_SECTORS(h) + (h)->numsectors))
+#define LC_BLOCKMAP(h)   ((const int *)(LC_LINES(h) + (h)->linetotal))
+
+// the map data is all loaded, check the cache was built from the same
+static boolean P_LevelCacheMatches(void)
+{
+  const levelcache_t *h = levelcache_hdr;
+
+  return h && h->numvertexes == numvertexes && h->numsegs == numsegs &&
+    h->numsubsectors == numsubsectors && h->numsectors == numsectors &&
+    h->numlines == numlines;
+}
+
+//
+// P_LoadLevelCache
+// Stands in for P_LoadBlockMap's and P_LoadSegs' sums, P_GroupLines and
+// P_RemoveSlimeTrails. Returns P_GroupLines' line total.
+//
+static int P_LoadLevelCache(void)
+{
+  const levelcache_t *h = levelcache_hdr;
+  const levelcachesector_t *cs = LC_SECTORS(h);
+  const int *cl = LC_LINES(h);
+  line_t **linebuffer;
+  int i, j;
+
+  if (!P_LevelCacheMatches())
+    I_Error("P_LoadLevelCache: level cache doesn't match the map, delete %s/levelcache",
+            I_DoomExeDir());
+
+  blockmapsize = h->blockmapsize;
+  blockmaplump = Z_Malloc(sizeof(*blockmaplump) * h->blockmapsize, PU_LEVEL, 0);
+  for (i = 0; i < h->blockmapsize; i++)
+    blockmaplump[i] = LC_BLOCKMAP(h)[i];
+  bmaporgx = h->bmaporgx;
+  bmaporgy = h->bmaporgy;
+  bmapwidth = h->bmapwidth;
+  bmapheight = h->bmapheight;
+  blocklinks = Z_Calloc(bmapwidth*bmapheight, sizeof(*blocklinks), PU_LEVEL, 0);
+  blockmap = blockmaplump+4;
+
+  for (i = 0; i < numsegs; i++)
+  {
+    segs[i].length = LC_SEGLENGTH(h)[i];
+    segs[i].offset = LC_SEGOFFSET(h)[i];
+    segs[i].angle = LC_SEGANGLE(h)[i];
+  }
+
+  for (i = 0; i < numsubsectors; i++)
+    subsectors[i].sector = &sectors[LC_SSECTOR(h)[i]];
+
+  linebuffer = Z_Malloc(h->linetotal*sizeof(line_t *), PU_LEVEL, 0);
+  for (i = 0; i < numsectors; i++, cs++)
+  {
+    sectors[i].lines = linebuffer;
+    sectors[i].linecount = cs->linecount;
+    for (j = 0; j < cs->linecount; j++)
+      *linebuffer++ = &lines[*cl++];
+    memcpy(sectors[i].blockbox, cs->blockbox, sizeof cs->blockbox);
+    sectors[i].soundorg.x = cs->soundx;
+    sectors[i].soundorg.y = cs->soundy;
+  }
+
+  // the slime trail free vertexes go in once nothing is derived from them
+  memcpy(vertexes, LC_VERTEXES(h), numvertexes * sizeof(vertex_t));
+
+  return h->linetotal;
+}
+
+//
+// P_SaveLevelCache
+// Writes out what the level setup worked out the slow way.
+//
+static void P_SaveLevelCache(int linetotal)
+{
+  levelcache_t h;
+  char name[PATH_MAX+1];
+  FILE *fp;
+  int i, j;
+
+  P_LevelCacheName(name, levelcache_key);
+  *strrchr(name, '/') = 0;
+#ifdef _WIN32
+  mkdir(name);
+#else
+  mkdir(name, 0755);
+#endif
+  name[strlen(name)] = '/';
+  if (!(fp = fopen(name, "wb")))
+    return;
+
+  memset(&h, 0, sizeof h);
+  strcpy(h.magic, "PRBLVLC");
+  h.version = LEVELCACHE_VERSION;
+  memcpy(h.key, levelcache_key, 16);
+  h.numvertexes = numvertexes;
+  h.numsegs = numsegs;
+  h.numsubsectors = numsubsectors;
+  h.numsectors = numsectors;
+  h.numlines = numlines;
+  h.linetotal = linetotal;
+  h.blockmapsize = blockmapsize;
+  h.bmaporgx = bmaporgx;
+  h.bmaporgy = bmaporgy;
+  h.bmapwidth = bmapwidth;
+  h.bmapheight = bmapheight;
+  fwrite(&h, sizeof h, 1, fp);
+
+  fwrite(vertexes, sizeof(vertex_t), numvertexes, fp);
+  for (i = 0; i < numsegs; i++)
+    fwrite(&segs[i].length, sizeof(float), 1, fp);
+  for (i = 0; i < numsegs; i++)
+    fwrite(&segs[i].offset, sizeof(fixed_t), 1, fp);
+  for (i = 0; i < numsegs; i++)
+    fwrite(&segs[i].angle, sizeof(angle_t), 1, fp);
+  for (i = 0; i < numsubsectors; i++)
+  {
+    int s = subsectors[i].sector - sectors;
+    fwrite(&s, sizeof s, 1, fp);
+  }
+  for (i = 0; i < numsectors; i++)
+  {
+    levelcachesector_t cs;
+
+    cs.linecount = sectors[i].linecount;
+    memcpy(cs.blockbox, sectors[i].blockbox, sizeof cs.blockbox);
+    cs.soundx = sectors[i].soundorg.x;
+    cs.soundy = sectors[i].soundorg.y;
+    fwrite(&cs, sizeof cs, 1, fp);
+  }
+  for (i = 0; i < numsectors; i++)
+    for (j = 0; j < sectors[i].linecount; j++)
+    {
+      int l = sectors[i].lines[j] - lines;
+      fwrite(&l, sizeof l, 1, fp);
+    }
+  for (i = 0; i < h.blockmapsize; i++)
+  {
+    int b = blockmaplump[i];
+    fwrite(&b, sizeof b, 1, fp);
+  }
+
+  if (ferror(fp) | fclose(fp))
+    remove(name);                // don't leave a truncated file behind
+}
+
 //
 // P_LoadSegs
 //
@@ -389,7 +690,8 @@ static void P_LoadSegs (int lump)
       li->v2 = &vertexes[v2];
 
       li->miniseg = false; // figgi -- there are no minisegs in classic BSP nodes
-      li->length  = GetDistance(li->v2->x - li->v1->x, li->v2->y - li->v1->y);
+      if (!levelcache_hdr) // the level cache has it otherwise
+        li->length  = GetDistance(li->v2->x - li->v1->x, li->v2->y - li->v1->y);
       li->angle = (SHORT(ml->angle))<<16;
       li->offset =(SHORT(ml->offset))<<16;
       linedef = (unsigned short)SHORT(ml->linedef);
@@ -451,20 +753,23 @@ static void P_LoadGLSegs(int lump)
       ldef = &lines[ml->linedef];
       segs[i].linedef = ldef;
       segs[i].miniseg = false;
-      segs[i].angle = R_PointToAngle2(segs[i].v1->x,segs[i].v1->y,segs[i].v2->x,segs[i].v2->y);
 
       segs[i].sidedef = &sides[ldef->sidenum[ml->side]];
-      segs[i].length  = GetDistance(segs[i].v2->x - segs[i].v1->x, segs[i].v2->y - segs[i].v1->y);
       segs[i].frontsector = sides[ldef->sidenum[ml->side]].sector;
       if (ldef->flags & ML_TWOSIDED)
         segs[i].backsector = sides[ldef->sidenum[ml->side^1]].sector;
       else
         segs[i].backsector = 0;
 
-      if (ml->side)
-        segs[i].offset = GetOffset(segs[i].v1, ldef->v2);
-      else
-        segs[i].offset = GetOffset(segs[i].v1, ldef->v1);
+      if (!levelcache_hdr) // the level cache has these otherwise
+      {
+        segs[i].angle = R_PointToAngle2(segs[i].v1->x,segs[i].v1->y,segs[i].v2->x,segs[i].v2->y);
+        segs[i].length  = GetDistance(segs[i].v2->x - segs[i].v1->x, segs[i].v2->y - segs[i].v1->y);
+        if (ml->side)
+          segs[i].offset = GetOffset(segs[i].v1, ldef->v2);
+        else
+          segs[i].offset = GetOffset(segs[i].v1, ldef->v1);
+      }
     }
     else
     {
@@ -1137,7 +1442,8 @@ static void P_CreateBlockMap(void)
 
   // Create the blockmap lump
 
-  blockmaplump = Z_Malloc(sizeof(*blockmaplump) * (4+NBlocks+linetotal),
+  blockmapsize = 4+NBlocks+linetotal;
+  blockmaplump = Z_Malloc(sizeof(*blockmaplump) * blockmapsize,
                           PU_LEVEL, 0);
   // blockmap header
 
@@ -1197,6 +1503,7 @@ static void P_LoadBlockMap (int lump)
       long i;
       // cph - const*, wad lump handling updated
       const short *wadblockmaplump = W_CacheLumpNum(lump);
+      blockmapsize = count;
       blockmaplump = Z_Malloc(sizeof(*blockmaplump) * count, PU_LEVEL, 0);
 
       // killough 3/1/98: Expand wad blockmap into larger internal one,
@@ -1493,6 +1800,30 @@ static void P_RemoveSlimeTrails(void)         // killough 10/98
   free(hit);
 }
 
+//
+// P_InitLineGeom
+// Pack what the blockmap iterators test into one array, see p_setup.h
+//
+static void P_InitLineGeom(void)
+{
+  int i;
+
+  linegeom = Z_Malloc((numlines ? numlines : 1) * sizeof(*linegeom), PU_LEVEL, 0);
+  for (i = 0; i < numlines; i++)
+    {
+      const line_t *ld = &lines[i];
+      linegeom_t *lg = &linegeom[i];
+
+      memcpy(lg->bbox, ld->bbox, sizeof(lg->bbox));
+      lg->x = ld->v1->x;
+      lg->y = ld->v1->y;
+      lg->dx = ld->dx;
+      lg->dy = ld->dy;
+      lg->slopetype = ld->slopetype;
+      lg->validcount = 0;
+    }
+}
+
 //
 // P_SetupLevel
 //
@@ -1507,6 +1838,9 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   char  gl_lumpname[9];
   int   gl_lumpnum;
 
+  boolean slimetrails;
+  int   totallines;
+
   R_StopAllInterpolations();
 
   totallive = totalkills = totalitems = totalsecret = wminfo.maxfrags = 0;
@@ -1522,6 +1856,10 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   S_Start();
 
   Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+  W_CancelPrefetch();
+  W_UnpinLumps();
+  P_InvalidateSightCache();
+  P_InitMobjPool();
   if (rejectlump != -1) { // cph - unlock the reject table
     W_UnlockLumpNum(rejectlump);
     rejectlump = -1;
@@ -1569,6 +1907,13 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   // figgi 10/19/00 -- check for gl lumps and load them
   P_GetNodesVersion(lumpnum,gl_lumpnum);
 
+  // e6y
+  // Correction of desync on dv04-423.lmp/dv.wad
+  // http://www.doomworld.com/vb/showthread.php?s=&postid=627257#post627257
+  slimetrails = compatibility_level>=lxdoom_1_compatibility || M_CheckParm("-force_remove_slime_trails") > 0;
+
+  P_OpenLevelCache(lumpnum, gl_lumpnum, slimetrails);
+
   if (nodesVersion > 0)
     P_LoadVertexes2 (lumpnum+ML_VERTEXES,gl_lumpnum+ML_GL_VERTS);
   else
@@ -1578,7 +1923,8 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   P_LoadLineDefs  (lumpnum+ML_LINEDEFS);
   P_LoadSideDefs2 (lumpnum+ML_SIDEDEFS);
   P_LoadLineDefs2 (lumpnum+ML_LINEDEFS);
-  P_LoadBlockMap  (lumpnum+ML_BLOCKMAP);
+  if (!levelcache_hdr)
+    P_LoadBlockMap  (lumpnum+ML_BLOCKMAP);
 
   if (nodesVersion > 0)
   {
@@ -1610,13 +1956,24 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
 
   // reject loading and underflow padding separated out into new function
   // P_GroupLines modified to return a number the underflow padding needs
-  P_LoadReject(lumpnum, P_GroupLines());
+  totallines = levelcache_hdr ? P_LoadLevelCache() : P_GroupLines();
+  P_LoadReject(lumpnum, totallines);
+  P_InitSoundLines();
+  P_InitThingIndex();
 
-  // e6y
-  // Correction of desync on dv04-423.lmp/dv.wad
-  // http://www.doomworld.com/vb/showthread.php?s=&postid=627257#post627257
-  if (compatibility_level>=lxdoom_1_compatibility || M_CheckParm("-force_remove_slime_trails") > 0)
-    P_RemoveSlimeTrails();    // killough 10/98: remove slime trails from wad
+  if (levelcache_hdr)
+    P_CloseLevelCache();
+  else
+  {
+    if (slimetrails)
+      P_RemoveSlimeTrails();    // killough 10/98: remove slime trails from wad
+    if (levelcache)
+      P_SaveLevelCache(totallines);
+  }
+
+  // after P_RemoveSlimeTrails, which can move the v1 it copies, so the
+  // copy matches on a level cache hit or miss
+  P_InitLineGeom();
 
   // Note: you don't need to clear player queue slots --
   // a much simpler fix is in g_game.c -- killough 10/98
@@ -1663,6 +2020,8 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   P_MapEnd();
 
   // preload graphics
+  R_PinLevelLumps();
+  R_StoreLevelTextures();
   if (precache)
     R_PrecacheLevel();
 
@@ -35,6 +35,7 @@
 #define __P_SETUP__
 
 #include "p_mobj.h"
+#include "r_defs.h"
 
 #ifdef __GNUG__
 #pragma interface
@@ -54,4 +55,17 @@ extern fixed_t  bmaporgx;
 extern fixed_t  bmaporgy;        /* origin of block map */
 extern mobj_t   **blocklinks;    /* for thing chains */
 
+/* The parts of each line the blockmap iterators need, packed together
+ * and indexed like lines[], so lines can be rejected by their bounding
+ * box without touching line_t */
+typedef struct {
+  fixed_t bbox[4];
+  fixed_t x, y;         /* v1 */
+  fixed_t dx, dy;
+  slopetype_t slopetype;
+  int validcount;       /* the iterators' own, line_t's is left to sight */
+} linegeom_t;
+
+extern linegeom_t *linegeom;
+
 #endif
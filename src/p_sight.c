@@ -38,6 +38,9 @@
 #include "p_setup.h"
 #include "m_bbox.h"
 #include "lprintf.h"
+#include "m_argv.h"
+#include "i_system.h"
+#include "m_bench.h"
 
 //
 // P_CheckSight
@@ -55,6 +58,56 @@ typedef struct {
 
 static los_t los; // cph - made static
 
+//
+// Sight cache
+//
+// Many monsters stand still and look at a player who stands still, so
+// the same BSP descent gets repeated tic after tic. Its result only
+// depends on the two endpoints and on sector heights, so it's kept in a
+// small direct-mapped table keyed on the endpoints. Every plane move
+// bumps sightgeneration, which drops the whole table at once.
+//
+
+#define SIGHTCACHE_SIZE 512 // power of two
+
+typedef struct {
+  fixed_t x1, y1, z1, h1;   // looker
+  fixed_t x2, y2, z2, h2;   // target
+  unsigned int generation;  // 0 = empty
+  boolean visible;
+} sightcache_t;
+
+static sightcache_t sightcache[SIGHTCACHE_SIZE];
+static unsigned int sightgeneration = 1;
+static int sightcache_state = -1; // -1 = not checked for -nosightcache yet
+static unsigned int sightcache_hits, sightcache_misses;
+static int_64_t sightcache_misstime; // time spent in misses, -benchmark only
+
+void P_InvalidateSightCache(void)
+{
+  // on wraparound clear stale entries, which could otherwise match again
+  if (!++sightgeneration) {
+    memset(sightcache, 0, sizeof(sightcache));
+    sightgeneration = 1;
+  }
+}
+
+void P_GetSightCacheStats(sightcachestats_t *stats)
+{
+  stats->hits = sightcache_hits;
+  stats->misses = sightcache_misses;
+  stats->saved = sightcache_misses ?
+    sightcache_misstime / sightcache_misses * sightcache_hits : 0;
+}
+
+static sightcache_t *P_SightCacheEntry(const mobj_t *t1, const mobj_t *t2)
+{
+  unsigned int hash =
+    (t1->x >> FRACBITS) * 31 + (t1->y >> FRACBITS) * 17 +
+    (t2->x >> FRACBITS) * 7 + (t2->y >> FRACBITS) + (t1->z >> FRACBITS);
+  return &sightcache[(hash ^ (hash >> 9)) & (SIGHTCACHE_SIZE-1)];
+}
+
 //
 // P_DivlineSide
 // Returns side 0 (front), 1 (back), or 2 (on).
@@ -259,6 +312,8 @@ static boolean P_CrossBSPNode(int bspnum)
 //
 // killough 4/20/98: cleaned up, made to use new LOS struct
 
+static boolean P_CheckSightLine(const mobj_t *t1, const mobj_t *t2);
+
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
 {
   const sector_t *s1 = t1->subsector->sector;
@@ -295,6 +350,48 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
       (compatibility_level >= mbf_compatibility))
     return true;
 
+  if (sightcache_state < 0)
+    sightcache_state = !M_CheckParm("-nosightcache");
+
+  if (sightcache_state) {
+    sightcache_t *entry = P_SightCacheEntry(t1, t2);
+    int_64_t start;
+    boolean visible;
+
+    if (entry->generation == sightgeneration &&
+        entry->x1 == t1->x && entry->y1 == t1->y &&
+        entry->z1 == t1->z && entry->h1 == t1->height &&
+        entry->x2 == t2->x && entry->y2 == t2->y &&
+        entry->z2 == t2->z && entry->h2 == t2->height) {
+      sightcache_hits++;
+      return entry->visible;
+    }
+
+    start = benchmarking ? I_GetProfileTime() : 0;
+    visible = P_CheckSightLine(t1, t2);
+    if (benchmarking)
+      sightcache_misstime += I_GetProfileTime() - start;
+    sightcache_misses++;
+
+    entry->x1 = t1->x; entry->y1 = t1->y;
+    entry->z1 = t1->z; entry->h1 = t1->height;
+    entry->x2 = t2->x; entry->y2 = t2->y;
+    entry->z2 = t2->z; entry->h2 = t2->height;
+    entry->generation = sightgeneration;
+    entry->visible = visible;
+    return visible;
+  }
+
+  return P_CheckSightLine(t1, t2);
+}
+
+//
+// P_CheckSightLine
+// The BSP descent behind P_CheckSight, once the quick tests have passed.
+//
+
+static boolean P_CheckSightLine(const mobj_t *t1, const mobj_t *t2)
+{
   // An unobstructed LOS is possible.
   // Now look from eyes of t1 to any part of t2.
 
@@ -58,6 +58,7 @@
 #include "d_deh.h"
 #include "r_plane.h"
 #include "lprintf.h"
+#include "p_checksum.h"
 
 //
 // Animating textures and planes
@@ -2230,6 +2231,7 @@ void P_PlayerInSpecialSector (player_t* player)
         // Tally player in secret sector, clear secret special
         player->secretcount++;
         sector->special = 0;
+        P_ChecksumSector(sector);
         break;
 
       case 11:
@@ -2280,6 +2282,7 @@ void P_PlayerInSpecialSector (player_t* player)
       sector->special &= ~SECRET_MASK;
       if (sector->special<32) // if all extended bits clear,
         sector->special=0;    // sector is not special anymore
+      P_ChecksumSector(sector);
     }
 
     // phares 3/19/98:
@@ -2646,6 +2649,7 @@ void T_Scroll(scroll_t *s)
         sec = sectors + s->affectee;
         sec->floor_xoffs += dx;
         sec->floor_yoffs += dy;
+        P_ChecksumSector(sec);
         break;
 
     case sc_ceiling:               // killough 3/7/98: Scroll ceiling texture
@@ -2676,6 +2680,7 @@ void T_Scroll(scroll_t *s)
             // non-floating, and clipped.
             thing->momx += dx;
             thing->momy += dy;
+            P_ChecksumMobj(thing);
           }
       break;
 
@@ -3154,6 +3159,7 @@ static boolean PIT_PushThing(mobj_t* thing)
           pushangle >>= ANGLETOFINESHIFT;
           thing->momx += FixedMul(speed,finecosine[pushangle]);
           thing->momy += FixedMul(speed,finesine[pushangle]);
+          P_ChecksumMobj(thing);
         }
     }
   return true;
@@ -31,17 +31,40 @@
  *
  *-----------------------------------------------------------------------------*/
 
+#include <stdio.h>
+
 #include "doomstat.h"
 #include "p_user.h"
 #include "p_spec.h"
 #include "p_tick.h"
 #include "p_map.h"
 #include "r_fps.h"
+#include "i_system.h"
+#include "p_checksum.h"
 
 int leveltime;
 
 static boolean newthinkerpresent;
 
+// -thinkerarray: run from a flat array of the thinker list, rebuilt
+// whenever a thinker is freed. Thinkers added while the array runs are
+// picked up from the list afterwards, so the order is unchanged.
+boolean thinkerarray;
+
+static thinker_t **thinkers;
+static int numthinkers, maxthinkers;
+static boolean thinkersdirty = true;
+static boolean runningthinkers;
+static thinker_t *firstnewthinker;  // first thinker added during the run
+
+static void P_AppendThinker(thinker_t *thinker)
+{
+  if (numthinkers >= maxthinkers)
+    thinkers = realloc(thinkers, sizeof(*thinkers) *
+                       (maxthinkers = maxthinkers ? maxthinkers*2 : 128));
+  thinkers[numthinkers++] = thinker;
+}
+
 //
 // THINKERS
 // All thinkers should be allocated by Z_Malloc
@@ -66,6 +89,8 @@ void P_InitThinkers(void)
     thinkerclasscap[i].cprev = thinkerclasscap[i].cnext = &thinkerclasscap[i];
 
   thinkercap.prev = thinkercap.next  = &thinkercap;
+  thinkersdirty = true;
+  P_ChecksumReset();
 }
 
 //
@@ -81,7 +106,8 @@ void P_UpdateThinker(thinker_t *thinker)
   // find the class the thinker belongs to
 
   int class =
-    thinker->function == P_RemoveThinkerDelayed ? th_delete :
+    thinker->function == P_RemoveThinkerDelayed ||
+    thinker->function == P_RemoveMobjDelayed ? th_delete :
     thinker->function == P_MobjThinker &&
     ((mobj_t *) thinker)->health > 0 &&
     (((mobj_t *) thinker)->flags & MF_COUNTKILL ||
@@ -121,6 +147,15 @@ void P_AddThinker(thinker_t* thinker)
   thinker->cnext = thinker->cprev = NULL;
   P_UpdateThinker(thinker);
   newthinkerpresent = true;
+
+  if (runningthinkers)
+    {
+      if (!firstnewthinker)
+        firstnewthinker = thinker;
+    }
+  else
+    if (thinkerarray && !thinkersdirty)
+      P_AppendThinker(thinker);
 }
 
 //
@@ -142,7 +177,7 @@ static thinker_t *currentthinker;
 // that the next step in P_RunThinkers() will get its successor.
 //
 
-void P_RemoveThinkerDelayed(thinker_t *thinker)
+static boolean P_UnlinkRemovedThinker(thinker_t *thinker)
 {
   if (!thinker->references)
     {
@@ -159,8 +194,23 @@ void P_RemoveThinkerDelayed(thinker_t *thinker)
         thinker_t *th = thinker->cnext;
         (th->cprev = thinker->cprev)->cnext = th;
       }
-      Z_Free(thinker);
+      thinkersdirty = true;
+      return true;
     }
+  return false;
+}
+
+void P_RemoveThinkerDelayed(thinker_t *thinker)
+{
+  if (P_UnlinkRemovedThinker(thinker))
+    Z_Free(thinker);
+}
+
+// The same for mobjs, which go back to their pool (see P_AllocMobj)
+void P_RemoveMobjDelayed(thinker_t *thinker)
+{
+  if (P_UnlinkRemovedThinker(thinker))
+    P_FreeMobj((mobj_t *) thinker);
 }
 
 //
@@ -179,7 +229,9 @@ void P_RemoveThinkerDelayed(thinker_t *thinker)
 void P_RemoveThinker(thinker_t *thinker)
 {
   R_StopInterpolationIfNeeded(thinker);
-  thinker->function = P_RemoveThinkerDelayed;
+  thinker->function = thinker->function == P_MobjThinker ||
+    thinker->function == P_RemoveMobjDelayed ?
+    P_RemoveMobjDelayed : P_RemoveThinkerDelayed;
 
   P_UpdateThinker(thinker);
 }
@@ -238,20 +290,190 @@ void P_SetTarget(mobj_t **mop, mobj_t *targ)
 // external and using P_RemoveThinkerDelayed() implicitly.
 //
 
-static void P_RunThinkers (void)
+static void P_ProfileThinker(thinker_t *th);
+
+static void P_RunThinker(thinker_t *th)
+{
+  if (newthinkerpresent)
+    R_ActivateThinkerInterpolations(th);
+  if (thinkerprofile)
+    P_ProfileThinker(th);
+  else if (th->function)
+    th->function(th);
+}
+
+static void P_RunThinkerList(thinker_t *first)
 {
-  for (currentthinker = thinkercap.next;
+  for (currentthinker = first;
        currentthinker != &thinkercap;
        currentthinker = currentthinker->next)
-  {
-    if (newthinkerpresent)
-      R_ActivateThinkerInterpolations(currentthinker);
-    if (currentthinker->function)
-      currentthinker->function(currentthinker);
-  }
+    P_RunThinker(currentthinker);
+}
+
+static void P_RunThinkerArray(void)
+{
+  int i;
+
+  if (thinkersdirty)
+    {
+      thinker_t *th;
+
+      numthinkers = 0;
+      for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        P_AppendThinker(th);
+      thinkersdirty = false;
+    }
+
+  // Only a thinker's own turn can free it, so the entries after the
+  // current one stay valid even if the list changes
+  runningthinkers = true;
+  firstnewthinker = NULL;
+  for (i = 0; i < numthinkers; i++)
+    {
+#ifdef __GNUC__
+      if (i+4 < numthinkers)
+        __builtin_prefetch(thinkers[i+4]);
+#endif
+      P_RunThinker(currentthinker = thinkers[i]);
+    }
+
+  if (firstnewthinker)
+    {
+      P_RunThinkerList(firstnewthinker);
+
+      // keep the array unless something was freed along the way
+      if (!thinkersdirty)
+        {
+          thinker_t *th;
+
+          for (th = firstnewthinker; th != &thinkercap; th = th->next)
+            P_AppendThinker(th);
+        }
+    }
+  runningthinkers = false;
+}
+
+static void P_RunThinkers (void)
+{
+  if (thinkerarray)
+    P_RunThinkerArray();
+  else
+    P_RunThinkerList(thinkercap.next);
   newthinkerpresent = false;
 }
 
+//
+// Thinker profiling
+//
+// With -thinkerprofile every thinker call is timed and charged to its
+// function, and mobj thinkers to their type as well. The totals go in
+// the -benchmark report and the rendering stats.
+//
+
+boolean thinkerprofile;
+
+static const think_t thinkerfuncs[NUMTHINKERSTATS-1] = {
+  P_MobjThinker, T_MoveFloor, T_MoveCeiling, T_VerticalDoor, T_PlatRaise,
+  T_MoveElevator, T_LightFlash, T_StrobeFlash, T_FireFlicker, T_Glow,
+  T_Scroll, T_Friction, T_Pusher, P_RemoveThinkerDelayed, P_RemoveMobjDelayed
+};
+
+static thinkerstat_t thinkerstats[NUMTHINKERSTATS] = {
+  {"P_MobjThinker"}, {"T_MoveFloor"}, {"T_MoveCeiling"}, {"T_VerticalDoor"},
+  {"T_PlatRaise"}, {"T_MoveElevator"}, {"T_LightFlash"}, {"T_StrobeFlash"},
+  {"T_FireFlicker"}, {"T_Glow"}, {"T_Scroll"}, {"T_Friction"}, {"T_Pusher"},
+  {"P_RemoveThinkerDelayed"}, {"P_RemoveMobjDelayed"}, {"other"}
+};
+
+static thinkerstat_t mobjstats[NUMMOBJTYPES];
+
+static void P_ProfileThinker(thinker_t *th)
+{
+  think_t function = th->function;
+  thinkerstat_t *stat = &thinkerstats[NUMTHINKERSTATS-1];
+  thinkerstat_t *mstat = NULL;
+  int_64_t start, time;
+  int i;
+
+  if (!function)
+    return;
+
+  for (i = 0; i < NUMTHINKERSTATS-1; i++)
+    if (thinkerfuncs[i] == function)
+      {
+        stat = &thinkerstats[i];
+        break;
+      }
+  // the thinker may be freed by the call, look at it first
+  if (function == P_MobjThinker)
+    mstat = &mobjstats[((mobj_t *)th)->type];
+
+  start = I_GetProfileTime();
+  function(th);
+  time = I_GetProfileTime() - start;
+
+  stat->calls++;
+  stat->time += time;
+  if (mstat)
+    {
+      mstat->calls++;
+      mstat->time += time;
+    }
+}
+
+void P_ResetThinkerStats(void)
+{
+  int i;
+
+  for (i = 0; i < NUMTHINKERSTATS; i++)
+    thinkerstats[i].calls = 0, thinkerstats[i].time = 0;
+  memset(mobjstats, 0, sizeof(mobjstats));
+}
+
+const thinkerstat_t *P_GetThinkerStats(void)
+{
+  return thinkerstats;
+}
+
+const thinkerstat_t *P_GetMobjThinkerStats(void)
+{
+  return mobjstats;
+}
+
+//
+// P_ThinkerProfileSummary
+// One line for the rendering stats: thinker time per tic since the
+// last call, and the function that used most of it
+//
+const char *P_ThinkerProfileSummary(void)
+{
+  static char buf[80];
+  static int_64_t lasttime[NUMTHINKERSTATS];
+  static int lasttic;
+  int_64_t total = 0, top = 0;
+  int i, topi = 0, tics = leveltime - lasttic;
+
+  if (!thinkerprofile)
+    return "";
+
+  for (i = 0; i < NUMTHINKERSTATS; i++)
+    {
+      int_64_t time = thinkerstats[i].time - lasttime[i];
+
+      total += time;
+      if (time > top)
+        top = time, topi = i;
+      lasttime[i] = thinkerstats[i].time;
+    }
+  lasttic = leveltime;
+
+  if (tics <= 0 || !total)
+    return "\nThinkers idle";
+  snprintf(buf, sizeof(buf), "\nThinkers %.2fms/tic, %s %d%%",
+           total / 1e6 / tics, thinkerstats[topi].name, (int)(top * 100 / total));
+  return buf;
+}
+
 //
 // P_Ticker
 //
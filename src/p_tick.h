@@ -48,6 +48,7 @@ void P_InitThinkers(void);
 void P_AddThinker(thinker_t *thinker);
 void P_RemoveThinker(thinker_t *thinker);
 void P_RemoveThinkerDelayed(thinker_t *thinker);    // killough 4/25/98
+void P_RemoveMobjDelayed(thinker_t *thinker);
 
 void P_UpdateThinker(thinker_t *thinker);   // killough 8/29/98
 
@@ -72,4 +73,26 @@ extern thinker_t thinkerclasscap[];
 /* cph 2002/01/13 - iterator for thinker lists */
 thinker_t* P_NextThinker(thinker_t*,th_class);
 
+/* Run thinkers from a flat array instead of walking the list */
+extern boolean thinkerarray;
+
+/* Per-function and per-mobj-type thinker timing (-thinkerprofile).
+ * Function stats are in the order of the thinker functions listed in
+ * p_tick.c, with anything else counted under "other"; mobj stats are
+ * indexed by mobjtype_t and have no name. */
+typedef struct {
+  const char *name;
+  unsigned int calls;
+  int_64_t time;        // nanoseconds
+} thinkerstat_t;
+
+#define NUMTHINKERSTATS 16
+
+extern boolean thinkerprofile;
+
+void P_ResetThinkerStats(void);
+const thinkerstat_t *P_GetThinkerStats(void);
+const thinkerstat_t *P_GetMobjThinkerStats(void);
+const char *P_ThinkerProfileSummary(void);
+
 #endif
@@ -41,6 +41,7 @@
 #include "p_user.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#include "p_checksum.h"
 
 // Index of the special effects (INVUL inverse) map.
 
@@ -311,6 +312,9 @@ void P_PlayerThink (player_t* player)
   ticcmd_t*    cmd;
   weapontype_t newweapon;
 
+  // players turn, and their powers change their flags, without moving
+  P_ChecksumMobj(player->mo);
+
   if (movement_smooth && players && &players[displayplayer] == player)
   {
     original_view_vars.viewx = player->mo->x;
@@ -40,6 +40,7 @@
 #include "r_bsp.h" // cph - sanity checking
 #include "v_video.h"
 #include "lprintf.h"
+#include "m_bench.h"
 
 seg_t     *curline;
 side_t    *sidedef;
@@ -88,7 +89,9 @@ static void R_ClipWallSegment(int first, int last, boolean solid)
       int to;
       if (!(p = memchr(solidcol+first, 1, last-first))) to = last;
       else to = p - solidcol;
+      M_BenchBegin(bench_segs);
       R_StoreWallRange(first, to-1);
+      M_BenchEnd(bench_segs);
       if (solid) {
   memset(solidcol+first,1,to-first);
       }
@@ -649,10 +649,73 @@ int PUREFUNC R_SafeTextureNumForName(const char *name, int snum)
 // Totally rewritten by Lee Killough to use less memory,
 // to avoid using alloca(), and to improve performance.
 // cph - new wad lump handling, calls cache functions but acquires no locks
+// Lumps are now read in the background, so the level starts right away.
 
 static inline void precache_lump(int l)
 {
-  W_CacheLumpNum(l); W_UnlockLumpNum(l);
+  W_PrefetchLumpNum(l);
+}
+
+//
+// R_PinLevelLumps
+// Keeps the flats and the sky of the new level in the lump cache until
+// the next level is set up, so they are never read back in mid-frame.
+//
+
+void R_PinLevelLumps(void)
+{
+  register int i;
+  byte *hitlist;
+
+  if (!lumpcache_pin)
+    return;
+
+  hitlist = calloc(numflats, 1);
+
+  for (i = numsectors; --i >= 0; )
+    hitlist[sectors[i].floorpic] = hitlist[sectors[i].ceilingpic] = 1;
+
+  for (i = numflats; --i >= 0; )
+    if (hitlist[i] && i != skyflatnum)  // F_SKY1 is never drawn
+      W_PinLumpNum(firstflat + i);
+
+  for (i = textures[skytexture]->patchcount; --i >= 0; )
+    W_PinLumpNum(textures[skytexture]->patches[i].patch);
+
+  free(hitlist);
+}
+
+//
+// R_StoreLevelTextures
+// Builds the composites of the new level's wall textures while it is set
+// up, rather than the first time each one is seen. Only worth it when
+// they go in the texture store, where they aren't purged.
+//
+
+void R_StoreLevelTextures(void)
+{
+  register int i;
+  byte *hitlist;
+
+  if (!texture_store_kb)
+    return;
+
+  hitlist = calloc(numtextures, 1);
+
+  for (i = numsides; --i >= 0;)
+    hitlist[sides[i].bottomtexture] =
+      hitlist[sides[i].toptexture] =
+      hitlist[sides[i].midtexture] = 1;
+  hitlist[skytexture] = 1;
+
+  for (i = numtextures; --i >= 0; )
+    if (hitlist[i])
+      {
+        R_CacheTextureCompositePatchNum(i);
+        R_UnlockTextureCompositePatchNum(i);
+      }
+
+  free(hitlist);
 }
 
 void R_PrecacheLevel(void)
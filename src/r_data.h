@@ -80,6 +80,8 @@ const byte *R_GetTextureColumn(const rpatch_t *texpatch, int col);
 // I/O, setting up the stuff.
 void R_InitData (void);
 void R_PrecacheLevel (void);
+void R_PinLevelLumps (void);
+void R_StoreLevelTextures (void);
 
 
 // Retrieval.
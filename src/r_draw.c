@@ -43,6 +43,7 @@
 #include "g_game.h"
 #include "am_map.h"
 #include "lprintf.h"
+#include "r_patch.h"
 
 //
 // All drawing to the view buffer is accomplished in this file.
@@ -85,17 +86,19 @@ typedef enum
    COL_FLEXADD
 } columntype_e;
 
-static int    temp_x = 0;
-static int    tempyl[4], tempyh[4];
-static byte           byte_tempbuf[MAX_SCREENHEIGHT * 4];
-static unsigned short short_tempbuf[MAX_SCREENHEIGHT * 4];
-static unsigned int   int_tempbuf[MAX_SCREENHEIGHT * 4];
-static int    startx = 0;
-static int    temptype = COL_NONE;
-static int    commontop, commonbot;
-static const byte *temptranmap = NULL;
+// The column buffer is per thread, since wall and sky columns can be
+// drawn by the render threads (see R_DrawQueuedSlab).
+static THREADLOCAL int    temp_x = 0;
+static THREADLOCAL int    tempyl[4], tempyh[4];
+static THREADLOCAL byte           byte_tempbuf[MAX_SCREENHEIGHT * 4];
+static THREADLOCAL unsigned short short_tempbuf[MAX_SCREENHEIGHT * 4];
+static THREADLOCAL unsigned int   int_tempbuf[MAX_SCREENHEIGHT * 4];
+static THREADLOCAL int    startx = 0;
+static THREADLOCAL int    temptype = COL_NONE;
+static THREADLOCAL int    commontop, commonbot;
+static THREADLOCAL const byte *temptranmap = NULL;
 // SoM 7-28-04: Fix the fuzz problem.
-static const byte   *tempfuzzmap;
+static THREADLOCAL const byte   *tempfuzzmap;
 
 //
 // Spectre/Invisibility.
@@ -173,9 +176,9 @@ static void R_QuadFlushError(void)
    I_Error("R_FlushQuadColumn called without being initialized.\n");
 }
 
-static void (*R_FlushWholeColumns)(void) = R_FlushWholeError;
-static void (*R_FlushHTColumns)(void)    = R_FlushHTError;
-static void (*R_FlushQuadColumn)(void) = R_QuadFlushError;
+static THREADLOCAL void (*R_FlushWholeColumns)(void) = R_FlushWholeError;
+static THREADLOCAL void (*R_FlushHTColumns)(void)    = R_FlushHTError;
+static THREADLOCAL void (*R_FlushQuadColumn)(void) = R_QuadFlushError;
 
 static void R_FlushColumns(void)
 {
@@ -980,8 +983,208 @@ R_DrawSpan_f R_GetDrawSpanFunc(enum draw_filter_type_e filter,
   return result;
 }
 
+//
+// Deferred drawing for the render threads
+//
+// While a queue is active, wall and sky columns and flat spans are not
+// drawn but recorded for the slab of the view they fall into. Spans
+// crossing a slab boundary are split, with the texture coordinates
+// advanced the same way R_DrawSpan* would step them, so each slab
+// comes out exactly as if it had been drawn in one pass.
+//
+
+typedef struct {
+  R_DrawColumn_f colfunc;   // NULL for spans
+  R_DrawSpan_f spanfunc;
+  union {
+    draw_column_vars_t dcvars;
+    draw_span_vars_t dsvars;
+  } v;
+} queuedraw_t;
+
+typedef struct {
+  queuedraw_t *items;
+  int numitems, maxitems;
+} drawqueue_t;
+
+// resources that have to stay in memory until the queue has been drawn
+typedef struct {
+  int num;
+  boolean texture;          // composite texture, else a lump
+} queuehold_t;
+
+static drawqueue_t drawqueues[MAX_RENDER_SLABS];
+static int queueslabs;      // 0 = draw immediately
+static int queueslabx[MAX_RENDER_SLABS+1];
+static byte queueslabof[MAX_SCREENWIDTH];
+
+static queuehold_t *queueholds;
+static int numqueueholds, maxqueueholds;
+
+static queuedraw_t *R_NewQueueItem(int slab)
+{
+  drawqueue_t *q = &drawqueues[slab];
+
+  if (q->numitems == q->maxitems)
+    {
+      q->maxitems = q->maxitems ? q->maxitems*2 : 256;
+      q->items = realloc(q->items, q->maxitems*sizeof(*q->items));
+    }
+  return &q->items[q->numitems++];
+}
+
+static void R_QueueHold(int num, boolean texture)
+{
+  if (numqueueholds == maxqueueholds)
+    {
+      maxqueueholds = maxqueueholds ? maxqueueholds*2 : 64;
+      queueholds = realloc(queueholds, maxqueueholds*sizeof(*queueholds));
+    }
+  queueholds[numqueueholds].num = num;
+  queueholds[numqueueholds++].texture = texture;
+}
+
+void R_BeginDrawQueue(int numslabs)
+{
+  int i, x;
+
+  if (numslabs > MAX_RENDER_SLABS)
+    numslabs = MAX_RENDER_SLABS;
+
+  for (i = 0; i <= numslabs; i++)
+    queueslabx[i] = viewwidth*i/numslabs;
+  for (i = 0; i < numslabs; i++)
+    {
+      for (x = queueslabx[i]; x < queueslabx[i+1]; x++)
+        queueslabof[x] = i;
+      drawqueues[i].numitems = 0;
+    }
+  queueslabs = numslabs;
+}
+
+boolean R_DrawQueueActive(void)
+{
+  return queueslabs != 0;
+}
+
+void R_QueueColumn(R_DrawColumn_f colfunc, draw_column_vars_t *dcvars)
+{
+  queuedraw_t *item;
+
+  if (!queueslabs)
+    {
+      colfunc(dcvars);
+      return;
+    }
+
+  item = R_NewQueueItem(queueslabof[dcvars->x]);
+  item->colfunc = colfunc;
+  item->v.dcvars = *dcvars;
+}
+
+static void R_QueueSpan(R_DrawSpan_f spanfunc, const draw_span_vars_t *dsvars)
+{
+  int slab = queueslabof[dsvars->x1];
+  int x1 = dsvars->x1;
+
+  for (;;)
+    {
+      queuedraw_t *item = R_NewQueueItem(slab);
+      unsigned skip = x1 - dsvars->x1;
+
+      item->colfunc = NULL;
+      item->spanfunc = spanfunc;
+      item->v.dsvars = *dsvars;
+      item->v.dsvars.x1 = x1;
+      // unsigned, so this wraps exactly like skip additions of the step
+      item->v.dsvars.xfrac = (fixed_t)((unsigned)dsvars->xfrac + skip*(unsigned)dsvars->xstep);
+      item->v.dsvars.yfrac = (fixed_t)((unsigned)dsvars->yfrac + skip*(unsigned)dsvars->ystep);
+
+      if (dsvars->x2 < queueslabx[slab+1])
+        break;
+      item->v.dsvars.x2 = queueslabx[slab+1]-1;
+      x1 = queueslabx[++slab];
+    }
+}
+
+void R_QueueHoldTexture(int texture)
+{
+  if (queueslabs)
+    {
+      R_CacheTextureCompositePatchNum(texture);
+      R_QueueHold(texture, true);
+    }
+}
+
+void R_QueueHoldLump(int lump)
+{
+  if (queueslabs)
+    {
+      W_LockLumpNum(lump);
+      R_QueueHold(lump, false);
+    }
+}
+
+//
+// R_DrawQueuedSlab
+// Safe to call from any thread: it only reads the queue and writes to
+// the slab's own columns of the screen.
+//
+void R_DrawQueuedSlab(int slab)
+{
+  const drawqueue_t *q = &drawqueues[slab];
+  int i;
+
+  for (i = 0; i < q->numitems; i++)
+    {
+      queuedraw_t *item = &q->items[i];
+
+      if (item->colfunc)
+        item->colfunc(&item->v.dcvars);
+      else
+        item->spanfunc(&item->v.dsvars);
+    }
+  R_ResetColumnBuffer();
+}
+
+void R_EndDrawQueue(void)
+{
+  int i;
+
+  for (i = 0; i < numqueueholds; i++)
+    if (queueholds[i].texture)
+      R_UnlockTextureCompositePatchNum(queueholds[i].num);
+    else
+      W_UnlockLumpNum(queueholds[i].num);
+
+  numqueueholds = 0;
+  queueslabs = 0;
+}
+
 void R_DrawSpan(draw_span_vars_t *dsvars) {
-  R_GetDrawSpanFunc(drawvars.filterfloor, drawvars.filterz)(dsvars);
+  R_DrawSpan_f spanfunc = R_GetDrawSpanFunc(drawvars.filterfloor, drawvars.filterz);
+
+  if (queueslabs)
+    R_QueueSpan(spanfunc, dsvars);
+  else
+    spanfunc(dsvars);
+}
+
+//
+// R_SetDrawScreen
+// Which of the top screens the view is drawn into, the right one is
+// only used for the other eye in stereo
+//
+void R_SetDrawScreen(int scrn)
+{
+  const screeninfo_t *scr = &screens[scrn];
+
+  drawvars.byte_topleft = scr->data + viewwindowy*scr->byte_pitch + viewwindowx;
+  drawvars.short_topleft = (unsigned short *)(scr->data) + viewwindowy*scr->short_pitch + viewwindowx;
+  drawvars.int_topleft = (unsigned int *)(scr->data) + viewwindowy*scr->int_pitch + viewwindowx;
+  drawvars.byte_pitch = scr->byte_pitch;
+  drawvars.short_pitch = scr->short_pitch;
+  drawvars.int_pitch = scr->int_pitch;
 }
 
 //
@@ -1005,14 +1208,7 @@ void R_InitBuffer(int width, int height)
 
   viewwindowy = width==SCREENWIDTH ? 0 : (SCREENHEIGHT-(ST_SCALED_HEIGHT-1)-height)>>1;
 
-  // TODO: update for both sides of top screen
-
-  drawvars.byte_topleft = screens[SCR_FRONT_L].data + viewwindowy*screens[SCR_FRONT_L].byte_pitch + viewwindowx;
-  drawvars.short_topleft = (unsigned short *)(screens[SCR_FRONT_L].data) + viewwindowy*screens[SCR_FRONT_L].short_pitch + viewwindowx;
-  drawvars.int_topleft = (unsigned int *)(screens[SCR_FRONT_L].data) + viewwindowy*screens[SCR_FRONT_L].int_pitch + viewwindowx;
-  drawvars.byte_pitch = screens[SCR_FRONT_L].byte_pitch;
-  drawvars.short_pitch = screens[SCR_FRONT_L].short_pitch;
-  drawvars.int_pitch = screens[SCR_FRONT_L].int_pitch;
+  R_SetDrawScreen(SCR_FRONT_L);
 
   if (V_GetMode() == VID_MODE8) {
     for (i=0; i<FUZZTABLE; i++)
@@ -145,6 +145,7 @@ R_DrawSpan_f R_GetDrawSpanFunc(enum draw_filter_type_e filter,
 void R_DrawSpan(draw_span_vars_t *dsvars);
 
 void R_InitBuffer(int width, int height);
+void R_SetDrawScreen(int scrn);
 
 // Initialize color translation tables, for player rendering etc.
 void R_InitTranslationTables(void);
@@ -160,4 +161,20 @@ void R_DrawViewBorder(void);
 // column drawing.
 void R_ResetColumnBuffer(void);
 
+// Threaded rendering: while a draw queue is active, wall and sky columns
+// and flat spans are recorded per vertical slab of the view instead of
+// being drawn. Each slab is then drawn by R_DrawQueuedSlab, possibly on
+// another thread. Textures and flats used by queued columns must be held
+// until R_EndDrawQueue.
+#define MAX_RENDER_SLABS 4
+
+void R_BeginDrawQueue(int numslabs);
+boolean R_DrawQueueActive(void);
+// Draws straight away when no queue is active.
+void R_QueueColumn(R_DrawColumn_f colfunc, draw_column_vars_t *dcvars);
+void R_QueueHoldTexture(int texture);
+void R_QueueHoldLump(int lump);
+void R_DrawQueuedSlab(int slab);
+void R_EndDrawQueue(void);
+
 #endif
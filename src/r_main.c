@@ -55,9 +55,13 @@
 #include "st_stuff.h"
 #include "i_main.h"
 #include "i_system.h"
+#include "i_thread.h"
 #include "g_game.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#include "p_map.h"
+#include "p_tick.h"
+#include "m_bench.h"
 
 // Fineangles in the SCREENWIDTH wide window.
 #define FIELDOFVIEW 2048
@@ -425,6 +429,105 @@ void R_ExecuteSetViewSize (void)
 
 }
 
+//
+// Render threads
+//
+// Walls and flats are queued during the BSP walk and drawn afterwards
+// in vertical slabs, one per thread; the main thread takes slab 0.
+// Sprites and other masked stuff are still drawn by the main thread
+// once all slabs are done.
+//
+
+int render_threads; // number of slabs, 1 = draw on the main thread only
+
+typedef struct {
+  i_thread_t *thread;
+  i_event_t *start, *done;
+  int slab;
+} renderworker_t;
+
+static renderworker_t renderworkers[MAX_RENDER_SLABS-1];
+static int numrenderworkers;
+static volatile boolean renderworkers_quit;
+
+static void R_RenderWorker(void *arg)
+{
+  renderworker_t *worker = arg;
+
+  for (;;)
+    {
+      I_WaitEvent(worker->start);
+      if (renderworkers_quit)
+        break;
+      R_DrawQueuedSlab(worker->slab);
+      I_SignalEvent(worker->done);
+    }
+}
+
+static void R_ShutdownRenderThreads(void)
+{
+  int i;
+
+  renderworkers_quit = true;
+  for (i = 0; i < numrenderworkers; i++)
+    {
+      I_SignalEvent(renderworkers[i].start);
+      I_JoinThread(renderworkers[i].thread);
+      I_DestroyEvent(renderworkers[i].start);
+      I_DestroyEvent(renderworkers[i].done);
+    }
+  numrenderworkers = 0;
+}
+
+static void R_InitRenderThreads(void)
+{
+  int cores = I_GetNumCores();
+  int slabs = MIN(render_threads, MAX_RENDER_SLABS);
+  int i;
+
+  for (i = 0; i < slabs-1; i++)
+    {
+      renderworker_t *worker = &renderworkers[numrenderworkers];
+      // highest cores first, core 0 is the main thread's
+      int core = cores-1-i;
+
+      worker->slab = numrenderworkers+1;
+      worker->start = I_CreateEvent();
+      worker->done = I_CreateEvent();
+      worker->thread = I_CreateThread(R_RenderWorker, worker, core > 0 ? core : -1);
+      if (!worker->thread)
+        {
+          I_DestroyEvent(worker->start);
+          I_DestroyEvent(worker->done);
+          break;
+        }
+      numrenderworkers++;
+    }
+
+  if (numrenderworkers)
+    {
+      lprintf(LO_INFO, "%d threads ", numrenderworkers+1);
+      atexit(R_ShutdownRenderThreads);
+    }
+}
+
+//
+// R_DrawSlabs
+// Draws everything queued since R_BeginDrawQueue.
+//
+static void R_DrawSlabs(void)
+{
+  int i;
+
+  for (i = 0; i < numrenderworkers; i++)
+    I_SignalEvent(renderworkers[i].start);
+  R_DrawQueuedSlab(0);
+  for (i = 0; i < numrenderworkers; i++)
+    I_WaitEvent(renderworkers[i].done);
+
+  R_EndDrawQueue();
+}
+
 //
 // R_Init
 //
@@ -451,6 +554,8 @@ void R_Init (void)
   R_InitTranslationTables();
   lprintf(LO_INFO, "R_InitPatches ");
   R_InitPatches();
+  lprintf(LO_INFO, "R_InitRenderThreads ");
+  R_InitRenderThreads();
 }
 
 //
@@ -528,6 +633,47 @@ static void R_SetupFrame (player_t *player)
 
 int autodetect_hom = 0;       // killough 2/7/98: HOM autodetection flag
 
+//
+// Stereo rendering
+//
+// Each eye is a full view of its own: the BSP walk, clipping, planes and
+// sprites all depend on where the eye is.
+//
+
+int stereo_separation;          // distance between the eyes, 0 = mono
+int stereo_convergence;         // distance at which the eyes meet
+fixed_t stereo_depth = FRACUNIT; // scales the separation, e.g. 3DS 3D slider
+boolean stereo_frame;           // the right screen holds the other eye
+
+static stereostats_t stereostats;
+static byte *stereosnapshot;    // left view before the overlays
+static int stereosnapshotsize;
+
+//
+// R_StereoSummary
+// One line for the rendering stats: time the right eye takes next to
+// the left one, for the whole view and for the BSP walk alone
+//
+static const char *R_StereoSummary(void)
+{
+  static char buf[80];
+  static stereostats_t last;
+  stereostats_t d;
+
+  d.frames = stereostats.frames - last.frames;
+  d.eye[0] = stereostats.eye[0] - last.eye[0];
+  d.eye[1] = stereostats.eye[1] - last.eye[1];
+  d.bsp[0] = stereostats.bsp[0] - last.bsp[0];
+  d.bsp[1] = stereostats.bsp[1] - last.bsp[1];
+  last = stereostats;
+
+  if (!d.frames || !d.eye[0] || !d.bsp[0])
+    return "";
+  snprintf(buf, sizeof(buf), "\nStereo: right eye %d%% of left, BSP %d%%",
+           (int)(d.eye[1] * 100 / d.eye[0]), (int)(d.bsp[1] * 100 / d.bsp[0]));
+  return buf;
+}
+
 //
 // R_ShowStats
 //
@@ -543,11 +689,29 @@ static void R_ShowStats(void)
   FPS_FrameCount++;
   if(tick >= FPS_SavedTick + 1000)
   {
+    lumpcachestats_t lc;
+    sightcachestats_t sc;
+    texstorestats_t ts;
+
+    W_GetCacheStats(&lc);
+    P_GetSightCacheStats(&sc);
+    R_GetTextureStoreStats(&ts);
     doom_printf((V_GetMode() == VID_MODEGL)
                 ?"Frame rate %d fps\nWalls %d, Flats %d, Sprites %d"
-                :"Frame rate %d fps\nSegs %d, Visplanes %d, Sprites %d",
+                :"Frame rate %d fps\nSegs %d, Visplanes %d, Sprites %d, "
+                 "sorted in %.1fus\n"
+                 "Flat batches %d, unsorted %d\n"
+                 "Lumps %uk, misses %u, evicted %u\n"
+                 "Prefetch %d queued, %u stalls\n"
+                 "Sight cache %u hits, %u misses\n"
+                 "Textures %u reused, %u built in %dms%s%s",
     1000 * FPS_FrameCount / (tick - FPS_SavedTick), rendered_segs,
-    rendered_visplanes, rendered_vissprites);
+    rendered_visplanes, rendered_vissprites, rendered_spritesort / 1e3,
+    rendered_flatbatches, rendered_flatswitches,
+    (unsigned)(lc.bytes >> 10), lc.misses, lc.evictions + lc.purges,
+    lc.prefetch_queued, lc.prefetch_stalls, sc.hits, sc.misses,
+    ts.hits, ts.misses, (int)(ts.buildtime / 1000000),
+    P_ThinkerProfileSummary(), R_StereoSummary());
     FPS_SavedTick = tick;
     FPS_FrameCount = 0;
   }
@@ -558,11 +722,29 @@ static void R_ShowStats(void)
   int now = I_GetTime();
 
   if (now - showtime > 35) {
+    lumpcachestats_t lc;
+    sightcachestats_t sc;
+    texstorestats_t ts;
+
+    W_GetCacheStats(&lc);
+    P_GetSightCacheStats(&sc);
+    R_GetTextureStoreStats(&ts);
     doom_printf((V_GetMode() == VID_MODEGL)
                 ?"Frame rate %d fps\nWalls %d, Flats %d, Sprites %d"
-                :"Frame rate %d fps\nSegs %d, Visplanes %d, Sprites %d",
+                :"Frame rate %d fps\nSegs %d, Visplanes %d, Sprites %d, "
+                 "sorted in %.1fus\n"
+                 "Flat batches %d, unsorted %d\n"
+                 "Lumps %uk, misses %u, evicted %u\n"
+                 "Prefetch %d queued, %u stalls\n"
+                 "Sight cache %u hits, %u misses\n"
+                 "Textures %u reused, %u built in %dms%s%s",
     (35*KEEPTIMES)/(now - keeptime[0]), rendered_segs,
-    rendered_visplanes, rendered_vissprites);
+    rendered_visplanes, rendered_vissprites, rendered_spritesort / 1e3,
+    rendered_flatbatches, rendered_flatswitches,
+    (unsigned)(lc.bytes >> 10), lc.misses, lc.evictions + lc.purges,
+    lc.prefetch_queued, lc.prefetch_stalls, sc.hits, sc.misses,
+    ts.hits, ts.misses, (int)(ts.buildtime / 1000000),
+    P_ThinkerProfileSummary(), R_StereoSummary());
     showtime = now;
   }
   memmove(keeptime, keeptime+1, sizeof(keeptime[0]) * (KEEPTIMES-1));
@@ -573,10 +755,17 @@ static void R_ShowStats(void)
 
 //
 // R_RenderView
+// Walks the BSP (or, for the second eye in stereo, what the first eye's
+// walk recorded for it) and draws the view into the current draw screen
 //
-void R_RenderPlayerView (player_t* player)
+static void R_RenderView(int eye)
 {
-  R_SetupFrame (player);
+  // Spans are split at slab edges, which filters that depend on where
+  // a span starts would notice (see R_QueueSpan)
+  boolean threaded = numrenderworkers && V_GetMode() != VID_MODEGL &&
+    drawvars.filterfloor != RDRAW_FILTER_LINEAR &&
+    drawvars.filterz == RDRAW_FILTER_POINT;
+  int_64_t start = 0;
 
   // Clear buffers.
   R_ClearClipSegs ();
@@ -584,6 +773,153 @@ void R_RenderPlayerView (player_t* player)
   R_ClearPlanes ();
   R_ClearSprites ();
 
+  if (threaded)
+    R_BeginDrawQueue(numrenderworkers+1);
+
+  if (eye >= 0)
+    start = I_GetProfileTime();
+
+  // The head node is the last node output.
+  M_BenchBegin(bench_bsp);
+  R_RenderBSPNode (numnodes-1);
+  R_ResetColumnBuffer();
+  M_BenchEnd(bench_bsp);
+
+  if (eye >= 0)
+    stereostats.bsp[eye] += I_GetProfileTime() - start;
+
+  // Check for new console commands.
+#ifdef HAVE_NET
+  NetUpdate ();
+#endif
+
+  M_BenchBegin(bench_planes);
+  if (V_GetMode() != VID_MODEGL)
+    R_DrawPlanes ();
+
+  if (threaded)
+    R_DrawSlabs ();
+  M_BenchEnd(bench_planes);
+
+  // Check for new console commands.
+#ifdef HAVE_NET
+  NetUpdate ();
+#endif
+
+  M_BenchBegin(bench_masked);
+  if (V_GetMode() != VID_MODEGL) {
+    R_DrawMasked ();
+    R_ResetColumnBuffer();
+  }
+  M_BenchEnd(bench_masked);
+
+  if (eye >= 0)
+    stereostats.eye[eye] += I_GetProfileTime() - start;
+}
+
+//
+// R_RenderStereoView
+// Both eyes, each toed in to meet at stereo_convergence units ahead
+//
+static void R_RenderStereoView(void)
+{
+  fixed_t x = viewx, y = viewy;
+  angle_t angle = viewangle;
+  fixed_t sep = stereo_separation * stereo_depth;
+  angle_t toein = R_PointToAngle2(0, 0, stereo_convergence << FRACBITS, sep/2);
+  const screeninfo_t *left = &screens[SCR_FRONT_L];
+  int depth = V_GetPixelDepth();
+  int eye, size = viewwidth * viewheight * depth;
+
+  for (eye = 0; eye < 2; eye++)
+    {
+      fixed_t offset = eye ? sep/2 : -sep/2;
+
+      viewx = x + FixedMul(offset, finesine[angle>>ANGLETOFINESHIFT]);
+      viewy = y - FixedMul(offset, finecosine[angle>>ANGLETOFINESHIFT]);
+      viewangle = eye ? angle + toein : angle - toein;
+      viewsin = finesine[viewangle>>ANGLETOFINESHIFT];
+      viewcos = finecosine[viewangle>>ANGLETOFINESHIFT];
+      validcount++;
+
+      R_SetDrawScreen(eye ? SCR_FRONT_R : SCR_FRONT_L);
+      R_RenderView(eye);
+    }
+
+  viewx = x;
+  viewy = y;
+  viewangle = angle;
+  viewsin = finesine[viewangle>>ANGLETOFINESHIFT];
+  viewcos = finecosine[viewangle>>ANGLETOFINESHIFT];
+  R_SetDrawScreen(SCR_FRONT_L);
+  stereostats.frames++;
+
+  // keep the left view as drawn, see R_FinishStereoFrame
+  if (size != stereosnapshotsize)
+    stereosnapshot = realloc(stereosnapshot, stereosnapshotsize = size);
+  for (eye = 0; eye < viewheight; eye++)
+    memcpy(stereosnapshot + eye * viewwidth * depth,
+           left->data + (viewwindowy + eye) * left->byte_pitch + viewwindowx * depth,
+           viewwidth * depth);
+  stereo_frame = true;
+}
+
+//
+// R_FinishStereoFrame
+// The status bar, HUD and menus are only drawn into the left screen.
+// Copy them to the right one: everything outside the view window, and
+// the pixels inside it that changed since the left eye was drawn.
+//
+void R_FinishStereoFrame(void)
+{
+  const screeninfo_t *left = &screens[SCR_FRONT_L];
+  const screeninfo_t *right = &screens[SCR_FRONT_R];
+  int depth = V_GetPixelDepth();
+  int x0 = viewwindowx * depth, x1 = (viewwindowx + viewwidth) * depth;
+  int width = left->width * depth;
+  int x, y, i;
+
+  if (!stereo_frame)
+    return;
+
+  for (y = 0; y < left->height; y++)
+    {
+      const byte *src = left->data + y * left->byte_pitch;
+      byte *dest = right->data + y * right->byte_pitch;
+      const byte *view;
+
+      if (y < viewwindowy || y >= viewwindowy + viewheight)
+        {
+          memcpy(dest, src, width);
+          continue;
+        }
+
+      memcpy(dest, src, x0);
+      memcpy(dest + x1, src + x1, width - x1);
+      view = stereosnapshot + (y - viewwindowy) * (x1 - x0);
+      for (x = x0; x < x1; x += depth)
+        for (i = 0; i < depth; i++)
+          if (src[x+i] != view[x-x0+i])
+            {
+              memcpy(dest + x, src + x, depth);
+              break;
+            }
+    }
+}
+
+void R_GetStereoStats(stereostats_t *stats)
+{
+  *stats = stereostats;
+}
+
+//
+// R_RenderPlayerView
+//
+void R_RenderPlayerView (player_t* player)
+{
+  M_BenchFrame();
+  R_SetupFrame (player);
+
   rendered_segs = rendered_visplanes = 0;
   if (V_GetMode() == VID_MODEGL)
   {
@@ -608,27 +944,11 @@ void R_RenderPlayerView (player_t* player)
   NetUpdate ();
 #endif
 
-  // The head node is the last node output.
-  R_RenderBSPNode (numnodes-1);
-  R_ResetColumnBuffer();
-
-  // Check for new console commands.
-#ifdef HAVE_NET
-  NetUpdate ();
-#endif
-
-  if (V_GetMode() != VID_MODEGL)
-    R_DrawPlanes ();
-
-  // Check for new console commands.
-#ifdef HAVE_NET
-  NetUpdate ();
-#endif
-
-  if (V_GetMode() != VID_MODEGL) {
-    R_DrawMasked ();
-    R_ResetColumnBuffer();
-  }
+  if (stereo_separation && stereo_depth > 0 && V_GetMode() != VID_MODEGL &&
+      screens[SCR_FRONT_R].data)
+    R_RenderStereoView();
+  else
+    R_RenderView(-1);
 
   // Check for new console commands.
 #ifdef HAVE_NET
@@ -66,8 +66,32 @@ extern int      validcount;
 //
 
 extern int rendered_visplanes, rendered_segs, rendered_vissprites;
+extern int rendered_flatbatches, rendered_flatswitches;
+extern int rendered_spritesort;  // nanoseconds sorting vissprites
 extern boolean rendering_stats;
 
+// number of threads drawing walls and flats
+extern int render_threads;
+
+//
+// Stereo rendering into SCR_FRONT_L and SCR_FRONT_R
+//
+
+extern int stereo_separation;   // map units between the eyes, 0 = mono
+extern int stereo_convergence;  // map units to where the eyes meet
+extern fixed_t stereo_depth;    // separation scale, set by the platform
+extern boolean stereo_frame;    // the last view was drawn for both eyes
+
+typedef struct {
+  unsigned int frames;
+  int_64_t eye[2];              // time drawing each eye
+  int_64_t bsp[2];              // of that, the BSP walk
+} stereostats_t;
+
+// Copy the overlays drawn since R_RenderPlayerView to the right screen
+void R_FinishStereoFrame(void);
+void R_GetStereoStats(stereostats_t *stats);
+
 //
 // Lighting LUT.
 // Used for z-depth cuing per column/row,
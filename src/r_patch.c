@@ -40,7 +40,10 @@
 #include "r_draw.h"
 #include "lprintf.h"
 #include "r_patch.h"
+#include "md5.h"
 #include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
 
 // posts are runs of non masked source pixels
 typedef struct
@@ -75,6 +78,320 @@ static rpatch_t *patches = 0;
 
 static rpatch_t *texture_composites = 0;
 
+//---------------------------------------------------------------------------
+// Texture store
+//
+// Composites used to be purgeable, so they were rebuilt whenever the zone
+// ran short and again on every level. Up to texture_store_kb of them are
+// now kept for the whole run in chunks of cache aligned memory, found by
+// a hash of the texture definition, so identical definitions also share
+// one copy. With texture_cache set they are appended to texcache.dat as
+// they are built, and later runs read them back instead. The file is never
+// compacted, which is why it's off by default. The key covers each patch
+// lump's wad, position and size but not its contents: delete texcache.dat
+// after editing a wad in place.
+//---------------------------------------------------------------------------
+
+#define TEXSTORE_VERSION 1
+#define TEXSTORE_CHUNK   (256*1024)
+#define TEXSTORE_ALIGN   32             // cache line, as in z_zone.c
+#define TEXSTORE_HASH    512
+
+int texture_store_kb = 4096;            // memory for composites kept all run
+int texture_cache = 0;                  // keep composites in texcache.dat
+
+typedef struct
+{
+  char magic[8];                        // "PRBTEXC"
+  int version;
+} texcache_t;
+
+// an entry in texcache.dat, followed by the pixels, the number of posts in
+// each column and the posts
+typedef struct
+{
+  byte key[16];
+  int width, height;
+  int numposts;
+} texcacheentry_t;
+
+typedef struct
+{
+  byte key[16];
+  long fileofs;                         // in texcache.dat, -1 = not there
+  int texture;                          // a stored composite, -1 = none
+  int next;                             // hash chain
+} texstoreentry_t;
+
+static texstoreentry_t *storeentries;
+static int numstoreentries, maxstoreentries;
+static int storehash[TEXSTORE_HASH];
+
+static byte *storechunk;                // free end of the current chunk
+static size_t storeleft;
+static size_t storebytes;               // in all the chunks
+
+static FILE *texcachefp;
+static texstorestats_t storestats;
+
+static byte *R_StoreAlloc(size_t size)
+{
+  byte *p;
+
+  size = (size + TEXSTORE_ALIGN-1) & ~(size_t)(TEXSTORE_ALIGN-1);
+  if (size > storeleft)
+  {
+    size_t budget = (size_t)texture_store_kb << 10;
+    size_t chunk = TEXSTORE_CHUNK;
+
+    if (storebytes + size > budget)
+      return NULL;
+    if (chunk > budget - storebytes)
+      chunk = budget - storebytes;
+    if (chunk < size)
+      chunk = size;
+    p = Z_Malloc(chunk + TEXSTORE_ALIGN-1, PU_STATIC, 0);
+    storechunk = (byte *)(((uintptr_t)p + TEXSTORE_ALIGN-1) & ~(uintptr_t)(TEXSTORE_ALIGN-1));
+    storeleft = chunk;
+    storebytes += chunk;
+  }
+  p = storechunk;
+  storechunk += size;
+  storeleft -= size;
+  return p;
+}
+
+// Gives back the last block R_StoreAlloc handed out
+static void R_StoreFree(byte *p, size_t size)
+{
+  size = (size + TEXSTORE_ALIGN-1) & ~(size_t)(TEXSTORE_ALIGN-1);
+  if (p + size == storechunk)
+  {
+    storechunk = p;
+    storeleft += size;
+  }
+}
+
+// a composite's data goes in the store if there's room, else in the zone
+static void R_AllocComposite(rpatch_t *patch, int size)
+{
+  if ((patch->data = R_StoreAlloc(size)))
+    patch->stored = 1;
+  else
+  {
+    patch->stored = 0;
+    patch->data = (unsigned char*)Z_Malloc(size, PU_STATIC, (void **)&patch->data);
+  }
+}
+
+static void R_TextureKey(byte *key, const texture_t *texture)
+{
+  struct MD5Context md5;
+  int i, v[4];
+
+  v[0] = TEXSTORE_VERSION;
+  v[1] = texture->width;
+  v[2] = texture->height;
+  v[3] = texture->patchcount;
+  MD5Init(&md5);
+  MD5Update(&md5, (const md5byte *)v, sizeof v);
+  for (i = 0; i < texture->patchcount; i++)
+  {
+    const texpatch_t *texpatch = &texture->patches[i];
+    const lumpinfo_t *lump = &lumpinfo[texpatch->patch];
+
+    v[0] = texpatch->originx;
+    v[1] = texpatch->originy;
+    v[2] = lump->size;
+    v[3] = lump->position;
+    MD5Update(&md5, (const md5byte *)v, sizeof v);
+    MD5Update(&md5, (const md5byte *)lump->name, 8);
+    if (lump->wadfile && lump->wadfile->name)
+      MD5Update(&md5, (const md5byte *)lump->wadfile->name, strlen(lump->wadfile->name));
+  }
+  MD5Final(key, &md5);
+}
+
+static texstoreentry_t *R_FindStoreEntry(const byte *key)
+{
+  int h = (key[0] | key[1] << 8) & (TEXSTORE_HASH-1);
+  texstoreentry_t *entry;
+  int i;
+
+  for (i = storehash[h]; i >= 0; i = storeentries[i].next)
+    if (!memcmp(storeentries[i].key, key, 16))
+      return &storeentries[i];
+
+  if (numstoreentries >= maxstoreentries)
+    storeentries = realloc(storeentries, sizeof(*storeentries) *
+      (maxstoreentries = maxstoreentries ? maxstoreentries*2 : 256));
+  entry = &storeentries[numstoreentries];
+  memcpy(entry->key, key, 16);
+  entry->fileofs = -1;
+  entry->texture = -1;
+  entry->next = storehash[h];
+  storehash[h] = numstoreentries++;
+  return entry;
+}
+
+static long R_CachedCompositeSize(const texcacheentry_t *e)
+{
+  return ((e->width * e->height + 4) & ~3) + e->width * sizeof(int) +
+    e->numposts * sizeof(rpost_t);
+}
+
+//
+// R_OpenTextureCache
+// Indexes the entries in texcache.dat, or starts a new one if it's
+// missing, from an older version or cut short
+//
+static void R_OpenTextureCache(void)
+{
+  char name[PATH_MAX+1];
+  texcache_t h;
+  texcacheentry_t e;
+  long ofs, size;
+
+  sprintf(name, "%s/texcache.dat", I_DoomExeDir());
+  if ((texcachefp = fopen(name, "r+b")))
+  {
+    fseek(texcachefp, 0, SEEK_END);
+    size = ftell(texcachefp);
+    fseek(texcachefp, 0, SEEK_SET);
+
+    if (fread(&h, sizeof h, 1, texcachefp) == 1 &&
+        !memcmp(h.magic, "PRBTEXC", 8) && h.version == TEXSTORE_VERSION)
+    {
+      for (ofs = sizeof h; ofs < size; ofs += sizeof e + R_CachedCompositeSize(&e))
+      {
+        if (fread(&e, sizeof e, 1, texcachefp) != 1 ||
+            e.width <= 0 || e.height <= 0 || e.numposts < 0 ||
+            ofs + (long)sizeof e + R_CachedCompositeSize(&e) > size)
+          break;
+        R_FindStoreEntry(e.key)->fileofs = ofs;
+        fseek(texcachefp, R_CachedCompositeSize(&e), SEEK_CUR);
+      }
+      if (ofs == size)
+        return;
+      lprintf(LO_WARN, "R_OpenTextureCache: %s is damaged, starting over\n", name);
+    }
+    fclose(texcachefp);
+    numstoreentries = 0;
+    memset(storehash, -1, sizeof(storehash));
+  }
+
+  if (!(texcachefp = fopen(name, "w+b")))
+    return;
+  memset(&h, 0, sizeof h);
+  strcpy(h.magic, "PRBTEXC");
+  h.version = TEXSTORE_VERSION;
+  if (fwrite(&h, sizeof h, 1, texcachefp) != 1)
+  {
+    fclose(texcachefp);
+    texcachefp = NULL;
+  }
+}
+
+//
+// R_LoadCachedComposite
+// Reads a composite from texcache.dat. Its posts come out contiguous, the
+// ones merged away when it was built are not saved.
+//
+static boolean R_LoadCachedComposite(rpatch_t *patch, const texture_t *texture, long ofs)
+{
+  texcacheentry_t e;
+  int pixelDataSize, columnsDataSize, size;
+  int *numPostsInColumn;
+  int x, numPostsUsedSoFar;
+  boolean ok;
+
+  fseek(texcachefp, ofs, SEEK_SET);
+  if (fread(&e, sizeof e, 1, texcachefp) != 1 ||
+      e.width != texture->width || e.height != texture->height)
+    return false;
+
+  patch->width = texture->width;
+  patch->height = texture->height;
+  patch->widthmask = texture->widthmask;
+  patch->leftoffset = 0;
+  patch->topoffset = 0;
+  patch->isNotTileable = 0;
+
+  pixelDataSize = (e.width * e.height + 4) & ~3;
+  columnsDataSize = sizeof(rcolumn_t) * e.width;
+  size = pixelDataSize + columnsDataSize + e.numposts * sizeof(rpost_t);
+  R_AllocComposite(patch, size);
+  patch->pixels = patch->data;
+  patch->columns = (rcolumn_t*)((unsigned char*)patch->pixels + pixelDataSize);
+  patch->posts = (rpost_t*)((unsigned char*)patch->columns + columnsDataSize);
+
+  numPostsInColumn = (int*)malloc(sizeof(int) * e.width);
+  ok = fread(patch->pixels, pixelDataSize, 1, texcachefp) == 1 &&
+    fread(numPostsInColumn, sizeof(int), e.width, texcachefp) == (size_t)e.width &&
+    fread(patch->posts, sizeof(rpost_t), e.numposts, texcachefp) == (size_t)e.numposts;
+
+  numPostsUsedSoFar = 0;
+  for (x = 0; ok && x < e.width; x++) {
+    patch->columns[x].pixels = patch->pixels + x*patch->height;
+    patch->columns[x].numPosts = numPostsInColumn[x];
+    patch->columns[x].posts = patch->posts + numPostsUsedSoFar;
+    numPostsUsedSoFar += numPostsInColumn[x];
+  }
+  free(numPostsInColumn);
+
+  if (!ok || numPostsUsedSoFar != e.numposts)
+  {
+    if (patch->stored)
+      R_StoreFree(patch->data, size);
+    else
+      Z_Free(patch->data);
+    patch->data = NULL;
+    return false;
+  }
+  return true;
+}
+
+static void R_SaveCachedComposite(texstoreentry_t *entry, const rpatch_t *patch)
+{
+  texcacheentry_t e;
+  long ofs;
+  int x;
+
+  fseek(texcachefp, 0, SEEK_END);
+  ofs = ftell(texcachefp);
+
+  memcpy(e.key, entry->key, 16);
+  e.width = patch->width;
+  e.height = patch->height;
+  e.numposts = 0;
+  for (x = 0; x < patch->width; x++)
+    e.numposts += patch->columns[x].numPosts;
+
+  fwrite(&e, sizeof e, 1, texcachefp);
+  fwrite(patch->pixels, (patch->width * patch->height + 4) & ~3, 1, texcachefp);
+  for (x = 0; x < patch->width; x++)
+    fwrite(&patch->columns[x].numPosts, sizeof(int), 1, texcachefp);
+  for (x = 0; x < patch->width; x++)
+    fwrite(patch->columns[x].posts, sizeof(rpost_t), patch->columns[x].numPosts, texcachefp);
+
+  // left to stdio to flush; a run cut short only loses the last entries
+  if (ferror(texcachefp))
+  {
+    lprintf(LO_WARN, "R_SaveCachedComposite: unable to write texcache.dat\n");
+    fclose(texcachefp);
+    texcachefp = NULL;
+    return;
+  }
+  entry->fileofs = ofs;
+}
+
+void R_GetTextureStoreStats(texstorestats_t *stats)
+{
+  *stats = storestats;
+  stats->bytes = storebytes - storeleft;
+  stats->budget = (size_t)texture_store_kb << 10;
+}
+
 //---------------------------------------------------------------------------
 void R_InitPatches(void) {
   if (!patches)
@@ -89,6 +406,12 @@ void R_InitPatches(void) {
     // clear out new patches to signal they're uninitialized
     memset(texture_composites, 0, sizeof(rpatch_t)*numtextures);
   }
+  if (!storeentries)
+  {
+    memset(storehash, -1, sizeof(storehash));
+    if (texture_cache)
+      R_OpenTextureCache();
+  }
 }
 
 //---------------------------------------------------------------------------
@@ -106,8 +429,8 @@ void R_FlushAllPatches(void) {
   if (texture_composites)
   {
     for (i=0; i<numtextures; i++)
-      if (texture_composites[i].data)
-        free(texture_composites[i].data);
+      if (texture_composites[i].data && !texture_composites[i].stored)
+        Z_Free(texture_composites[i].data);
     free(texture_composites);
     texture_composites = NULL;
   }
@@ -462,7 +785,7 @@ static void createTextureCompositePatch(int id) {
 
   // allocate our data chunk
   dataSize = pixelDataSize + columnsDataSize + postsDataSize;
-  composite_patch->data = (unsigned char*)Z_Malloc(dataSize, PU_STATIC, (void **)&composite_patch->data);
+  R_AllocComposite(composite_patch, dataSize);
   memset(composite_patch->data, 0, dataSize);
 
   // set out pixel, column, and post pointers into our data array
@@ -665,6 +988,48 @@ static void createTextureCompositePatch(int id) {
   free(countsInColumn);
 }
 
+//---------------------------------------------------------------------------
+// Takes a composite from the store or texcache.dat if it's there, and
+// builds and keeps it there if not
+static void getTextureComposite(int id) {
+  rpatch_t *composite_patch = &texture_composites[id];
+  texstoreentry_t *entry = NULL;
+  int_64_t start;
+
+  if (texture_store_kb || texcachefp) {
+    byte key[16];
+
+    R_TextureKey(key, textures[id]);
+    entry = R_FindStoreEntry(key);
+    if (entry->texture >= 0 && texture_composites[entry->texture].stored) {
+      *composite_patch = texture_composites[entry->texture];
+      composite_patch->locks = 0;
+      storestats.hits++;
+      return;
+    }
+    if (entry->fileofs >= 0 && texcachefp &&
+        R_LoadCachedComposite(composite_patch, textures[id], entry->fileofs)) {
+      if (composite_patch->stored)
+        entry->texture = id;
+      storestats.hits++;
+      storestats.loaded++;
+      return;
+    }
+  }
+
+  start = I_GetProfileTime();
+  createTextureCompositePatch(id);
+  storestats.buildtime += I_GetProfileTime() - start;
+  storestats.misses++;
+
+  if (entry) {
+    if (composite_patch->stored)
+      entry->texture = id;
+    if (entry->fileofs < 0 && texcachefp)
+      R_SaveCachedComposite(entry, composite_patch);
+  }
+}
+
 //---------------------------------------------------------------------------
 const rpatch_t *R_CachePatchNum(int id) {
   const int locks = 1;
@@ -727,10 +1092,10 @@ const rpatch_t *R_CacheTextureCompositePatchNum(int id) {
 #endif
 
   if (!texture_composites[id].data)
-    createTextureCompositePatch(id);
+    getTextureComposite(id);
 
   /* cph - if wasn't locked but now is, tell z_zone to hold it */
-  if (!texture_composites[id].locks && locks) {
+  if (!texture_composites[id].locks && locks && !texture_composites[id].stored) {
     Z_ChangeTag(texture_composites[id].data,PU_STATIC);
 #ifdef TIMEDIAG
     texture_composites[id].locktic = gametic;
@@ -760,7 +1125,7 @@ void R_UnlockTextureCompositePatchNum(int id)
   /* cph - Note: must only tell z_zone to make purgeable if currently locked, 
    * else it might already have been purged
    */
-  if (unlocks && !texture_composites[id].locks)
+  if (unlocks && !texture_composites[id].locks && !texture_composites[id].stored)
     Z_ChangeTag(texture_composites[id].data, PU_CACHE);
 }
 
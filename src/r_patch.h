@@ -60,6 +60,7 @@ typedef struct {
   unsigned  widthmask;
     
   unsigned char isNotTileable;
+  unsigned char stored;  // in the texture store, never purged
   
   int leftoffset;
   int topoffset;
@@ -88,6 +89,20 @@ void R_UnlockPatchNum(int id);
 const rpatch_t *R_CacheTextureCompositePatchNum(int id);
 void R_UnlockTextureCompositePatchNum(int id);
 
+// Composite textures kept across levels, and in texcache.dat
+extern int texture_store_kb;
+extern int texture_cache;
+
+typedef struct {
+  unsigned int hits;     // composites taken from the store or texcache.dat
+  unsigned int misses;   // composites built from the patches
+  unsigned int loaded;   // of the hits, read from texcache.dat
+  int_64_t buildtime;    // spent building them
+  size_t bytes, budget;  // store memory used, texture_store_kb
+} texstorestats_t;
+
+void R_GetTextureStoreStats(texstorestats_t *stats);
+
 
 // Size query funcs
 int R_NumPatchWidth(int lump) ;
@@ -336,7 +336,7 @@ static void R_MakeSpans(int x, unsigned int t1, unsigned int b1,
 
 // New function, by Lee Killough
 
-static void R_DoDrawPlane(visplane_t *pl)
+static void R_DoDrawPlane(visplane_t *pl, const byte *flat)
 {
   register int x;
   draw_column_vars_t dcvars;
@@ -409,6 +409,7 @@ static void R_DoDrawPlane(visplane_t *pl)
       dcvars.iscale = FRACUNIT*200/viewheight;
 
       tex_patch = R_CacheTextureCompositePatchNum(texture);
+      R_QueueHoldTexture(texture);
 
   // killough 10/98: Use sky scrolling offset, and possibly flip picture
         for (x = pl->minx; (dcvars.x = x) <= pl->maxx; x++)
@@ -417,7 +418,7 @@ static void R_DoDrawPlane(visplane_t *pl)
               dcvars.source = R_GetTextureColumn(tex_patch, ((an + xtoviewangle[x])^flip) >> ANGLETOSKYSHIFT);
               dcvars.prevsource = R_GetTextureColumn(tex_patch, ((an + xtoviewangle[x-1])^flip) >> ANGLETOSKYSHIFT);
               dcvars.nextsource = R_GetTextureColumn(tex_patch, ((an + xtoviewangle[x+1])^flip) >> ANGLETOSKYSHIFT);
-              colfunc(&dcvars);
+              R_QueueColumn(colfunc, &dcvars);
             }
 
       R_UnlockTextureCompositePatchNum(texture);
@@ -427,7 +428,7 @@ static void R_DoDrawPlane(visplane_t *pl)
       int stop, light;
       draw_span_vars_t dsvars;
 
-      dsvars.source = W_CacheLumpNum(firstflat + flattranslation[pl->picnum]);
+      dsvars.source = flat;
 
       xoffs = pl->xoffs;  // killough 2/28/98: Add offsets
       yoffs = pl->yoffs;
@@ -447,12 +448,44 @@ static void R_DoDrawPlane(visplane_t *pl)
       for (x = pl->minx ; x <= stop ; x++)
          R_MakeSpans(x,pl->top[x-1],pl->bottom[x-1],
                      pl->top[x],pl->bottom[x], &dsvars);
-
-      W_UnlockLumpNum(firstflat + flattranslation[pl->picnum]);
     }
   }
 }
 
+//
+// Flat batching
+//
+// Visplanes never share a pixel, so they can be drawn in any order.
+// Drawing them sorted by flat keeps each flat locked and in the data
+// cache for the whole run of planes using it, and sorting by height
+// next lets R_MapPlane reuse its per row distance cache.
+//
+
+static visplane_t **sortedplanes;
+static int maxsortedplanes;
+
+int rendered_flatbatches, rendered_flatswitches;
+
+#define R_IsSkyPlane(pl) ((pl)->picnum == skyflatnum || (pl)->picnum & PL_SKYFLAT)
+
+static int R_PlaneFlat(const visplane_t *pl)
+{
+  return R_IsSkyPlane(pl) ? -1 : firstflat + flattranslation[pl->picnum];
+}
+
+static int R_ComparePlanes(const void *a, const void *b)
+{
+  const visplane_t *pa = *(const visplane_t *const *)a;
+  const visplane_t *pb = *(const visplane_t *const *)b;
+  int fa = R_PlaneFlat(pa), fb = R_PlaneFlat(pb);
+
+  if (fa != fb)
+    return fa < fb ? -1 : 1;
+  if (pa->height != pb->height)
+    return pa->height < pb->height ? -1 : 1;
+  return pa->lightlevel - pb->lightlevel;
+}
+
 //
 // RDrawPlanes
 // At the end of each frame.
@@ -461,8 +494,49 @@ static void R_DoDrawPlane(visplane_t *pl)
 void R_DrawPlanes (void)
 {
   visplane_t *pl;
-  int i;
+  int i, numplanes = 0, lastflat = -1;
+  const byte *flat = NULL;
+
+  rendered_flatbatches = rendered_flatswitches = 0;
+
   for (i=0;i<MAXVISPLANES;i++)
     for (pl=visplanes[i]; pl; pl=pl->next, rendered_visplanes++)
-      R_DoDrawPlane(pl);
+      if (pl->minx <= pl->maxx)
+        {
+          if (numplanes == maxsortedplanes)
+            {
+              maxsortedplanes = maxsortedplanes ? maxsortedplanes*2 : 128;
+              sortedplanes = realloc(sortedplanes, maxsortedplanes*sizeof(*sortedplanes));
+            }
+          sortedplanes[numplanes++] = pl;
+
+          // flat changes the unsorted order would have had, for the stats
+          if (!R_IsSkyPlane(pl))
+            {
+              if (R_PlaneFlat(pl) != lastflat)
+                rendered_flatswitches++;
+              lastflat = R_PlaneFlat(pl);
+            }
+        }
+
+  qsort(sortedplanes, numplanes, sizeof(*sortedplanes), R_ComparePlanes);
+
+  lastflat = -1;
+  for (i=0; i<numplanes; i++)
+    {
+      int flatnum = R_PlaneFlat(pl = sortedplanes[i]);
+
+      if (flatnum != -1 && flatnum != lastflat)
+        {
+          if (flat)
+            W_UnlockLumpNum(lastflat);
+          flat = W_CacheLumpNum(lastflat = flatnum);
+          R_QueueHoldLump(flatnum);
+          rendered_flatbatches++;
+        }
+      R_DoDrawPlane(pl, flat);
+    }
+
+  if (flat)
+    W_UnlockLumpNum(lastflat);
 }
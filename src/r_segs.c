@@ -262,15 +262,76 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
 #define HEIGHTUNIT (1<<HEIGHTBITS)
 static int didsolidcol; /* True if at least one column was marked solid */
 
+//
+// A wall texture with a power of two width wraps with just its mask, so
+// its columns are found straight from the composite's column-major
+// pixels. Other widths go through R_GetTextureColumn, which first wraps
+// negative columns by the whole width.
+//
+
+typedef struct {
+  const rpatch_t *patch;
+  const byte *pixels;           // NULL = use R_GetTextureColumn
+  int height;
+  unsigned mask;
+} walltexture_t;
+
+int_64_t wallcolumns[2];        // columns drawn direct and through rcolumn_t
+
+static void R_SetupWallTexture(walltexture_t *wt, int texnum)
+{
+  wt->patch = texnum ? R_CacheTextureCompositePatchNum(texnum) : NULL;
+  wt->pixels = NULL;
+  wt->height = 0;
+  wt->mask = 0;
+  if (wt->patch && wt->patch->width == (int)wt->patch->widthmask + 1)
+    {
+      wt->pixels = wt->patch->pixels;
+      wt->height = wt->patch->height;
+      wt->mask = wt->patch->widthmask;
+    }
+}
+
+static inline void R_SetWallColumn(draw_column_vars_t *dcvars,
+                                   const walltexture_t *wt, int col)
+{
+  if (wt->pixels)
+    {
+      dcvars->source = wt->pixels + (col & wt->mask) * wt->height;
+      dcvars->prevsource = wt->pixels + ((col-1) & wt->mask) * wt->height;
+      dcvars->nextsource = wt->pixels + ((col+1) & wt->mask) * wt->height;
+    }
+  else
+    {
+      dcvars->source = R_GetTextureColumn(wt->patch, col);
+      dcvars->prevsource = R_GetTextureColumn(wt->patch, col-1);
+      dcvars->nextsource = R_GetTextureColumn(wt->patch, col+1);
+    }
+  wallcolumns[!wt->pixels]++;
+}
+
 static void R_RenderSegLoop (void)
 {
-  const rpatch_t *tex_patch;
+  walltexture_t midtex, toptex, bottomtex;
   R_DrawColumn_f colfunc = R_GetDrawColumnFunc(RDC_PIPELINE_STANDARD, drawvars.filterwall, drawvars.filterz);
   draw_column_vars_t dcvars;
   fixed_t  texturecolumn = 0;   // shut up compiler warning
 
   R_SetDefaultDrawColumnVars(&dcvars);
 
+  // queued columns are drawn after the whole BSP walk
+  if (midtexture)
+    R_QueueHoldTexture(midtexture);
+  if (toptexture)
+    R_QueueHoldTexture(toptexture);
+  if (bottomtexture)
+    R_QueueHoldTexture(bottomtexture);
+
+  // locked until the end of the seg
+  R_SetupWallTexture(&midtex, midtexture);
+  R_SetupWallTexture(&toptex, toptexture);
+  R_SetupWallTexture(&bottomtex, bottomtexture);
+
   rendered_segs++;
   for ( ; rw_x < rw_stopx ; rw_x++)
     {
@@ -349,14 +410,9 @@ static void R_RenderSegLoop (void)
           dcvars.yl = yl;     // single sided line
           dcvars.yh = yh;
           dcvars.texturemid = rw_midtexturemid;
-          tex_patch = R_CacheTextureCompositePatchNum(midtexture);
-          dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
-          dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
-          dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
+          R_SetWallColumn(&dcvars, &midtex, texturecolumn);
           dcvars.texheight = midtexheight;
-          colfunc (&dcvars);
-          R_UnlockTextureCompositePatchNum(midtexture);
-          tex_patch = NULL;
+          R_QueueColumn(colfunc, &dcvars);
           ceilingclip[rw_x] = viewheight;
           floorclip[rw_x] = -1;
         }
@@ -378,14 +434,9 @@ static void R_RenderSegLoop (void)
                   dcvars.yl = yl;
                   dcvars.yh = mid;
                   dcvars.texturemid = rw_toptexturemid;
-                  tex_patch = R_CacheTextureCompositePatchNum(toptexture);
-                  dcvars.source = R_GetTextureColumn(tex_patch,texturecolumn);
-                  dcvars.prevsource = R_GetTextureColumn(tex_patch,texturecolumn-1);
-                  dcvars.nextsource = R_GetTextureColumn(tex_patch,texturecolumn+1);
+                  R_SetWallColumn(&dcvars, &toptex, texturecolumn);
                   dcvars.texheight = toptexheight;
-                  colfunc (&dcvars);
-                  R_UnlockTextureCompositePatchNum(toptexture);
-                  tex_patch = NULL;
+                  R_QueueColumn(colfunc, &dcvars);
                   ceilingclip[rw_x] = mid;
                 }
               else
@@ -412,14 +463,9 @@ static void R_RenderSegLoop (void)
                   dcvars.yl = mid;
                   dcvars.yh = yh;
                   dcvars.texturemid = rw_bottomtexturemid;
-                  tex_patch = R_CacheTextureCompositePatchNum(bottomtexture);
-                  dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
-                  dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
-                  dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
+                  R_SetWallColumn(&dcvars, &bottomtex, texturecolumn);
                   dcvars.texheight = bottomtexheight;
-                  colfunc (&dcvars);
-                  R_UnlockTextureCompositePatchNum(bottomtexture);
-                  tex_patch = NULL;
+                  R_QueueColumn(colfunc, &dcvars);
                   floorclip[rw_x] = mid;
                 }
               else
@@ -447,6 +493,13 @@ static void R_RenderSegLoop (void)
       topfrac += topstep;
       bottomfrac += bottomstep;
     }
+
+  if (midtexture)
+    R_UnlockTextureCompositePatchNum(midtexture);
+  if (toptexture)
+    R_UnlockTextureCompositePatchNum(toptexture);
+  if (bottomtexture)
+    R_UnlockTextureCompositePatchNum(bottomtexture);
 }
 
 // killough 5/2/98: move from r_main.c, made static, simplified
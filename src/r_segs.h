@@ -41,4 +41,7 @@
 void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2);
 void R_StoreWallRange(const int start, const int stop);
 
+// wall columns drawn straight from the pixels, and through rcolumn_t
+extern int_64_t wallcolumns[2];
+
 #endif
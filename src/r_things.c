@@ -41,6 +41,7 @@
 #include "r_fps.h"
 #include "v_video.h"
 #include "lprintf.h"
+#include "i_system.h"
 
 #define MINZ        (FRACUNIT*4)
 #define BASEYCENTER 100
@@ -886,8 +887,86 @@ static void msort(vissprite_t **s, vissprite_t **t, int n)
     }
 }
 
+//
+// R_TieOrder
+// msort keeps sprites of equal scale in their original order within its
+// insertion-sorted runs of under 16, but takes the second half first when
+// merging. Laid out in that order, a stable sort on scale alone gives the
+// same result.
+//
+
+static vissprite_t **R_TieOrder(vissprite_t **d, vissprite_t *s, int n)
+{
+  if (n >= 16)
+    {
+      int n1 = n/2;
+      d = R_TieOrder(d, s + n1, n - n1);
+      return R_TieOrder(d, s, n1);
+    }
+  while (n--)
+    *d++ = s++;
+  return d;
+}
+
+// radix sort key: ascending keys are descending scales
+#define SORTKEY(vis) (~((unsigned int)(vis)->scale ^ 0x80000000u))
+
+// below a few hundred sprites msort is quicker than clearing and
+// walking the histograms, above it falls behind quickly
+#define RADIXSORT_MIN 512
+
+//
+// R_RadixSort
+// Stable LSD radix sort on scale, a byte at a time, using t as scratch.
+// Bytes that are the same for every sprite are skipped.
+//
+
+static void R_RadixSort(vissprite_t **s, vissprite_t **t, int n)
+{
+  static int count[4][256];
+  vissprite_t **d = s;
+  int pass, i;
+
+  memset(count, 0, sizeof(count));
+  for (i = 0; i < n; i++)
+    {
+      unsigned int key = SORTKEY(s[i]);
+      count[0][key & 255]++;
+      count[1][(key >> 8) & 255]++;
+      count[2][(key >> 16) & 255]++;
+      count[3][key >> 24]++;
+    }
+
+  for (pass = 0; pass < 4; pass++)
+    {
+      int *c = count[pass], shift = pass*8, sum = 0;
+      vissprite_t **temp;
+
+      if (c[(SORTKEY(s[0]) >> shift) & 255] == n)
+        continue;
+
+      for (i = 0; i < 256; i++)
+        {
+          int k = c[i];
+          c[i] = sum;
+          sum += k;
+        }
+      for (i = 0; i < n; i++)
+        t[c[(SORTKEY(s[i]) >> shift) & 255]++] = s[i];
+
+      temp = s, s = t, t = temp;
+    }
+
+  if (s != d)
+    bcopyp(d, s, n);
+}
+
+int rendered_spritesort;
+
 void R_SortVisSprites (void)
 {
+  int_64_t start = rendering_stats ? I_GetProfileTime() : 0;
+
   if (num_vissprite)
     {
       int i = num_vissprite;
@@ -903,83 +982,210 @@ void R_SortVisSprites (void)
                                   * sizeof *vissprite_ptrs);
         }
 
-      while (--i>=0)
-        vissprite_ptrs[i] = vissprites+i;
+      if (num_vissprite < RADIXSORT_MIN)
+        {
+          while (--i>=0)
+            vissprite_ptrs[i] = vissprites+i;
 
-      // killough 9/22/98: replace qsort with merge sort, since the keys
-      // are roughly in order to begin with, due to BSP rendering.
+          // killough 9/22/98: replace qsort with merge sort, since the keys
+          // are roughly in order to begin with, due to BSP rendering.
 
-      msort(vissprite_ptrs, vissprite_ptrs + num_vissprite, num_vissprite);
+          msort(vissprite_ptrs, vissprite_ptrs + num_vissprite, num_vissprite);
+        }
+      else
+        {
+          R_TieOrder(vissprite_ptrs, vissprites, num_vissprite);
+          R_RadixSort(vissprite_ptrs, vissprite_ptrs + num_vissprite, num_vissprite);
+        }
     }
+
+  if (rendering_stats)
+    rendered_spritesort = (int)(I_GetProfileTime() - start);
 }
 
 //
-// R_DrawSprite
+// Drawseg index
+//
+// Only drawsegs with a silhouette or a masked mid texture can affect a
+// sprite. Once per view, R_DrawMasked files their numbers under every
+// DS_BUCKETWIDTH columns they cover, last drawseg first, so a sprite
+// looks at the drawsegs in the buckets it overlaps instead of all of
+// them, in the same order as before. A sprite over several buckets marks
+// their drawsegs in dsseen, one bit each, and reads the bits back from
+// the top, so a drawseg in more than one of them is still taken once.
 //
 
-static void R_DrawSprite (vissprite_t* spr)
+#define DS_BUCKETSHIFT 5
+#define DS_BUCKETWIDTH (1<<DS_BUCKETSHIFT)
+#define DS_NUMBUCKETS  ((MAX_SCREENWIDTH>>DS_BUCKETSHIFT)+1)
+
+static int *dsindex;            // drawseg numbers, by bucket
+static size_t maxdsindex;
+static int dsbucket[DS_NUMBUCKETS+1]; // start of each bucket in dsindex
+static unsigned int *dsseen;    // one bit per drawseg, all clear between sprites
+static size_t maxdsseen;
+
+static void R_IndexDrawSegs(void)
+{
+  int count[DS_NUMBUCKETS];
+  const drawseg_t *ds;
+  int b, total = 0;
+
+  memset(count, 0, sizeof(count));
+  for (ds = drawsegs; ds < ds_p; ds++)
+    if (ds->silhouette || ds->maskedtexturecol)
+      for (b = ds->x1 >> DS_BUCKETSHIFT; b <= ds->x2 >> DS_BUCKETSHIFT; b++)
+        count[b]++;
+
+  for (b = 0; b < DS_NUMBUCKETS; b++)
+    {
+      dsbucket[b] = total;
+      total += count[b];
+    }
+  dsbucket[DS_NUMBUCKETS] = total;
+
+  if ((size_t)total > maxdsindex)
+    dsindex = realloc(dsindex, sizeof(*dsindex) *
+      (maxdsindex = maxdsindex*2 > (size_t)total ? maxdsindex*2 : (size_t)total));
+
+  if ((size_t)(ds_p - drawsegs + 31) >> 5 > maxdsseen)
+    {
+      maxdsseen = (ds_p - drawsegs + 31) >> 5;
+      free(dsseen);
+      dsseen = calloc(maxdsseen, sizeof(*dsseen));
+    }
+
+  // fill back to front, count[] becomes the fill position
+  for (b = 0; b < DS_NUMBUCKETS; b++)
+    count[b] = dsbucket[b];
+  for (ds = ds_p; ds-- > drawsegs; )
+    if (ds->silhouette || ds->maskedtexturecol)
+      for (b = ds->x1 >> DS_BUCKETSHIFT; b <= ds->x2 >> DS_BUCKETSHIFT; b++)
+        dsindex[count[b]++] = ds - drawsegs;
+}
+
+//
+// R_ClipSpriteToDrawSeg
+// Clips against one drawseg, or draws its masked mid texture if the
+// drawseg is behind the sprite
+//
+
+static void R_ClipSpriteToDrawSeg(const vissprite_t *spr, drawseg_t *ds,
+                                  int *clipbot, int *cliptop)
 {
-  drawseg_t *ds;
-  int     clipbot[MAX_SCREENWIDTH]; // killough 2/8/98: // dropoff overflow
-  int     cliptop[MAX_SCREENWIDTH]; // change to MAX_*  // dropoff overflow
   int     x;
   int     r1;
   int     r2;
   fixed_t scale;
   fixed_t lowscale;
 
+  // determine if the drawseg obscures the sprite
+  if (ds->x1 > spr->x2 || ds->x2 < spr->x1 ||
+      (!ds->silhouette && !ds->maskedtexturecol))
+    return;      // does not cover sprite
+
+  r1 = ds->x1 < spr->x1 ? spr->x1 : ds->x1;
+  r2 = ds->x2 > spr->x2 ? spr->x2 : ds->x2;
+
+  if (ds->scale1 > ds->scale2)
+    {
+      lowscale = ds->scale2;
+      scale = ds->scale1;
+    }
+  else
+    {
+      lowscale = ds->scale1;
+      scale = ds->scale2;
+    }
+
+  if (scale < spr->scale || (lowscale < spr->scale &&
+                !R_PointOnSegSide (spr->gx, spr->gy, ds->curline)))
+    {
+      if (ds->maskedtexturecol)       // masked mid texture?
+        R_RenderMaskedSegRange(ds, r1, r2);
+      return;                 // seg is behind sprite
+    }
+
+  // clip this piece of the sprite
+  // killough 3/27/98: optimized and made much shorter
+
+  if (ds->silhouette&SIL_BOTTOM && spr->gz < ds->bsilheight) //bottom sil
+    for (x=r1 ; x<=r2 ; x++)
+      if (clipbot[x] == -2)
+        clipbot[x] = ds->sprbottomclip[x];
+
+  if (ds->silhouette&SIL_TOP && spr->gzt > ds->tsilheight)   // top sil
+    for (x=r1 ; x<=r2 ; x++)
+      if (cliptop[x] == -2)
+        cliptop[x] = ds->sprtopclip[x];
+}
+
+//
+// R_DrawSprite
+//
+
+static void R_DrawSprite (vissprite_t* spr)
+{
+  int     clipbot[MAX_SCREENWIDTH]; // killough 2/8/98: // dropoff overflow
+  int     cliptop[MAX_SCREENWIDTH]; // change to MAX_*  // dropoff overflow
+  int     x;
+  int     b1 = spr->x1 >> DS_BUCKETSHIFT, b2 = spr->x2 >> DS_BUCKETSHIFT;
+
   for (x = spr->x1 ; x<=spr->x2 ; x++)
     clipbot[x] = cliptop[x] = -2;
 
   // Scan drawsegs from end to start for obscuring segs.
   // The first drawseg that has a greater scale is the clip seg.
 
-  // Modified by Lee Killough:
-  // (pointer check was originally nonportable
-  // and buggy, by going past LEFT end of array):
-
-  //    for (ds=ds_p-1 ; ds >= drawsegs ; ds--)    old buggy code
-
-  for (ds=ds_p ; ds-- > drawsegs ; )  // new -- killough
-    {      // determine if the drawseg obscures the sprite
-      if (ds->x1 > spr->x2 || ds->x2 < spr->x1 ||
-          (!ds->silhouette && !ds->maskedtexturecol))
-        continue;      // does not cover sprite
+  if (b1 == b2)
+    {
+      const int *p = dsindex + dsbucket[b1], *end = dsindex + dsbucket[b1+1];
 
-      r1 = ds->x1 < spr->x1 ? spr->x1 : ds->x1;
-      r2 = ds->x2 > spr->x2 ? spr->x2 : ds->x2;
+      while (p < end)
+        R_ClipSpriteToDrawSeg(spr, drawsegs + *p++, clipbot, cliptop);
+    }
+  else
+    {
+      // The buckets are next to each other in dsindex. Mark their drawsegs
+      // and read the bits back from the top, clearing them as they go,
+      // unless there are as many entries as drawsegs to scan anyway
+      const int *p = dsindex + dsbucket[b1], *end = dsindex + dsbucket[b2+1];
+      int w, lo = INT_MAX, hi = -1;
 
-      if (ds->scale1 > ds->scale2)
+      if (end - p >= ds_p - drawsegs)
         {
-          lowscale = ds->scale2;
-          scale = ds->scale1;
+          drawseg_t *ds;
+
+          for (ds = ds_p; ds-- > drawsegs; )
+            R_ClipSpriteToDrawSeg(spr, ds, clipbot, cliptop);
         }
       else
         {
-          lowscale = ds->scale1;
-          scale = ds->scale2;
-        }
-
-      if (scale < spr->scale || (lowscale < spr->scale &&
-                    !R_PointOnSegSide (spr->gx, spr->gy, ds->curline)))
-        {
-          if (ds->maskedtexturecol)       // masked mid texture?
-            R_RenderMaskedSegRange(ds, r1, r2);
-          continue;               // seg is behind sprite
-        }
-
-      // clip this piece of the sprite
-      // killough 3/27/98: optimized and made much shorter
+          for (; p < end; p++)
+            {
+              w = *p >> 5;
+              dsseen[w] |= 1u << (*p & 31);
+              if (w > hi)
+                hi = w;
+              if (w < lo)
+                lo = w;
+            }
 
-      if (ds->silhouette&SIL_BOTTOM && spr->gz < ds->bsilheight) //bottom sil
-        for (x=r1 ; x<=r2 ; x++)
-          if (clipbot[x] == -2)
-            clipbot[x] = ds->sprbottomclip[x];
+          for (w = hi; w >= lo; w--)
+            {
+              unsigned int bits = dsseen[w];
+              int bit;
 
-      if (ds->silhouette&SIL_TOP && spr->gzt > ds->tsilheight)   // top sil
-        for (x=r1 ; x<=r2 ; x++)
-          if (cliptop[x] == -2)
-            cliptop[x] = ds->sprtopclip[x];
+              dsseen[w] = 0;
+              for (bit = 31; bits; bit--)
+                if (bits & (1u << bit))
+                  {
+                    bits &= ~(1u << bit);
+                    R_ClipSpriteToDrawSeg(spr, drawsegs + (w << 5) + bit,
+                                          clipbot, cliptop);
+                  }
+            }
+        }
     }
 
   // killough 3/27/98:
@@ -1051,6 +1257,7 @@ void R_DrawMasked(void)
   drawseg_t *ds;
 
   R_SortVisSprites();
+  R_IndexDrawSegs();
 
   // draw all vissprites back to front
 
@@ -48,6 +48,9 @@
 // Each screen is [SCREENWIDTH*SCREENHEIGHT];
 screeninfo_t screens[NUM_SCREENS];
 
+// areas of each screen drawn to since the platform code last blitted it
+vdirty_t screen_dirty[NUM_SCREENS];
+
 /* jff 4/24/98 initialize this at runtime */
 const byte *colrngs[CR_LIMIT];
 
@@ -144,6 +147,8 @@ static void FUNC_V_CopyRect(int srcx, int srcy, int srcscrn, int width,
     I_Error ("V_CopyRect: Bad arguments");
 #endif
 
+  V_MarkRect(destscrn, destx, desty, width, height);
+
   src = screens[srcscrn].data+screens[srcscrn].byte_pitch*srcy+srcx*V_GetPixelDepth();
   dest = screens[destscrn].data+screens[destscrn].byte_pitch*desty+destx*V_GetPixelDepth();
 
@@ -172,6 +177,8 @@ static void FUNC_V_DrawBackground(const char* flatname, int scrn)
   int screenheight = screens[scrn].height;
   int screenwidth = screens[scrn].width;
 
+  V_MarkScreen(scrn);
+
   // killough 4/17/98:
   src = W_CacheLumpNum(lump = firstflat + R_FlatNumForName(flatname));
 
@@ -301,6 +308,8 @@ static void V_DrawMemPatch(int x, int y, int scrn, const rpatch_t *patch,
       return;
     }
 
+    V_MarkRect(scrn, x, y, patch->width, patch->height);
+
     w--; // CPhipps - note: w = width-1 now, speeds up flipping
 
     for (col=0 ; (unsigned int)col<=w ; desttop++, col++, x++) {
@@ -416,6 +425,8 @@ static void V_DrawMemPatch(int x, int y, int scrn, const rpatch_t *patch,
     right = ( (x + patch->width) * DX ) >> FRACBITS;
     bottom = ( (y + patch->height) * DY ) >> FRACBITS;
 
+    V_MarkRect(scrn, left, top, right - left + 1, bottom - top + 1);
+
     dcvars.texheight = patch->height;
     dcvars.iscale = DYI;
     dcvars.drawingmasked = MAX(patch->width, patch->height) > 8;
@@ -707,6 +718,7 @@ void V_SetPalette(int pal)
 static void V_FillRect8(int scrn, int x, int y, int width, int height, byte colour)
 {
   byte* dest = screens[scrn].data + x + y*screens[scrn].byte_pitch;
+  V_MarkRect(scrn, x, y, width, height);
   while (height--) {
     memset(dest, colour, width);
     dest += screens[scrn].byte_pitch;
@@ -718,6 +730,7 @@ static void V_FillRect15(int scrn, int x, int y, int width, int height, byte col
   unsigned short* dest = (unsigned short *)screens[scrn].data + x + y*screens[scrn].short_pitch;
   int w;
   short c = VID_PAL15(colour, VID_COLORWEIGHTMASK);
+  V_MarkRect(scrn, x, y, width, height);
   while (height--) {
     for (w=0; w<width; w++) {
       dest[w] = c;
@@ -731,6 +744,7 @@ static void V_FillRect16(int scrn, int x, int y, int width, int height, byte col
   unsigned short* dest = (unsigned short *)screens[scrn].data + x + y*screens[scrn].short_pitch;
   int w;
   short c = VID_PAL16(colour, VID_COLORWEIGHTMASK);
+  V_MarkRect(scrn, x, y, width, height);
   while (height--) {
     for (w=0; w<width; w++) {
       dest[w] = c;
@@ -744,6 +758,7 @@ static void V_FillRect32(int scrn, int x, int y, int width, int height, byte col
   unsigned int* dest = (unsigned int *)screens[scrn].data + x + y*screens[scrn].int_pitch;
   int w;
   int c = VID_PAL32(colour, VID_COLORWEIGHTMASK);
+  V_MarkRect(scrn, x, y, width, height);
   while (height--) {
     for (w=0; w<width; w++) {
       dest[w] = c;
@@ -910,6 +925,90 @@ int V_GetPixelDepth(void) {
   return V_GetModePixelDepth(current_videomode);
 }
 
+//
+// V_AddDirtyRect
+//
+// Adds a rectangle to a damage list. Rectangles already covered are
+// dropped; once the list is full the new one is merged into whichever
+// entry grows the least, so the list always covers everything added.
+//
+void V_AddDirtyRect(vdirty_t *dirty, const vrect_t *rect)
+{
+  int i, best = 0, bestgrowth = INT_MAX;
+  vrect_t *r;
+
+  if (rect->x1 >= rect->x2 || rect->y1 >= rect->y2)
+    return;
+
+  // most recently added first, since consecutive draws tend to overlap
+  for (i = dirty->count - 1; i >= 0; i--) {
+    r = &dirty->rects[i];
+    if (rect->x1 >= r->x1 && rect->x2 <= r->x2 &&
+        rect->y1 >= r->y1 && rect->y2 <= r->y2)
+      return;
+  }
+
+  if (dirty->count < V_MAXDIRTYRECTS) {
+    dirty->rects[dirty->count++] = *rect;
+    return;
+  }
+
+  for (i = 0; i < dirty->count; i++) {
+    int growth;
+
+    r = &dirty->rects[i];
+    growth = (MAX(r->x2, rect->x2) - MIN(r->x1, rect->x1)) *
+             (MAX(r->y2, rect->y2) - MIN(r->y1, rect->y1)) -
+             (r->x2 - r->x1) * (r->y2 - r->y1);
+    if (growth < bestgrowth) {
+      bestgrowth = growth;
+      best = i;
+    }
+  }
+
+  r = &dirty->rects[best];
+  r->x1 = MIN(r->x1, rect->x1);
+  r->y1 = MIN(r->y1, rect->y1);
+  r->x2 = MAX(r->x2, rect->x2);
+  r->y2 = MAX(r->y2, rect->y2);
+}
+
+//
+// V_MarkRect
+//
+// Records that an area of a screen has been drawn to.
+//
+void V_MarkRect(int scrn, int x, int y, int width, int height)
+{
+  vrect_t rect;
+
+  rect.x1 = MAX(x, 0);
+  rect.y1 = MAX(y, 0);
+  rect.x2 = MIN(x + width, screens[scrn].width);
+  rect.y2 = MIN(y + height, screens[scrn].height);
+  V_AddDirtyRect(&screen_dirty[scrn], &rect);
+}
+
+//
+// V_MarkScreen
+//
+void V_MarkScreen(int scrn)
+{
+  screen_dirty[scrn].count = 1;
+  screen_dirty[scrn].rects[0].x1 = 0;
+  screen_dirty[scrn].rects[0].y1 = 0;
+  screen_dirty[scrn].rects[0].x2 = screens[scrn].width;
+  screen_dirty[scrn].rects[0].y2 = screens[scrn].height;
+}
+
+//
+// V_ClearDirty
+//
+void V_ClearDirty(int scrn)
+{
+  screen_dirty[scrn].count = 0;
+}
+
 //
 // V_AllocScreen
 //
@@ -925,8 +1024,10 @@ void V_AllocScreen(screeninfo_t *scrn) {
 void V_AllocScreens(void) {
   int i;
 
-  for (i=0; i<NUM_SCREENS; i++)
+  for (i=0; i<NUM_SCREENS; i++) {
     V_AllocScreen(&screens[i]);
+    V_MarkScreen(i);
+  }
 }
 
 //
@@ -950,18 +1051,22 @@ void V_FreeScreens(void) {
 }
 
 static void V_PlotPixel8(int scrn, int x, int y, byte color) {
+  V_MarkRect(scrn, x, y, 1, 1);
   screens[scrn].data[x+screens[scrn].byte_pitch*y] = color;
 }
 
 static void V_PlotPixel15(int scrn, int x, int y, byte color) {
+  V_MarkRect(scrn, x, y, 1, 1);
   ((unsigned short *)screens[scrn].data)[x+screens[scrn].short_pitch*y] = VID_PAL15(color, VID_COLORWEIGHTMASK);
 }
 
 static void V_PlotPixel16(int scrn, int x, int y, byte color) {
+  V_MarkRect(scrn, x, y, 1, 1);
   ((unsigned short *)screens[scrn].data)[x+screens[scrn].short_pitch*y] = VID_PAL16(color, VID_COLORWEIGHTMASK);
 }
 
 static void V_PlotPixel32(int scrn, int x, int y, byte color) {
+  V_MarkRect(scrn, x, y, 1, 1);
   ((unsigned int *)screens[scrn].data)[x+screens[scrn].int_pitch*y] = VID_PAL32(color, VID_COLORWEIGHTMASK);
 }
 
@@ -97,6 +97,29 @@ typedef enum {
 } screennum_t;
 
 extern screeninfo_t screens[NUM_SCREENS];
+
+// Dirty rectangles
+//
+// The V_ drawing functions record which parts of a screen they have
+// touched, so the platform blit can skip areas that haven't changed.
+#define V_MAXDIRTYRECTS 8
+
+typedef struct {
+  int x1, y1;          // top-left, inclusive
+  int x2, y2;          // bottom-right, exclusive
+} vrect_t;
+
+typedef struct {
+  int count;
+  vrect_t rects[V_MAXDIRTYRECTS];
+} vdirty_t;
+
+extern vdirty_t screen_dirty[NUM_SCREENS];
+
+void V_AddDirtyRect(vdirty_t *dirty, const vrect_t *rect);
+void V_MarkRect(int scrn, int x, int y, int width, int height);
+void V_MarkScreen(int scrn);
+void V_ClearDirty(int scrn);
 extern int          usegamma;
 
 // Varying bit-depth support -POPE
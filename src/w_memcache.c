@@ -45,16 +45,45 @@
 #endif
 #include "w_wad.h"
 #include "z_zone.h"
+#include "i_thread.h"
+#include "m_argv.h"
 #include "lprintf.h"
 
+// Prefetch state of a lump
+enum {
+  PF_NONE,                  // not being prefetched
+  PF_PENDING,               // requested, no memory given to it yet
+  PF_QUEUED,                // block allocated, waiting for the worker
+  PF_READING,               // being read by the worker
+  PF_DONE                   // read, not yet handed over to the cache
+};
+
 static struct {
   void *cache;
 #ifdef TIMEDIAG
   int locktic;
 #endif
   unsigned int locks;
+  int size;                 // bytes charged to the cache budget
+  int prev, next;           // LRU list of unlocked lumps, -1 terminated
+  boolean pinned;           // held for the rest of the level
+  boolean resident;         // cache points into a wad kept in memory
+  int prefetch;             // PF_* state, guarded by prefetch_lock
+  boolean prefetching;      // prefetch isn't PF_NONE, for the main thread
 } *cachelump;
 
+// Unlocked cached lumps, least recently released first. The zone purges
+// PU_CACHE blocks in the same order when it runs short, so a lump in the
+// list may have been purged already; those are noticed lazily.
+static int lru_head = -1, lru_tail = -1;
+
+static size_t cached_bytes;
+static unsigned int cache_hits, cache_misses, cache_evictions, cache_purges;
+
+// Budget for cached lumps in kilobytes, 0 = limited by the zone only
+int lumpcache_budget;
+int lumpcache_pin;
+
 #ifdef HEAPDUMP
 void W_PrintLump(FILE* fp, void* p) {
   int i;
@@ -87,10 +116,20 @@ static void W_ReportLocks(void)
  */
 void W_InitCache(void)
 {
+  int i;
+
   // set up caching
   cachelump = calloc(sizeof *cachelump, numlumps);
   if (!cachelump)
     I_Error ("W_Init: Couldn't allocate lumpcache");
+  for (i = 0; i < numlumps; i++) {
+    cachelump[i].prev = cachelump[i].next = -1;
+    // lumps of mapped or preloaded wads are used where they are
+    cachelump[i].cache = (void *)W_LumpData(i);
+    cachelump[i].resident = cachelump[i].cache != NULL;
+  }
+  lru_head = lru_tail = -1;
+  cached_bytes = 0;
 
 #ifdef TIMEDIAG
   atexit(W_ReportLocks);
@@ -99,6 +138,383 @@ void W_InitCache(void)
 
 void W_DoneCache(void)
 {
+  W_CancelPrefetch();
+}
+
+//
+// LRU list handling
+//
+
+static void W_LRURemove(int lump)
+{
+  if (cachelump[lump].prev != -1)
+    cachelump[cachelump[lump].prev].next = cachelump[lump].next;
+  else
+    lru_head = cachelump[lump].next;
+  if (cachelump[lump].next != -1)
+    cachelump[cachelump[lump].next].prev = cachelump[lump].prev;
+  else
+    lru_tail = cachelump[lump].prev;
+  cachelump[lump].prev = cachelump[lump].next = -1;
+}
+
+static void W_LRUAppend(int lump)
+{
+  cachelump[lump].prev = lru_tail;
+  cachelump[lump].next = -1;
+  if (lru_tail != -1)
+    cachelump[lru_tail].next = lump;
+  else
+    lru_head = lump;
+  lru_tail = lump;
+}
+
+// forget a lump the zone purged behind our back
+static void W_Forget(int lump)
+{
+  W_LRURemove(lump);
+  cached_bytes -= cachelump[lump].size;
+  cachelump[lump].size = 0;
+  cache_purges++;
+}
+
+static void W_SweepPurged(void)
+{
+  int lump = lru_head;
+
+  while (lump != -1)
+  {
+    int next = cachelump[lump].next;
+
+    if (!cachelump[lump].cache)
+      W_Forget(lump);
+    lump = next;
+  }
+}
+
+//
+// W_EnforceBudget
+//
+// Drop least recently used unlocked lumps until the cache fits its budget.
+// Locked lumps count against the budget but are never dropped.
+//
+static void W_EnforceBudget(void)
+{
+  const size_t budget = (size_t)lumpcache_budget * 1024;
+
+  if (!budget)
+    return;
+
+  while (cached_bytes > budget && lru_head != -1)
+  {
+    int lump = lru_head;
+
+    if (cachelump[lump].cache)
+    {
+      Z_Free(cachelump[lump].cache); // clears cachelump[lump].cache
+      W_LRURemove(lump);
+      cached_bytes -= cachelump[lump].size;
+      cachelump[lump].size = 0;
+      cache_evictions++;
+    }
+    else
+      W_Forget(lump);
+  }
+}
+
+//
+// Prefetching
+//
+// R_PrecacheLevel asks for lumps with W_PrefetchLumpNum and the level
+// starts straight away while a worker thread reads them in. The zone
+// isn't thread safe, so the main thread gives each lump its block before
+// the worker sees it, a window's worth at a time, and hands finished
+// lumps over to the cache in W_PrefetchPoll. W_CacheLumpNum only waits
+// for a lump that's being read right now; one still queued is read there
+// and then.
+//
+
+#define PREFETCH_SLOTS  64            // lumps handed to the worker at once
+#define PREFETCH_WINDOW (1024*1024)   // bytes handed to the worker at once
+
+static int *pendinglumps;             // requested, in request order
+static int numpending, maxpending, nextpending;
+
+// ring of lumps handed to the worker: the worker takes them at
+// issue_head, the main thread adds them at issue_tail and reaps them at
+// issue_reap once the worker has moved past them
+static int issued[PREFETCH_SLOTS];
+static unsigned int issue_head, issue_tail, issue_reap;
+static size_t inflight_bytes;
+
+static i_thread_t *prefetch_thread;
+static i_mutex_t *prefetch_lock;
+static i_event_t *prefetch_wake, *prefetch_done;
+static volatile boolean prefetch_quit;
+static boolean prefetch_tried;
+
+static size_t prefetch_bytes;
+static unsigned int prefetch_stalls;
+
+static void W_PrefetchWorker(void *arg)
+{
+  for (;;)
+  {
+    I_WaitEvent(prefetch_wake);
+    if (prefetch_quit)
+      break;
+
+    for (;;)
+    {
+      int lump = -1;
+      void *dest = NULL;
+
+      I_LockMutex(prefetch_lock);
+      while (issue_head != issue_tail && lump == -1 && !prefetch_quit)
+      {
+        lump = issued[issue_head++ % PREFETCH_SLOTS];
+        if (cachelump[lump].prefetch == PF_QUEUED)
+        {
+          cachelump[lump].prefetch = PF_READING;
+          dest = cachelump[lump].cache;
+        }
+        else
+          lump = -1;                  // taken back by the main thread
+      }
+      I_UnlockMutex(prefetch_lock);
+
+      if (lump == -1)
+        break;
+
+      W_ReadLump(lump, dest);
+
+      I_LockMutex(prefetch_lock);
+      cachelump[lump].prefetch = PF_DONE;
+      prefetch_bytes += W_LumpLength(lump);
+      I_UnlockMutex(prefetch_lock);
+      I_SignalEvent(prefetch_done);
+    }
+  }
+}
+
+static void W_ShutdownPrefetch(void)
+{
+  prefetch_quit = true;
+  I_SignalEvent(prefetch_wake);
+  I_JoinThread(prefetch_thread);
+  prefetch_thread = NULL;
+  prefetch_tried = false;
+}
+
+static void W_InitPrefetch(void)
+{
+  if (prefetch_tried)
+    return;
+  prefetch_tried = true;
+  if (M_CheckParm("-noprefetch"))
+    return;
+
+  prefetch_lock = I_CreateMutex();
+  prefetch_wake = I_CreateEvent();
+  prefetch_done = I_CreateEvent();
+  prefetch_quit = false;
+  prefetch_thread = I_CreateThread(W_PrefetchWorker, NULL, -1);
+  if (prefetch_thread)
+    atexit(W_ShutdownPrefetch);
+}
+
+// A prefetched lump becomes an ordinary unlocked cached lump
+static void W_PrefetchFinish(int lump)
+{
+  cachelump[lump].prefetch = PF_NONE;
+  cachelump[lump].prefetching = false;
+  inflight_bytes -= cachelump[lump].size;
+  Z_ChangeTag(cachelump[lump].cache, PU_CACHE);
+  W_LRUAppend(lump);
+}
+
+//
+// W_PrefetchIssue
+// Gives pending lumps their blocks and hands them to the worker until the
+// window is full.
+//
+static void W_PrefetchIssue(void)
+{
+  boolean issuedany = false;
+
+  while (nextpending < numpending && inflight_bytes < PREFETCH_WINDOW &&
+         issue_tail - issue_reap < PREFETCH_SLOTS)
+  {
+    int lump = pendinglumps[nextpending++];
+    int state;
+
+    I_LockMutex(prefetch_lock);
+    state = cachelump[lump].prefetch;
+    I_UnlockMutex(prefetch_lock);
+    if (state != PF_PENDING)
+      continue;                       // wanted before its turn came
+
+    // in flight lumps are held static, so nothing purges them mid-read
+    Z_Malloc(W_LumpLength(lump), PU_STATIC, &cachelump[lump].cache);
+    cachelump[lump].size = W_LumpLength(lump);
+    cached_bytes += cachelump[lump].size;
+    inflight_bytes += cachelump[lump].size;
+
+    I_LockMutex(prefetch_lock);
+    cachelump[lump].prefetch = PF_QUEUED;
+    issued[issue_tail++ % PREFETCH_SLOTS] = lump;
+    I_UnlockMutex(prefetch_lock);
+    issuedany = true;
+  }
+
+  if (nextpending == numpending)
+    nextpending = numpending = 0;
+
+  if (issuedany)
+    I_SignalEvent(prefetch_wake);
+}
+
+//
+// W_PrefetchPoll
+// Called once a frame: hands what the worker has read over to the cache
+// and keeps it busy.
+//
+void W_PrefetchPoll(void)
+{
+  if (!prefetch_thread)
+    return;
+
+  I_LockMutex(prefetch_lock);
+  while (issue_reap != issue_head)
+  {
+    int lump = issued[issue_reap % PREFETCH_SLOTS];
+
+    if (cachelump[lump].prefetch == PF_READING)
+      break;
+    if (cachelump[lump].prefetch == PF_DONE)
+      W_PrefetchFinish(lump);
+    issue_reap++;
+  }
+  I_UnlockMutex(prefetch_lock);
+
+  W_PrefetchIssue();
+  W_EnforceBudget();
+}
+
+//
+// W_PrefetchWait
+// Settles a lump that is wanted now. Afterwards it is either an unlocked
+// cached lump or not cached at all.
+//
+static void W_PrefetchWait(int lump)
+{
+  int state;
+
+  prefetch_stalls++;
+
+  I_LockMutex(prefetch_lock);
+  state = cachelump[lump].prefetch;
+  if (state == PF_PENDING || state == PF_QUEUED)
+    cachelump[lump].prefetch = PF_NONE;   // the worker will skip it
+  I_UnlockMutex(prefetch_lock);
+
+  if (state == PF_PENDING)
+  {
+    cachelump[lump].prefetching = false;
+    return;
+  }
+
+  if (state == PF_QUEUED)
+    W_ReadLump(lump, cachelump[lump].cache);
+  else
+    while (state != PF_DONE)
+    {
+      I_WaitEvent(prefetch_done);
+      I_LockMutex(prefetch_lock);
+      state = cachelump[lump].prefetch;
+      I_UnlockMutex(prefetch_lock);
+    }
+
+  I_LockMutex(prefetch_lock);
+  W_PrefetchFinish(lump);
+  I_UnlockMutex(prefetch_lock);
+}
+
+/*
+ * W_PrefetchLumpNum
+ *
+ * Asks for a lump to be read in the background. Without a worker thread
+ * it is read straight away, like the old precaching did.
+ */
+
+void W_PrefetchLumpNum(int lump)
+{
+  if (cachelump[lump].resident || cachelump[lump].cache ||
+      cachelump[lump].prefetching || !W_LumpLength(lump))
+    return;
+
+  W_InitPrefetch();
+  if (!prefetch_thread)
+  {
+    W_CacheLumpNum(lump);
+    W_UnlockLumpNum(lump);
+    return;
+  }
+
+  if (numpending >= maxpending)
+    pendinglumps = realloc(pendinglumps,
+                           (maxpending = maxpending ? maxpending*2 : 256) *
+                           sizeof *pendinglumps);
+  pendinglumps[numpending++] = lump;
+  cachelump[lump].prefetching = true;
+  I_LockMutex(prefetch_lock);
+  cachelump[lump].prefetch = PF_PENDING;
+  I_UnlockMutex(prefetch_lock);
+}
+
+/*
+ * W_CancelPrefetch
+ *
+ * Drops requests that haven't been started and waits for the rest, e.g.
+ * when a new level starts before the last one was fully read in.
+ */
+
+void W_CancelPrefetch(void)
+{
+  if (!prefetch_thread)
+    return;
+
+  I_LockMutex(prefetch_lock);
+  while (nextpending < numpending)
+  {
+    int lump = pendinglumps[nextpending++];
+
+    if (cachelump[lump].prefetch == PF_PENDING)
+    {
+      cachelump[lump].prefetch = PF_NONE;
+      cachelump[lump].prefetching = false;
+    }
+  }
+  nextpending = numpending = 0;
+  I_UnlockMutex(prefetch_lock);
+
+  while (issue_reap != issue_tail)
+  {
+    int lump = issued[issue_reap % PREFETCH_SLOTS];
+
+    if (cachelump[lump].prefetching)
+    {
+      W_PrefetchWait(lump);
+      prefetch_stalls--;              // not something a frame waited for
+    }
+
+    // the worker may not have moved past it yet
+    I_LockMutex(prefetch_lock);
+    if (issue_head == issue_reap)
+      issue_head++;
+    issue_reap++;
+    I_UnlockMutex(prefetch_lock);
+  }
 }
 
 /* W_CacheLumpNum
@@ -115,8 +531,31 @@ const void *W_CacheLumpNum(int lump)
     I_Error ("W_CacheLumpNum: %i >= numlumps",lump);
 #endif
 
-  if (!cachelump[lump].cache)      // read the lump in
+  if (cachelump[lump].resident) {
+    cache_hits++;
+    cachelump[lump].locks += locks;
+    return cachelump[lump].cache;
+  }
+
+  if (cachelump[lump].prefetching)
+    W_PrefetchWait(lump);
+
+  // an unlocked lump is on the LRU list, whether or not it's still cached
+  if (!cachelump[lump].locks && (cachelump[lump].prev != -1 || lru_head == lump)) {
+    if (cachelump[lump].cache)
+      W_LRURemove(lump);
+    else
+      W_Forget(lump);
+  }
+
+  if (!cachelump[lump].cache) {    // read the lump in
+    cache_misses++;
     W_ReadLump(lump, Z_Malloc(W_LumpLength(lump), PU_CACHE, &cachelump[lump].cache));
+    cachelump[lump].size = W_LumpLength(lump);
+    cached_bytes += cachelump[lump].size;
+  }
+  else
+    cache_hits++;
 
   /* cph - if wasn't locked but now is, tell z_zone to hold it */
   if (!cachelump[lump].locks && locks) {
@@ -133,6 +572,9 @@ const void *W_CacheLumpNum(int lump)
 	    lumpinfo[lump].name, cachelump[lump].locks);
 #endif
 
+  // make room now the lump can't be dropped itself
+  W_EnforceBudget();
+
   return cachelump[lump].cache;
 }
 
@@ -156,10 +598,68 @@ void W_UnlockLumpNum(int lump)
 	    lumpinfo[lump].name, cachelump[lump].locks, unlocks);
 #endif
   cachelump[lump].locks -= unlocks;
+  if (cachelump[lump].resident)
+    return;
   /* cph - Note: must only tell z_zone to make purgeable if currently locked,
    * else it might already have been purged
    */
-  if (unlocks && !cachelump[lump].locks)
+  if (unlocks && !cachelump[lump].locks) {
     Z_ChangeTag(cachelump[lump].cache, PU_CACHE);
+    W_LRUAppend(lump);
+    W_EnforceBudget();
+  }
+}
+
+/*
+ * W_PinLumpNum
+ *
+ * Hint that a lump will be wanted all through the current level, e.g. the
+ * flats it uses, so it is never dropped and read back in mid-frame.
+ * Pins are released by W_UnpinLumps when the level ends.
+ */
+
+void W_PinLumpNum(int lump)
+{
+  if (!cachelump[lump].pinned && !cachelump[lump].resident) {
+    W_LockLumpNum(lump);
+    cachelump[lump].pinned = true;
+  }
+}
+
+void W_UnpinLumps(void)
+{
+  int i;
+
+  for (i = 0; i < numlumps; i++)
+    if (cachelump[i].pinned) {
+      cachelump[i].pinned = false;
+      W_UnlockLumpNum(i);
+    }
+}
+
+void W_GetCacheStats(lumpcachestats_t *stats)
+{
+  int i;
+
+  W_SweepPurged();
+
+  stats->hits = cache_hits;
+  stats->misses = cache_misses;
+  stats->evictions = cache_evictions;
+  stats->purges = cache_purges;
+  stats->bytes = cached_bytes;
+  stats->budget = (size_t)lumpcache_budget * 1024;
+  stats->prefetch_queued = numpending - nextpending + issue_tail - issue_reap;
+  stats->prefetch_bytes = prefetch_bytes;
+  stats->prefetch_stalls = prefetch_stalls;
+  stats->locked = stats->pinned = stats->resident = 0;
+  for (i = 0; i < numlumps; i++) {
+    if (cachelump[i].resident)
+      stats->resident++;
+    else if (cachelump[i].locks)
+      stats->locked++;
+    if (cachelump[i].pinned)
+      stats->pinned++;
+  }
 }
 
@@ -44,11 +44,16 @@
 #include <io.h>
 #endif
 #include <fcntl.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include "doomstat.h"
 #include "d_net.h"
 #include "doomtype.h"
 #include "i_system.h"
+#include "i_thread.h"
+#include "m_argv.h"
 
 #ifdef __GNUG__
 #pragma implementation "w_wad.h"
@@ -64,6 +69,13 @@
 lumpinfo_t *lumpinfo;
 int        numlumps;         // killough
 
+// Wads no bigger than this many kilobytes are read into memory in one go
+// when mapping them isn't possible, so lumps are read with a memcpy
+int        wad_preload_kb;
+
+// The lump prefetch thread reads through the same handles as the main thread
+static i_mutex_t *wadio_lock;
+
 void ExtractFileBase (const char *path, char *dest)
 {
   const char *src = path + strlen(path) - 1;
@@ -108,6 +120,92 @@ char *AddDefaultExtension(char *path, const char *ext)
   return strcat(path,ext);
 }
 
+//
+// WAD I/O BACKENDS
+//
+
+//
+// W_OpenBackend
+// Maps the file or reads all of it in if it can, otherwise leaves it to be
+// read a lump at a time through the handle.
+//
+static void W_OpenBackend(wadfile_info_t *wadfile)
+{
+  wadfile->io = wadio_fd;
+  wadfile->data = NULL;
+  wadfile->length = I_Filelength(wadfile->handle);
+
+  if (!wadfile->length)
+    return;
+
+#ifdef HAVE_MMAP
+  if (!M_CheckParm("-nommap"))
+  {
+    void *data = mmap(NULL, wadfile->length, PROT_READ, MAP_SHARED, wadfile->handle, 0);
+
+    if (data != MAP_FAILED)
+    {
+      wadfile->io = wadio_mmap;
+      wadfile->data = data;
+      return;
+    }
+  }
+#endif
+
+  if (wadfile->length <= (size_t)wad_preload_kb * 1024)
+  {
+    byte *data = malloc(wadfile->length);
+
+    lseek(wadfile->handle, 0, SEEK_SET);
+    I_Read(wadfile->handle, data, wadfile->length);
+    wadfile->io = wadio_memory;
+    wadfile->data = data;
+  }
+}
+
+static void W_CloseBackend(wadfile_info_t *wadfile)
+{
+  switch (wadfile->io)
+  {
+#ifdef HAVE_MMAP
+    case wadio_mmap:
+      munmap((void *)wadfile->data, wadfile->length);
+      break;
+#endif
+    case wadio_memory:
+      free((void *)wadfile->data);
+      break;
+    default:
+      break;
+  }
+  wadfile->io = wadio_fd;
+  wadfile->data = NULL;
+  if (wadfile->handle != -1)
+    close(wadfile->handle);
+  wadfile->handle = -1;
+}
+
+//
+// W_ReadFile
+// Reads len bytes at pos in the file, whatever the backend.
+//
+static void W_ReadFile(const wadfile_info_t *wadfile, size_t pos, void *dest, size_t len)
+{
+  if (wadfile->data)
+  {
+    if (pos > wadfile->length || len > wadfile->length - pos)
+      I_Error("W_ReadFile: read past the end of %s", wadfile->name);
+    memcpy(dest, wadfile->data + pos, len);
+  }
+  else
+  {
+    I_LockMutex(wadio_lock);
+    lseek(wadfile->handle, pos, SEEK_SET);
+    I_Read(wadfile->handle, dest, len);
+    I_UnlockMutex(wadio_lock);
+  }
+}
+
 //
 // LUMP BASED ROUTINES.
 //
@@ -139,6 +237,8 @@ static void W_AddFile(wadfile_info_t *wadfile)
   // open the file and add to directory
 
   wadfile->handle = open(wadfile->name,O_RDONLY | O_BINARY);
+  wadfile->io = wadio_fd;
+  wadfile->data = NULL;
 
 #ifdef HAVE_NET
   if (wadfile->handle == -1 && D_NetGetWad(wadfile->name)) // CPhipps
@@ -155,8 +255,12 @@ static void W_AddFile(wadfile_info_t *wadfile)
       return;
     }
 
+  W_OpenBackend(wadfile);
+
   //jff 8/3/98 use logical output routine
-  lprintf (LO_INFO," adding %s\n",wadfile->name);
+  lprintf (LO_INFO," adding %s%s\n",wadfile->name,
+           wadfile->io == wadio_mmap ? " (mapped)" :
+           wadfile->io == wadio_memory ? " (in memory)" : "");
   startlump = numlumps;
 
   if (  strlen(wadfile->name)<=4 || 
@@ -169,14 +273,14 @@ static void W_AddFile(wadfile_info_t *wadfile)
       // single lump file
       fileinfo = &singleinfo;
       singleinfo.filepos = 0;
-      singleinfo.size = LONG(I_Filelength(wadfile->handle));
+      singleinfo.size = LONG(wadfile->length);
       ExtractFileBase(wadfile->name, singleinfo.name);
       numlumps++;
     }
   else
     {
       // WAD file
-      I_Read(wadfile->handle, &header, sizeof(header));
+      W_ReadFile(wadfile, 0, &header, sizeof(header));
       if (strncmp(header.identification,"IWAD",4) &&
           strncmp(header.identification,"PWAD",4))
         I_Error("W_AddFile: Wad file %s doesn't have IWAD or PWAD id", wadfile->name);
@@ -184,8 +288,7 @@ static void W_AddFile(wadfile_info_t *wadfile)
       header.infotableofs = LONG(header.infotableofs);
       length = header.numlumps*sizeof(filelump_t);
       fileinfo2free = fileinfo = malloc(length);    // killough
-      lseek(wadfile->handle, header.infotableofs, SEEK_SET);
-      I_Read(wadfile->handle, fileinfo, length);
+      W_ReadFile(wadfile, header.infotableofs, fileinfo, length);
       numlumps += header.numlumps;
     }
 
@@ -399,6 +502,8 @@ void W_Init(void)
   // CPhipps - start with nothing
 
   numlumps = 0; lumpinfo = NULL;
+  if (!wadio_lock)
+    wadio_lock = I_CreateMutex();
 
   { // CPhipps - new wadfiles array used 
     // open all the files, load headers, and count lumps
@@ -430,7 +535,11 @@ void W_Init(void)
 
 void W_ReleaseAllWads(void)
 {
+	size_t i;
+
 	W_DoneCache();
+	for (i = 0; i < numwadfiles; i++)
+		W_CloseBackend(&wadfiles[i]);
 	numwadfiles = 0;
 	free(wadfiles);
 	wadfiles = NULL;
@@ -467,10 +576,25 @@ void W_ReadLump(int lump, void *dest)
 
     {
       if (l->wadfile)
-      {
-        lseek(l->wadfile->handle, l->position, SEEK_SET);
-        I_Read(l->wadfile->handle, dest, l->size);
-      }
+        W_ReadFile(l->wadfile, l->position, dest, l->size);
     }
 }
 
+//
+// W_LumpData
+// Returns the lump where it already sits in memory, so it can be used
+// without a copy, or NULL if it has to be read. Lumps that aren't word
+// aligned in the file are always read, since the code using them expects
+// aligned ints.
+//
+
+const void *W_LumpData(int lump)
+{
+  const lumpinfo_t *l = lumpinfo + lump;
+
+  if (!l->wadfile || !l->wadfile->data || (l->position & 3) ||
+      (size_t)l->position + l->size > l->wadfile->length)
+    return NULL;
+  return l->wadfile->data + l->position;
+}
+
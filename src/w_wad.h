@@ -76,10 +76,21 @@ typedef enum {
 // CPhipps - changed wad init
 // We _must_ have the wadfiles[] the same as those actually loaded, so there 
 // is no point having these separate entities. This belongs here.
+// How a wad's lumps are read: lseek+read per lump, from a copy of the whole
+// file read in once, or from a memory mapping of the file
+typedef enum {
+  wadio_fd,
+  wadio_memory,
+  wadio_mmap
+} wad_io_t;
+
 typedef struct {
   const char* name;
   wad_source_t src;
   int handle;
+  wad_io_t io;
+  const unsigned char *data; // whole file, unless io is wadio_fd
+  size_t length;
 } wadfile_info_t;
 
 extern wadfile_info_t *wadfiles;
@@ -126,11 +137,41 @@ int     (W_CheckNumForName)(const char* name, int);   // killough 4/17/98
 int     W_GetNumForName (const char* name);
 int     W_LumpLength (int lump);
 void    W_ReadLump (int lump, void *dest);
+const void* W_LumpData (int lump);    // lump in place in memory, or NULL
+
+extern int wad_preload_kb;  // read wads up to this size into memory, 0 = never
 // CPhipps - modified for 'new' lump locking
 const void* W_CacheLumpNum (int lump);
 const void* W_LockLumpNum(int lump);
 void    W_UnlockLumpNum(int lump);
 
+// Keep a lump cached until W_UnpinLumps, called when a level ends
+void    W_PinLumpNum(int lump);
+void    W_UnpinLumps(void);
+
+// Read a lump into the cache in the background
+void    W_PrefetchLumpNum(int lump);
+void    W_PrefetchPoll(void);         // once a frame, from the main loop
+void    W_CancelPrefetch(void);
+
+typedef struct
+{
+  unsigned int hits, misses;  // W_CacheLumpNum calls served from memory or not
+  unsigned int evictions;     // lumps dropped to stay in budget
+  unsigned int purges;        // lumps dropped by the zone running short
+  size_t bytes, budget;       // bytes cached, budget (0 = none)
+  int locked, pinned;         // lumps currently locked, of which pinned
+  int resident;               // lumps used in place from a wad in memory
+  int prefetch_queued;        // lumps waiting to be prefetched or in flight
+  size_t prefetch_bytes;      // bytes read by the prefetch thread
+  unsigned int prefetch_stalls; // lumps wanted before they were prefetched
+} lumpcachestats_t;
+
+extern int lumpcache_budget;  // kilobytes, 0 = limited by the zone only
+extern int lumpcache_pin;     // pin each level's flats and sky
+
+void    W_GetCacheStats(lumpcachestats_t *stats);
+
 // CPhipps - convenience macros
 //#define W_CacheLumpNum(num) (W_CacheLumpNum)((num),1)
 #define W_CacheLumpName(name) W_CacheLumpNum (W_GetNumForName(name))
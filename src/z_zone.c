@@ -48,6 +48,9 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#ifdef ZONE_ARENA
+#include <stdint.h>
+#endif
 
 #include "z_zone.h"
 #include "doomstat.h"
@@ -83,6 +86,16 @@
 // Number of mallocs & frees kept in history buffer (must be a power of 2)
 #define ZONE_HISTORY 4
 
+#ifdef ZONE_ARENA
+// Size of the arena to reserve, reduced by RETRY_AMOUNT until it fits
+#ifndef ZONE_ARENA_SIZE
+#define ZONE_ARENA_SIZE (16*1024*1024)
+#endif
+
+// Largest heap block size that gets its own free list
+#define ZONE_SMALL_MAX 1024
+#endif
+
 // End Tunables
 
 typedef struct memblock {
@@ -96,6 +109,11 @@ typedef struct memblock {
   void **user;
   unsigned char tag;
 
+#ifdef ZONE_ARENA
+  size_t prevsize;      // size of the block just below, 0 for the first one
+  unsigned char where;  // ZONE_HEAP or ZONE_LEVELSTACK
+#endif
+
 #ifdef INSTRUMENTED
   const char *file;
   int line;
@@ -121,11 +139,386 @@ static int free_memory = 0;
 static int active_memory = 0;
 static int purgable_memory = 0;
 
+#endif
+
+#ifdef ZONE_ARENA
+
+/* Arena mode
+ *
+ * All zone memory comes from one region reserved by Z_Init. The general
+ * heap grows up from the bottom of the arena, PU_LEVEL and PU_LEVSPEC
+ * blocks are stacked down from the top, and the unused middle is shared
+ * by both. Freeing a whole level just resets the level stack.
+ *
+ * Heap blocks up to ZONE_SMALL_MAX bytes are recycled through exact size
+ * classes; so are small level blocks freed in the middle of the stack,
+ * since thinkers and missiles come and go all level long. Larger free
+ * blocks sit in power of two bins, are merged with free large neighbours
+ * straight away, and go back to the middle when they end up at the top of
+ * the heap. Small free blocks are only merged when an allocation would
+ * otherwise fail.
+ */
+
+enum {ZONE_HEAP, ZONE_LEVELSTACK};
+
+#define NUM_SMALL_BINS (ZONE_SMALL_MAX/CHUNK_SIZE)
+#define NUM_LARGE_BINS 22
+
+static char *arena_base, *arena_end;
+static char *heap_top;                 // start of the unused middle
+static char *level_bottom;             // end of the unused middle
+static memblock_t *heap_last;          // last heap block below heap_top
+static memblock_t *smallbins[NUM_SMALL_BINS];
+static memblock_t *largebins[NUM_LARGE_BINS];
+static memblock_t *levelbins[NUM_SMALL_BINS]; // freed small level blocks
+static memblock_t *levelowned;         // level stack blocks with a user
+
+static size_t arena_peak;              // most of the arena ever in use
+static size_t level_live;              // bytes in live level stack blocks
+static int heap_frees;                 // heap blocks freed since the last consolidation
+static int level_releases;
+
+#define Z_BlockAfter(b) ((memblock_t *)((char *)(b) + HEADER_SIZE + (b)->size))
+#define Z_BlockBefore(b) ((memblock_t *)((char *)(b) - HEADER_SIZE - (b)->prevsize))
+
+static int Z_LargeBin(size_t size)
+{
+  int bin = 0;
+
+  for (size /= (ZONE_SMALL_MAX*2); size && bin < NUM_LARGE_BINS-1; size >>= 1)
+    bin++;
+  return bin;
+}
+
+static memblock_t **Z_BinFor(size_t size)
+{
+  return size <= ZONE_SMALL_MAX ?
+    &smallbins[size/CHUNK_SIZE-1] : &largebins[Z_LargeBin(size)];
+}
+
+static void Z_BinInsert(memblock_t **bin, memblock_t *block)
+{
+  block->tag = PU_FREE;
+  block->prev = NULL;
+  if ((block->next = *bin))
+    (*bin)->prev = block;
+  *bin = block;
+}
+
+static void Z_BinRemove(memblock_t **bin, memblock_t *block)
+{
+  if (block->prev)
+    block->prev->next = block->next;
+  else
+    *bin = block->next;
+  if (block->next)
+    block->next->prev = block->prev;
+}
+
+static void Z_ArenaUpdatePeak(void)
+{
+  size_t used = (heap_top - arena_base) + (arena_end - level_bottom);
+
+  if (used > arena_peak)
+    arena_peak = used;
+}
+
+// Take a block of at least size bytes from the bins or the middle
+static memblock_t *Z_ArenaHeapTake(size_t size)
+{
+  memblock_t *block = NULL;
+  int bin;
+
+  if (size <= ZONE_SMALL_MAX && (block = smallbins[size/CHUNK_SIZE-1]))
+    {
+      Z_BinRemove(Z_BinFor(block->size), block);
+      return block;
+    }
+
+  // first fit within the size's own bin, anything in the bins above it
+  for (bin = size <= ZONE_SMALL_MAX ? 0 : Z_LargeBin(size); bin < NUM_LARGE_BINS && !block; bin++)
+    for (block = largebins[bin]; block && block->size < size; block = block->next)
+      ;
+
+  if (block)
+    {
+      Z_BinRemove(Z_BinFor(block->size), block);
+      if (block->size >= size + HEADER_SIZE + CHUNK_SIZE)
+        {
+          // split off the rest
+          memblock_t *rest = (memblock_t *)((char *)block + HEADER_SIZE + size);
+
+          rest->size = block->size - size - HEADER_SIZE;
+          rest->prevsize = size;
+          rest->where = ZONE_HEAP;
+          block->size = size;
+          if (block == heap_last)
+            heap_last = rest;
+          else
+            Z_BlockAfter(rest)->prevsize = rest->size;
+          Z_BinInsert(Z_BinFor(rest->size), rest);
+        }
+      return block;
+    }
+
+  if ((size_t)(level_bottom - heap_top) < size + HEADER_SIZE)
+    return NULL;
+
+  block = (memblock_t *)heap_top;
+  block->size = size;
+  block->prevsize = heap_last ? heap_last->size : 0;
+  block->where = ZONE_HEAP;
+  heap_last = block;
+  heap_top += HEADER_SIZE + size;
+  Z_ArenaUpdatePeak();
+  return block;
+}
+
+//
+// Z_ArenaConsolidate
+// Merge all runs of free heap blocks, small ones included, and return
+// a free run at the top of the heap to the middle.
+//
+static void Z_ArenaConsolidate(void)
+{
+  memblock_t *block = (memblock_t *)arena_base, *prev = NULL;
+
+  while ((char *)block < heap_top)
+    {
+      memblock_t *next = Z_BlockAfter(block);
+
+      if (block->tag == PU_FREE)
+        {
+          Z_BinRemove(Z_BinFor(block->size), block);
+          while ((char *)next < heap_top && next->tag == PU_FREE)
+            {
+              Z_BinRemove(Z_BinFor(next->size), next);
+              block->size += HEADER_SIZE + next->size;
+              next = Z_BlockAfter(block);
+            }
+          if ((char *)next >= heap_top)
+            {
+              heap_top = (char *)block;
+              heap_last = prev;
+              break;
+            }
+          next->prevsize = block->size;
+          Z_BinInsert(Z_BinFor(block->size), block);
+        }
+      prev = block;
+      block = next;
+    }
+  heap_frees = 0;
+}
+
+static memblock_t *Z_ArenaHeapAlloc(size_t size)
+{
+  memblock_t *block = Z_ArenaHeapTake(size);
+
+  // merge what's been freed and try again before anything gets purged
+  if (!block && heap_frees)
+    {
+      Z_ArenaConsolidate();
+      block = Z_ArenaHeapTake(size);
+    }
+  return block;
+}
+
+static void Z_ArenaHeapFree(memblock_t *block)
+{
+  heap_frees++;
+  if (block->size > ZONE_SMALL_MAX)
+    {
+      if (block != heap_last)
+        {
+          memblock_t *next = Z_BlockAfter(block);
+
+          if (next->tag == PU_FREE && next->size > ZONE_SMALL_MAX)
+            {
+              Z_BinRemove(Z_BinFor(next->size), next);
+              if (next == heap_last)
+                heap_last = block;
+              block->size += HEADER_SIZE + next->size;
+            }
+        }
+      if (block->prevsize)
+        {
+          memblock_t *prev = Z_BlockBefore(block);
+
+          if (prev->tag == PU_FREE && prev->size > ZONE_SMALL_MAX)
+            {
+              Z_BinRemove(Z_BinFor(prev->size), prev);
+              if (block == heap_last)
+                heap_last = prev;
+              prev->size += HEADER_SIZE + block->size;
+              block = prev;
+            }
+        }
+
+      if (block == heap_last)
+        {
+          // give the top of the heap back to the middle
+          heap_top = (char *)block;
+          heap_last = block->prevsize ? Z_BlockBefore(block) : NULL;
+          block->tag = PU_FREE;
+          return;
+        }
+      Z_BlockAfter(block)->prevsize = block->size;
+    }
+  Z_BinInsert(Z_BinFor(block->size), block);
+}
+
+static memblock_t *Z_ArenaLevelAlloc(size_t size)
+{
+  memblock_t *block;
+
+  if (size <= ZONE_SMALL_MAX && (block = levelbins[size/CHUNK_SIZE-1]))
+    Z_BinRemove(&levelbins[size/CHUNK_SIZE-1], block);
+  else
+    {
+      if ((size_t)(level_bottom - heap_top) < size + HEADER_SIZE)
+        return NULL;
+
+      level_bottom -= HEADER_SIZE + size;
+      block = (memblock_t *)level_bottom;
+      block->size = size;
+      block->prevsize = 0;
+      block->where = ZONE_LEVELSTACK;
+      Z_ArenaUpdatePeak();
+    }
+  level_live += size;
+  return block;
+}
+
+static void Z_ArenaLevelFree(memblock_t *block)
+{
+  if (block->user)
+    {
+      if (block->prev)
+        block->prev->next = block->next;
+      else
+        levelowned = block->next;
+      if (block->next)
+        block->next->prev = block->prev;
+    }
+
+  // blocks in the middle of the stack stay until everything below goes
+  level_live -= block->size;
+  if (block->size <= ZONE_SMALL_MAX)
+    Z_BinInsert(&levelbins[block->size/CHUNK_SIZE-1], block);
+  else
+    block->tag = PU_FREE;
+
+  while (level_bottom < arena_end && (block = (memblock_t *)level_bottom)->tag == PU_FREE)
+    {
+      if (block->size <= ZONE_SMALL_MAX)
+        Z_BinRemove(&levelbins[block->size/CHUNK_SIZE-1], block);
+      level_bottom += HEADER_SIZE + block->size;
+    }
+}
+
+// Free the whole level stack at once
+static void Z_ArenaReleaseLevel(void)
+{
+  memblock_t *block;
+
+  for (block = levelowned; block; block = block->next)
+    *block->user = NULL;
+  levelowned = NULL;
+  memset(levelbins, 0, sizeof(levelbins));
+
+  free_memory += level_live;
+#ifdef INSTRUMENTED
+  // level blocks are never purgable
+  active_memory -= level_live;
+#endif
+  level_live = 0;
+  level_bottom = arena_end;
+  level_releases++;
+}
+
+typedef struct {
+  size_t heap, level, middle;          // bytes in use by each part
+  size_t binned, largest;              // free bytes in the bins, largest free block
+  int smallfree, largefree;            // free block counts
+} arenastats_t;
+
+static void Z_ArenaGetStats(arenastats_t *st)
+{
+  int i;
+
+  memset(st, 0, sizeof(*st));
+  for (i = 0; i < NUM_SMALL_BINS + NUM_LARGE_BINS; i++)
+    {
+      const memblock_t *block = i < NUM_SMALL_BINS ? smallbins[i] : largebins[i-NUM_SMALL_BINS];
+
+      for (; block; block = block->next)
+        {
+          st->binned += block->size;
+          if (block->size > st->largest)
+            st->largest = block->size;
+          if (i < NUM_SMALL_BINS)
+            st->smallfree++;
+          else
+            st->largefree++;
+        }
+    }
+  st->middle = level_bottom - heap_top;
+  if (st->middle > HEADER_SIZE && st->middle - HEADER_SIZE > st->largest)
+    st->largest = st->middle - HEADER_SIZE;
+  st->heap = (heap_top - arena_base) - st->binned;
+  st->level = arena_end - level_bottom;
+}
+
+// Share of the free memory that isn't part of the largest free block
+static int Z_ArenaFragmentation(const arenastats_t *st)
+{
+  size_t total = st->binned + st->middle;
+
+  return total ? (int)(100 - (double)st->largest * 100 / total) : 0;
+}
+
+static void Z_ArenaReport(void)
+{
+  arenastats_t st;
+
+  Z_ArenaGetStats(&st);
+  lprintf(LO_INFO, "Z_Close: arena %lukb, peak %lukb, %d level releases, "
+          "%d%% fragmented (%d small + %d large free blocks)\n",
+          (unsigned long)(arena_end - arena_base) >> 10,
+          (unsigned long)arena_peak >> 10, level_releases,
+          Z_ArenaFragmentation(&st), st.smallfree, st.largefree);
+}
+
+#endif // ZONE_ARENA
+
+#ifdef INSTRUMENTED
+
 static void Z_DrawStats(void)            // Print allocation statistics
 {
   if (gamestate != GS_LEVEL)
     return;
 
+#ifdef ZONE_ARENA
+  {
+    arenastats_t st;
+
+    Z_ArenaGetStats(&st);
+    doom_printf("%-5lu\theap\n"
+            "%-5lu\tlevel\n"
+            "%-5lu\tfree\n"
+            "%-5lu\tpeak\n"
+            "%-5i%%\tfragmented\n",
+            (unsigned long)st.heap,
+            (unsigned long)st.level,
+            (unsigned long)(st.binned + st.middle),
+            (unsigned long)arena_peak,
+            Z_ArenaFragmentation(&st)
+            );
+    return;
+  }
+#endif
+
   if (memory_size > 0) {
     unsigned long total_memory = free_memory + memory_size + active_memory + purgable_memory;
     double s = 100.0 / total_memory;
@@ -212,6 +605,29 @@ void Z_DumpMemory(void)
       block=block->next;
     }
   }
+#ifdef ZONE_ARENA
+  {
+    memblock_t *block;
+    arenastats_t st;
+
+    for (block = (memblock_t *)level_bottom; (char *)block < arena_end; block = Z_BlockAfter(block))
+      if (block->tag != PU_FREE)
+      {
+        fprintf(fp, "levelstack %s:%d:%d\n", block->file, block->line, block->size);
+        total_malloc += block->size;
+      }
+
+    Z_ArenaGetStats(&st);
+    total_free += st.binned + st.middle;
+    fprintf(fp, "arena %lu, heap %lu, level %lu, middle %lu, binned %lu "
+      "(%d small, %d large), largest free %lu, peak %lu, %d%% fragmented\n",
+      (unsigned long)(arena_end - arena_base), (unsigned long)st.heap,
+      (unsigned long)st.level, (unsigned long)st.middle,
+      (unsigned long)st.binned, st.smallfree, st.largefree,
+      (unsigned long)st.largest, (unsigned long)arena_peak,
+      Z_ArenaFragmentation(&st));
+  }
+#endif
   fprintf(fp, "malloc %d, cache %d, free %d, total %d\n",
     total_malloc, total_cache, total_free, 
     total_malloc + total_cache + total_free);
@@ -260,8 +676,17 @@ void Z_DumpHistory(char *buf)
 
 #endif
 
+#ifdef ZONE_ARENA
+static void *zonebase;
+#endif
+
 void Z_Close(void)
 {
+#ifdef ZONE_ARENA
+  Z_ArenaReport();
+  (free)(zonebase);
+  zonebase = NULL;
+#endif
 #if 0
   (free)(zonebase);
   zone = rover = zonebase = NULL;
@@ -270,6 +695,30 @@ void Z_Close(void)
 
 void Z_Init(void)
 {
+#ifdef ZONE_ARENA
+  size_t size = ZONE_ARENA_SIZE;
+  void *reserve;
+
+  // make sure there's some memory left over for libc users
+  while (!(reserve = (malloc)(size + LEAVE_ASIDE)))
+    if ((size -= RETRY_AMOUNT) < RETRY_AMOUNT)
+      I_Error("Z_Init: Failed to reserve the zone arena");
+  (free)(reserve);
+
+  if (!(zonebase = (malloc)(size)))
+    I_Error("Z_Init: Failed on allocation of %lu bytes", (unsigned long)size);
+
+  arena_base = (char *)(((uintptr_t)zonebase + CACHE_ALIGN-1) & ~(uintptr_t)(CACHE_ALIGN-1));
+  arena_end = (char *)(((uintptr_t)zonebase + size) & ~(uintptr_t)(CACHE_ALIGN-1));
+  heap_top = arena_base;
+  level_bottom = arena_end;
+
+  lprintf(LO_INFO,"Z_Init : Reserved %lukb zone arena\n",
+      (unsigned long)(arena_end - arena_base) >> 10);
+#ifdef HEAPDUMP
+  atexit(Z_DumpMemory);
+#endif
+#endif
 #if 0
   size_t size = zone_size*1000;
 
@@ -386,7 +835,11 @@ void *(Z_Malloc)(size_t size, int tag, void **user
     block = NULL;
   }
 
-#ifdef HAVE_LIBDMALLOC
+#ifdef ZONE_ARENA
+  if (tag == PU_LEVEL || tag == PU_LEVSPEC)
+    block = Z_ArenaLevelAlloc(size);
+  while (!block && !(block = Z_ArenaHeapAlloc(size))) {
+#elif defined(HAVE_LIBDMALLOC)
   while (!(block = dmalloc_malloc(file,line,size + HEADER_SIZE,DMALLOC_FUNC_MALLOC,0,0))) {
 #else
   while (!(block = (malloc)(size + HEADER_SIZE))) {
@@ -401,9 +854,36 @@ void *(Z_Malloc)(size_t size, int tag, void **user
                , file, line
 #endif
       );
+#ifdef ZONE_ARENA
+    {
+      // purge the oldest cache blocks, enough of them to fit in theory
+      size_t purged = 0;
+
+      while (blockbytag[PU_CACHE] && purged < size + HEADER_SIZE)
+      {
+        purged += blockbytag[PU_CACHE]->size + HEADER_SIZE;
+        (Z_Free)((char *) blockbytag[PU_CACHE] + HEADER_SIZE DA(file, line));
+      }
+    }
+#else
     Z_FreeTags(PU_CACHE,PU_CACHE);
+#endif
   }
 
+#ifdef ZONE_ARENA
+  if (block->where == ZONE_LEVELSTACK)
+  {
+    // only blocks with a user need finding again, see Z_ArenaReleaseLevel
+    block->next = block->prev = NULL;
+    if (user)
+    {
+      if ((block->next = levelowned))
+        levelowned->prev = block;
+      levelowned = block;
+    }
+  }
+  else
+#endif
   if (!blockbytag[tag])
   {
     blockbytag[tag] = block;
@@ -416,8 +896,10 @@ void *(Z_Malloc)(size_t size, int tag, void **user
     block->next = blockbytag[tag];
     blockbytag[tag]->prev = block;
   }
-    
-  block->size = size;
+
+#ifndef ZONE_ARENA
+  block->size = size;   // the arena keeps the size of the block it found
+#endif
 
 #ifdef INSTRUMENTED
   if (tag >= PU_PURGELEVEL)
@@ -486,6 +968,10 @@ void (Z_Free)(void *p
   if (block->user)            // Nullify user if one exists
     *block->user = NULL;
 
+#ifdef ZONE_ARENA
+  if (block->where != ZONE_LEVELSTACK)
+#endif
+  {
   if (block == block->next)
     blockbytag[block->tag] = NULL;
   else
@@ -493,6 +979,7 @@ void (Z_Free)(void *p
       blockbytag[block->tag] = block->next;
   block->prev->next = block->next;
   block->next->prev = block->prev;
+  }
 
   free_memory += block->size;
 #ifdef INSTRUMENTED
@@ -502,10 +989,20 @@ void (Z_Free)(void *p
     active_memory -= block->size;
 
   /* scramble memory -- weed out any bugs */
+#ifdef ZONE_ARENA
+  /* the arena still needs the header */
+  memset((char *) block + HEADER_SIZE, gametic & 0xff, block->size);
+#else
   memset(block, gametic & 0xff, block->size + HEADER_SIZE);
 #endif
+#endif
 
-#ifdef HAVE_LIBDMALLOC
+#ifdef ZONE_ARENA
+  if (block->where == ZONE_LEVELSTACK)
+    Z_ArenaLevelFree(block);
+  else
+    Z_ArenaHeapFree(block);
+#elif defined(HAVE_LIBDMALLOC)
   dmalloc_free(file,line,block,DMALLOC_FUNC_MALLOC);
 #else
   (free)(block);
@@ -531,6 +1028,25 @@ void (Z_FreeTags)(int lowtag, int hightag
   if (hightag > PU_CACHE)
     hightag = PU_CACHE;
 
+#ifdef ZONE_ARENA
+  if (lowtag <= PU_LEVEL && hightag >= PU_LEVSPEC)
+    Z_ArenaReleaseLevel();
+  else if (lowtag <= PU_LEVSPEC && hightag >= PU_LEVEL)
+  {
+    // only one of the level tags, so free its blocks one at a time
+    memblock_t *block = (memblock_t *)level_bottom;
+
+    while ((char *)block < arena_end)
+    {
+      memblock_t *next = Z_BlockAfter(block);
+
+      if (block->tag >= lowtag && block->tag <= hightag)
+        (Z_Free)((char *) block + HEADER_SIZE DA(file, line));
+      block = next;
+    }
+  }
+#endif
+
   for (;lowtag <= hightag; lowtag++)
   {
     memblock_t *block, *end_block;
@@ -569,6 +1085,17 @@ void (Z_ChangeTag)(void *ptr, int tag
   if (tag == block->tag)
     return;
 
+#ifdef ZONE_ARENA
+  // level stack blocks have to go when the level does
+  if (block->where == ZONE_LEVELSTACK)
+  {
+    if (tag != PU_LEVEL && tag != PU_LEVSPEC)
+      I_Error("Z_ChangeTag: can't move a level block to tag %d", tag);
+    block->tag = tag;
+    return;
+  }
+#endif
+
 #ifdef INSTRUMENTED
 #ifdef CHECKHEAP
   Z_CheckHeap();
@@ -0,0 +1,34 @@
+#!/bin/sh
+#
+# -checksum only rehashes what the playsim reports as changed, so play
+# the demo with -checksumverify to catch anything unreported, then check
+# that -checksumcompare tells streams apart, whatever their lengths.
+#
+
+. "$(dirname "$0")/common.sh"
+
+# compare <expected status> <file> <file>
+compare()
+{
+  (cd "$work" && ./prboom-headless -checksumcompare "$2" "$3") \
+    > "$work/run.log" 2>&1
+  status=$?
+  [ $status = "$1" ] ||
+    fail "-checksumcompare $2 $3 returned $status, expected $1"
+}
+
+run -- -fastdemo demo.lmp -checksum "$work/a.txt" -checksumverify
+grep -q "^final:" "$work/a.txt" || fail "-checksumverify failed"
+
+compare 0 a.txt a.txt
+
+head -n 301 "$work/a.txt" > "$work/short.txt"
+compare 1 a.txt short.txt
+compare 1 short.txt a.txt
+
+awk '$1 == "200," { $3 = "00000000" } { print }' "$work/a.txt" > "$work/b.txt"
+compare 1 a.txt b.txt
+grep -q "first difference at tic 200: mobjs" "$work/run.log" ||
+  fail "wrong difference found"
+
+echo "$(basename "$0"): ok"
@@ -0,0 +1,40 @@
+#
+# Shared setup for the headless tests, sourced by each tests/*.sh with
+# the binary as $1. Leaves a scratch directory in $work holding a copy of
+# the binary (it looks for prboom.wad and its config next to itself) and
+# the synthetic doom2.wad and demo.lmp from mkwad.py.
+#
+
+tests=$(cd "$(dirname "$0")" && pwd)
+top=$(dirname "$tests")
+bin=$1
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+cp "$bin" "$work/prboom-headless"
+cp "$top/data/prboom.wad" "$work/"
+python3 "$tests/mkwad.py" "$top/src" "$work" || exit 1
+
+# run <config line>... -- <args>: one demo run with its own config file.
+# A finished -fastdemo quits through I_Error, so the exit status says
+# nothing; the callers check what the run wrote instead.
+run()
+{
+  cfg="$work/run$$.cfg"
+  : > "$cfg"
+  while [ "$1" != "--" ]; do
+    echo "$1" >> "$cfg"
+    shift
+  done
+  shift
+  (cd "$work" && ./prboom-headless -iwad doom2.wad -config "$cfg" "$@") \
+    > "$work/run.log" 2>&1
+}
+
+fail()
+{
+  tail -5 "$work/run.log"
+  echo "$(basename "$0"): $*"
+  exit 1
+}
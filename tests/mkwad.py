@@ -0,0 +1,279 @@
+#!/usr/bin/env python3
+#
+# Synthetic doom2-style IWAD and demo for the headless tests, so they
+# need no commercial data:
+#
+#   mkwad.py <src dir> <out dir>
+#
+# writes <out dir>/doom2.wad (every map is the same grid of sectors with
+# random heights, lights, monsters and items, and lines that set off
+# lifts, doors and scrollers) and <out dir>/demo.lmp (MAP01 on UV,
+# wandering about and shooting). GRID, THINGS and TICS in the
+# environment change the map size, thing count and demo length.
+#
+import struct, re, random, math, sys, os
+SRC, OUT = sys.argv[1], sys.argv[2]
+random.seed(1234)
+N = int(os.environ.get('GRID', '16'))      # cells per side
+CELL = 128
+
+def patch(w, h, lo, to, fill=lambda x,y: (x*7+y*3)&255, holes=False):
+    cols = []
+    for x in range(w):
+        col = b''
+        if holes:
+            # two posts per column with a gap
+            h1 = h//3
+            col += bytes([0, h1, 0]) + bytes(fill(x,y) for y in range(h1)) + b'\0'
+            col += bytes([h1+4, h-h1-4, 0]) + bytes(fill(x,y) for y in range(h1+4,h)) + b'\0'
+        else:
+            col += bytes([0, h, 0]) + bytes(fill(x,y) for y in range(h)) + b'\0'
+        col += b'\xff'
+        cols.append(col)
+    hdr = struct.pack('<hhhh', w, h, lo, to)
+    off = 8 + 4*w
+    ofs = []
+    for c in cols:
+        ofs.append(off); off += len(c)
+    return hdr + b''.join(struct.pack('<i', o) for o in ofs) + b''.join(cols)
+
+lumps = []   # (name, data)
+def add(name, data): lumps.append((name.upper(), data))
+
+# palettes / colormaps
+pal = bytearray()
+for p in range(14):
+    for i in range(256):
+        r, g, b = (i*5)&255, (i*11)&255, (i*17)&255
+        if 1 <= p <= 8: r = min(255, r + p*20)
+        pal += bytes([r, g, b])
+add('PLAYPAL', bytes(pal))
+cm = bytearray()
+for m in range(34):
+    for i in range(256):
+        cm.append(i if m < 32 else (255 - i))
+add('COLORMAP', bytes(cm))
+
+# textures
+wallpat = patch(64, 128, 0, 0)
+skypat = patch(256, 128, 0, 0, fill=lambda x,y: (x+y)&255)
+add('WALLPAT', wallpat); add('WALLPAT2', patch(64, 128, 0, 0, fill=lambda x,y: (x^y)&255))
+add('SKYPAT', skypat)
+pnames = ['WALLPAT', 'WALLPAT2', 'SKYPAT']
+add('PNAMES', struct.pack('<i', len(pnames)) + b''.join(n.encode().ljust(8, b'\0') for n in pnames))
+texdefs = [('AASHITTY', 64, 128, 0), ('WALL', 64, 128, 0), ('WALL2', 64, 128, 1), ('SKY1', 256, 128, 2), ('SKY2', 256, 128, 2), ('SKY3', 256, 128, 2),
+           ('GRATE', 64, 128, 1)]
+tex = b''
+offs = []
+base = 4 + 4*len(texdefs)
+for name, w, h, p in texdefs:
+    offs.append(base + len(tex))
+    tex += name.encode().ljust(8, b'\0') + struct.pack('<ihhih', 0, w, h, 0, 1) + struct.pack('<hhhhh', 0, 0, p, 0, 0)
+add('TEXTURE1', struct.pack('<i', len(texdefs)) + b''.join(struct.pack('<i', o) for o in offs) + tex)
+
+# map
+open_ = [[True]*N for _ in range(N)]
+for i in range(N):
+    for j in range(N):
+        if random.random() < 0.12 and not (i < 2 and j < 2):
+            open_[i][j] = False
+verts = {}
+vlist = []
+def V(x, y):
+    k = (x, y)
+    if k not in verts:
+        verts[k] = len(vlist); vlist.append(k)
+    return verts[k]
+sectors = []
+secidx = {}
+for i in range(N):
+    for j in range(N):
+        if open_[i][j]:
+            secidx[(i,j)] = len(sectors)
+            fl = random.choice([0, 0, 8, 16, 24, -16, 32])
+            ce = fl + random.choice([128, 128, 160, 192, 96])
+            ceflat = 'F_SKY1' if random.random() < 0.15 else random.choice(['FLOOR1', 'FLOOR2'])
+            # some flicker, hurt or hide a secret, some get tags for the lines below
+            r = random.random()
+            special = random.choice([1, 2, 3, 8, 12, 13, 17]) if r < 0.15 else 9 if r < 0.18 else 7 if r < 0.21 else 0
+            tag = random.randint(1, 9) if random.random() < 0.1 else 0
+            sectors.append((fl, ce, random.choice(['FLOOR0', 'FLOOR3']), ceflat, random.choice([128,160,192,255]), special, tag))
+sides = []
+lines = []
+cellsegs = {}  # (i,j) -> list of (v1, v2, line, side)
+def side(sec, up='-', lo='-', mid='-'):
+    sides.append((0, 0, up, lo, mid, sec)); return len(sides)-1
+# a few two-sided lines retrigger lifts or doors when crossed (tags 1-8),
+# or scroll the floors tagged 9
+def trigger():
+    r = random.random()
+    if r < 0.04:
+        return (random.choice([88, 90]), random.randint(1, 8))
+    if r < 0.045:
+        return (253, 9)
+    return (0, 0)
+def O(i, j): return 0 <= i < N and 0 <= j < N and open_[i][j]
+# cell (i,j) spans x in [i*C,(i+1)*C], y in [j*C,(j+1)*C]
+for i in range(N+1):
+    for j in range(N):
+        # vertical edge at x=i*C between cell (i-1,j) west and (i,j) east
+        w, e = O(i-1, j), O(i, j)
+        if not (w or e): continue
+        a, b = V(i*CELL, j*CELL), V(i*CELL, (j+1)*CELL)   # direction +y: right = east
+        if w and e:
+            fs = side(secidx[(i,j)], 'WALL2', 'WALL2', 'GRATE' if random.random()<0.05 else '-')
+            bs = side(secidx[(i-1,j)], 'WALL2', 'WALL2', '-')
+            ln = len(lines); lines.append((a, b, 4) + trigger() + (fs, bs))
+            cellsegs.setdefault((i,j), []).append((a, b, ln, 0))
+            cellsegs.setdefault((i-1,j), []).append((b, a, ln, 1))
+        elif e:
+            fs = side(secidx[(i,j)], mid='WALL')
+            ln = len(lines); lines.append((a, b, 1, 0, 0, fs, -1))
+            cellsegs.setdefault((i,j), []).append((a, b, ln, 0))
+        else:
+            fs = side(secidx[(i-1,j)], mid='WALL')
+            ln = len(lines); lines.append((b, a, 1, 0, 0, fs, -1))
+            cellsegs.setdefault((i-1,j), []).append((b, a, ln, 0))
+for i in range(N):
+    for j in range(N+1):
+        # horizontal edge at y=j*C between (i,j-1) south and (i,j) north
+        s, n = O(i, j-1), O(i, j)
+        if not (s or n): continue
+        a, b = V(i*CELL, j*CELL), V((i+1)*CELL, j*CELL)   # direction +x: right = south
+        if s and n:
+            fs = side(secidx[(i,j-1)], 'WALL2', 'WALL2', '-')
+            bs = side(secidx[(i,j)], 'WALL2', 'WALL2', '-')
+            ln = len(lines); lines.append((a, b, 4) + trigger() + (fs, bs))
+            cellsegs.setdefault((i,j-1), []).append((a, b, ln, 0))
+            cellsegs.setdefault((i,j), []).append((b, a, ln, 1))
+        elif s:
+            fs = side(secidx[(i,j-1)], mid='WALL')
+            ln = len(lines); lines.append((a, b, 1, 0, 0, fs, -1))
+            cellsegs.setdefault((i,j-1), []).append((a, b, ln, 0))
+        else:
+            fs = side(secidx[(i,j)], mid='WALL')
+            ln = len(lines); lines.append((b, a, 1, 0, 0, fs, -1))
+            cellsegs.setdefault((i,j), []).append((b, a, ln, 0))
+def bam(a, b):
+    (x1, y1), (x2, y2) = vlist[a], vlist[b]
+    ang = math.atan2(y2-y1, x2-x1)
+    return int(round(ang / (2*math.pi) * 65536)) & 0xffff
+segs = []; ssecs = []; ssidx = {}
+for (i, j) in sorted(secidx):
+    first = len(segs)
+    for (a, b, ln, sd) in cellsegs[(i,j)]:
+        segs.append((a, b, bam(a, b), ln, sd, 0))
+    ssidx[(i,j)] = len(ssecs); ssecs.append((len(segs)-first, first))
+nodes = []
+def build(x0, x1, y0, y1):
+    cells = [(i,j) for i in range(x0,x1) for j in range(y0,y1) if open_[i][j]]
+    assert cells
+    if len(cells) == 1:
+        return 0x8000 | ssidx[cells[0]]
+    xs = sorted(set(c[0] for c in cells)); ys = sorted(set(c[1] for c in cells))
+    # prefer splitting the longer axis near the middle
+    cand = []
+    if len(xs) > 1:
+        for X in range(xs[0]+1, xs[-1]+1):
+            cand.append((abs(X - (x0+x1)/2) - (x1-x0), 'x', X))
+    if len(ys) > 1:
+        for Y in range(ys[0]+1, ys[-1]+1):
+            cand.append((abs(Y - (y0+y1)/2) - (y1-y0), 'y', Y))
+    cand.sort()
+    _, ax, K = cand[0]
+    if ax == 'x':
+        r = build(K, x1, y0, y1); l = build(x0, K, y0, y1)
+        rb = (y1*CELL, y0*CELL, K*CELL, x1*CELL); lb = (y1*CELL, y0*CELL, x0*CELL, K*CELL)
+        nodes.append((K*CELL, y0*CELL, 0, (y1-y0)*CELL) + rb + lb + (r, l))
+    else:
+        r = build(x0, x1, y0, K); l = build(x0, x1, K, y1)
+        rb = (K*CELL, y0*CELL, x0*CELL, x1*CELL); lb = (y1*CELL, K*CELL, x0*CELL, x1*CELL)
+        nodes.append((x0*CELL, K*CELL, (x1-x0)*CELL, 0) + rb + lb + (r, l))
+    return len(nodes)-1
+build(0, N, 0, N)
+things = [(CELL//2, CELL//2, 45, 1, 7)]
+types = [3004, 3004, 9, 3001, 3001, 3002, 2011, 2007, 2048, 35, 2035]
+opencells = [c for c in secidx if c != (0,0)]
+for k in range(int(os.environ.get('THINGS', '150'))):
+    i, j = random.choice(opencells)
+    things.append((i*CELL + random.randint(24, CELL-24), j*CELL + random.randint(24, CELL-24), random.randrange(0, 360, 45), random.choice(types), 7))
+def nm(s): return s.encode().ljust(8, b'\0')
+for mapnum in range(1, 31):
+    add('MAP%02d' % mapnum, b'')
+    add('THINGS', b''.join(struct.pack('<hhhhh', *t) for t in things))
+    add('LINEDEFS', b''.join(struct.pack('<hhhhhhh', *l) for l in lines))
+    add('SIDEDEFS', b''.join(struct.pack('<hh', s[0], s[1]) + nm(s[2]) + nm(s[3]) + nm(s[4]) + struct.pack('<h', s[5]) for s in sides))
+    add('VERTEXES', b''.join(struct.pack('<hh', *v) for v in vlist))
+    add('SEGS', b''.join(struct.pack('<hhHhhh', *s) for s in segs))
+    add('SSECTORS', b''.join(struct.pack('<hh', *s) for s in ssecs))
+    add('NODES', b''.join(struct.pack('<hhhhhhhhhhhhHH', *n) for n in nodes))
+    add('SECTORS', b''.join(struct.pack('<hh', s[0], s[1]) + nm(s[2]) + nm(s[3]) + struct.pack('<hhh', s[4], s[5], s[6]) for s in sectors))
+    add('REJECT', b'')
+    add('BLOCKMAP', b'')
+
+# flats
+add('F_START', b'')
+for k, name in enumerate(['FLOOR0', 'FLOOR1', 'FLOOR2', 'FLOOR3', 'F_SKY1']):
+    add(name, bytes(((x*(k+1)) ^ y) & 255 for y in range(64) for x in range(64)))
+add('F_END', b'')
+
+# sprites: every frame of every sprite, rotation 0, sharing one patch
+info = open(SRC + '/info.c', encoding='latin-1').read()
+sprn = re.findall(r'"([A-Z0-9]{4})"', info[info.index('sprnames['):info.index('NULL', info.index('sprnames['))])
+sprpatch = patch(32, 56, 16, 52, holes=True)
+add('S_START', b'')
+for s in sprn:
+    for f in 'ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]':
+        add(s + f + '0', sprpatch)
+add('S_END', b'')
+
+# sounds and music
+snd = open(SRC + '/sounds.c', encoding='latin-1').read()
+sfx = re.findall(r'\{ "([a-z0-9]+)"', snd[snd.index('S_sfx[]'):])
+mus = re.findall(r'\{ "([a-z0-9]+)"', snd[snd.index('S_music[]'):snd.index('S_sfx[]')])
+dmx = struct.pack('<HHI', 3, 11025, 32) + bytes(128 for _ in range(32))
+for s in sfx[1:]:
+    add('DS' + s, dmx)
+mushdr = b'MUS\x1a' + struct.pack('<HHHHHH', 1, 16, 0, 0, 0, 0) + b'\x60'
+for m in mus:
+    add('D_' + m, mushdr)
+
+# status bar and HUD graphics, all the same small patch
+small = patch(8, 8, 0, 0)
+hud = ['STBAR', 'STARMS', 'STFB0', 'STTPRCNT', 'STFGOD0', 'STFDEAD0']
+hud += ['STCFN%03d' % c for c in range(33, 96)]
+hud += ['STTNUM%d' % d for d in range(10)] + ['STYSNUM%d' % d for d in range(10)]
+hud += ['STGNUM%d' % d for d in range(2, 8)] + ['STKEYS%d' % d for d in range(6)]
+for pain in range(5):
+    hud += ['STFST%d%d' % (pain, d) for d in range(3)]
+    hud += ['STFTL%d0' % pain, 'STFTR%d0' % pain]
+    hud += ['STFOUCH%d' % pain, 'STFEVL%d' % pain, 'STFKILL%d' % pain]
+for name in hud:
+    add(name, small)
+
+# write
+out = os.path.join(OUT, 'doom2.wad')
+data = b''; dirents = []; cache = {}
+for name, d in lumps:
+    if d in cache:
+        dirents.append((cache[d], len(d), name)); continue
+    off = 12 + len(data); cache[d] = off
+    dirents.append((off, len(d), name)); data += d
+hdr = b'IWAD' + struct.pack('<ii', len(lumps), 12 + len(data))
+with open(out, 'wb') as f:
+    f.write(hdr + data + b''.join(struct.pack('<ii', o, l) + n.encode().ljust(8, b'\0')[:8] for o, l, n in dirents))
+
+# demo: v1.9, UV, MAP01, wander and shoot
+tics = int(os.environ.get('TICS', '700'))
+dem = bytearray([109, 3, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0])
+fwd, turn = 25, 0
+for t in range(tics):
+    if t % 35 == 0:
+        fwd = random.choice([25, 50, 50, -25, 0])
+        turn = random.choice([0, 0, 4, -4, 8, -8])
+    side = random.choice([0, 0, 24, -24]) if t % 70 < 10 else 0
+    buttons = 1 if (t % 20) < 6 else 0
+    if t % 90 == 45: buttons |= 2
+    dem += struct.pack('<bbBB', fwd, side, turn & 255, buttons)
+dem.append(0x80)
+open(os.path.join(OUT, 'demo.lmp'), 'wb').write(dem)
@@ -0,0 +1,19 @@
+#!/bin/sh
+#
+# Frames drawn with several render threads must be bit-identical to the
+# ones drawn on the main thread alone, in mono and in stereo.
+#
+
+. "$(dirname "$0")/common.sh"
+
+for stereo in 0 4; do
+  for threads in 1 4; do
+    run "render_threads $threads" "stereo_separation $stereo" -- \
+      -fastdemo demo.lmp -framehash "$work/frames.$stereo.$threads"
+  done
+  [ -s "$work/frames.$stereo.1" ] || fail "no frames drawn"
+  cmp -s "$work/frames.$stereo.1" "$work/frames.$stereo.4" ||
+    fail "stereo_separation $stereo: 4 threads differ from 1 at frame" \
+      "$(diff "$work/frames.$stereo.1" "$work/frames.$stereo.4" | sed -n '2s/^< //p')"
+done
+echo "$(basename "$0"): ok"
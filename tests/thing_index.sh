@@ -0,0 +1,22 @@
+#!/bin/sh
+#
+# thing_index 1 only uses the index outside demos, so a demo played with
+# it must hash the same as with the index off. thing_index 2 forces the
+# index on and is there to show the demo tells the two apart, which
+# takes a crowded map.
+#
+
+export GRID=12 THINGS=1000 TICS=300
+. "$(dirname "$0")/common.sh"
+
+for i in 0 1 2; do
+  run "thing_index $i" -- -fastdemo demo.lmp -checksum "$work/index.$i.txt"
+  grep -q "^final:" "$work/index.$i.txt" || fail "thing_index $i: no checksums"
+done
+
+(cd "$work" && ./prboom-headless -checksumcompare index.0.txt index.1.txt) \
+  > "$work/run.log" 2>&1 || fail "thing_index 1 changed the demo"
+(cd "$work" && ./prboom-headless -checksumcompare index.0.txt index.2.txt) \
+  > "$work/run.log" 2>&1 && fail "thing_index 2 didn't change the demo"
+
+echo "$(basename "$0"): ok"